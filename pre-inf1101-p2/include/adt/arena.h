@@ -0,0 +1,71 @@
+/**
+ * @brief Bump allocator for memory that is all freed at once, e.g. everything a single query allocates.
+ *
+ * Allocating is moving a pointer forward in a chunk, and nothing is freed on its own: resetting the arena
+ * frees everything allocated from it in one go. A full chunk is followed by a new one, at least twice as large,
+ * and a reset merges every chunk into one that fits them all. An arena that is reset between queries thus
+ * soon fits the largest of them in a single chunk, after which queries make no heap allocations through it.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/**
+ * Size of the first chunk of an arena, in bytes
+ */
+#define ARENA_INITIAL_CHUNK (64 * 1024)
+
+/**
+ * Type of arena. `arena_t` is an alias for `struct arena`
+ */
+typedef struct arena arena_t;
+
+/**
+ * @brief Create an empty arena. Its first chunk is allocated by the first allocation from it.
+ * @returns the arena, or NULL on failure
+ */
+arena_t *arena_create(void);
+
+/**
+ * @brief Destroy an arena, freeing everything allocated from it
+ * @note this is safe to call with `arena` == NULL, where it simply returns
+ */
+void arena_destroy(arena_t *arena);
+
+/**
+ * @brief Allocate memory from an arena, aligned for any type
+ * @param arena: pointer to arena
+ * @param size: number of bytes
+ * @returns the memory, valid until the arena is reset or destroyed, or NULL on failure
+ */
+void *arena_alloc(arena_t *arena, size_t size);
+
+/**
+ * @brief Allocate zeroed memory for `n` elements of `size` bytes from an arena. See `arena_alloc`.
+ */
+void *arena_calloc(arena_t *arena, size_t n, size_t size);
+
+/**
+ * @brief Copy a string into an arena. See `arena_alloc`.
+ */
+char *arena_strdup(arena_t *arena, const char *str);
+
+/**
+ * @brief Copy at most `n` characters of a string into an arena, null terminated. See `arena_alloc`.
+ */
+char *arena_strndup(arena_t *arena, const char *str, size_t n);
+
+/**
+ * @brief Free everything allocated from an arena at once, keeping its memory for what is allocated next
+ */
+void arena_reset(arena_t *arena);
+
+/**
+ * @brief Get the memory held by an arena, in bytes
+ */
+size_t arena_bytes(const arena_t *arena);
+
+
+#endif /* ARENA_H */
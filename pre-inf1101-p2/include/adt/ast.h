@@ -2,7 +2,9 @@
 #define AST_H
 
 #include <stddef.h>
+#include <stdint.h>
 
+#include "arena.h"
 #include "list.h"
 #include "set.h"
 
@@ -20,12 +22,28 @@ typedef struct AST AST;
 struct AST {
     enum {
         AST_TERM,
+        AST_PREFIX,
+        AST_FUZZY,
+        AST_SUBSTRING,
+        AST_PHRASE,
         AST_AND,
         AST_OR,
         AST_ANDNOT
     } type; // type of node
     union {
         char *term; // a search keyword
+        struct {
+            char *str;          // the prefix or substring without its '*'s, or the term without its '~k'
+            unsigned max_edits; // k of a fuzzy term
+            char **terms;       // the indexed terms it matches, see `index_expand_terms`
+            size_t n_terms;
+        } expansion; // a search keyword matching several terms: a prefix (`term*`), a fuzzy term (`term~k`)
+                     // or a substring (`*term*`)
+        struct {
+            char **terms;      // the words of the phrase, stop words included
+            uint32_t *offsets; // position of each term relative to the first word of the phrase
+            size_t n_terms;
+        } phrase; // a quoted phrase (`"term term"`), matching the terms next to each other in order
         struct {
             AST *left;  // left child
             AST *right; // right child
@@ -36,30 +54,52 @@ struct AST {
 
 
 
-/* Creation and Deletion */
+/* Creation */
+
+/* Nodes and their strings are allocated from an arena, and freed all at once when it is reset (see arena.h).
+    There is no function to destroy an ast on its own */
 
 /* Create a new ast for a term */
-AST *ast_create_term(char *term);
+AST *ast_create_term(arena_t *arena, char *term);
 
-/* Create a new ast for an operator */
-AST *ast_create_operator(int type, AST *left, AST *right);
+/* Create a new ast for a prefix token (`prefix*`, including the '*').
+    It matches nothing until its terms are set */
+AST *ast_create_prefix(arena_t *arena, char *token);
 
-/* Frees the memory of the ast nodes and it children */
-void ast_destroy(AST *node);
+/* Create a new ast for a fuzzy term (`term~k`), matching the terms within `max_edits` edits of `term`.
+    It matches nothing until its terms are set */
+AST *ast_create_fuzzy(arena_t *arena, char *term, unsigned max_edits);
+
+/* Create a new ast for a substring token (`*substring*`, including the '*'s).
+    It matches nothing until its terms are set */
+AST *ast_create_substring(arena_t *arena, char *token);
+
+/* Create a new ast for a phrase of `n_words` words. Stop words are among its terms, as a phrase
+    only matches where they are (see `index_lookup_stop_word`) */
+AST *ast_create_phrase(arena_t *arena, char **words, size_t n_words);
+
+/* Create a new ast for an operator */
+AST *ast_create_operator(arena_t *arena, int type, AST *left, AST *right);
 
 
 
 /* Parsing */
 
-/* Parse a list of tokens to the ast */
-AST *parse_expression(list_iter_t *token_iter, char *errmsg);
+/* Parse a list of tokens to the ast, allocated from `arena` */
+AST *parse_expression(list_iter_t *token_iter, arena_t *arena, char *errmsg);
 
 
 
 /* Utility */
 
-/* Traverses and evaluates the ast returning the result as a set of documents */
-set_t *ast_result(AST *node, index_t *index, char *errmsg);
+/* Returns the number of terms in the ast. A prefix, fuzzy term or substring counts as each of the terms it was
+    expanded to, and a phrase as each of its terms */
+size_t ast_count_terms(AST *node);
+
+/* Writes the terms of the ast to `terms` in pre-order (left to right), returns the number written.
+    The terms of a prefix, fuzzy term, substring or phrase are written in their place, in order.
+    `terms` must have room for at least `ast_count_terms(node)` pointers */
+size_t ast_collect_terms(AST *node, char **terms);
 
 
 
@@ -0,0 +1,74 @@
+/**
+ * @brief Top-k completions of every prefix of a sorted set of weighted terms.
+ *
+ * The terms starting with a prefix are a range of the sorted terms. Each range that some prefix maps to is a
+ * node of the (compacted) trie of the terms, so the `COMPLETIONS_K` heaviest terms of every node are computed
+ * once, bottom up, when the structure is built. Answering a prefix is then a single hash table lookup.
+ *
+ * Nodes with at most `COMPLETIONS_K` terms are not cached, as their terms are the completions. Every cached
+ * node has more terms than the nodes it caches, so there are at most about 2n / `COMPLETIONS_K` of them.
+ */
+
+#ifndef COMPLETIONS_H
+#define COMPLETIONS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Number of completions cached per prefix
+ */
+#define COMPLETIONS_K 10
+
+/**
+ * Type of completions. `completions_t` is an alias for `struct completions`
+ */
+typedef struct completions completions_t;
+
+/**
+ * @brief Build the completions of a set of terms
+ * @param terms: array of `n` strings, strictly increasing by `strcmp`
+ * @param weights: array of `n` weights, where `weights[i]` belongs to `terms[i]`
+ * @param n: number of terms, less than 2^32
+ * @returns the completions, or NULL on failure
+ *
+ * @note The terms are only read while building, and are not kept. Terms are referred to by their position.
+ */
+completions_t *completions_build(const char **terms, const uint32_t *weights, size_t n);
+
+/**
+ * @brief Destroy completions
+ * @note this is safe to call with `completions` == NULL, where it simply returns
+ */
+void completions_destroy(completions_t *completions);
+
+/**
+ * @brief Get the heaviest terms in a range of terms, i.e. the completions of the prefix the range belongs to
+ * @param completions: pointer to completions
+ * @param lo: position of the first term of the range
+ * @param hi: position after the last term of the range
+ * @param out: caller-provided array of at least `COMPLETIONS_K` positions. Set to the positions of the
+ * heaviest terms, by decreasing weight, and by position if their weights are equal.
+ * @returns the number of positions written, at most `COMPLETIONS_K`
+ *
+ * @note The range of any prefix is cached. Other ranges are answered by scanning them.
+ */
+size_t completions_top(const completions_t *completions, size_t lo, size_t hi, uint32_t *out);
+
+/**
+ * @brief Get the weight of the term at a position
+ */
+uint32_t completions_weight(const completions_t *completions, size_t pos);
+
+/**
+ * @brief Get the number of cached prefixes
+ */
+size_t completions_nodes(const completions_t *completions);
+
+/**
+ * @brief Get the memory used by completions, in bytes
+ */
+size_t completions_bytes(const completions_t *completions);
+
+
+#endif /* COMPLETIONS_H */
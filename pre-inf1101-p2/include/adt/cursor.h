@@ -0,0 +1,117 @@
+/**
+ * @brief Cursor over the documents matching a query, walked a document at a time in increasing ID order.
+ *
+ * A leaf cursor walks a sorted array of document IDs, e.g. the postings of a term. AND, OR and ANDNOT cursors
+ * combine two other cursors, and only ever move them forward, so a whole query is a tree of cursors that is
+ * walked in a single pass. Nothing is built per operator: the memory a query takes is its tree of cursors,
+ * however many documents its terms are in.
+ *
+ * `cursor_skip_to` lets an operator jump past the documents it does not need. An AND of a rare and a common
+ * term only moves the common term to the documents of the rare one, and seeking in a sorted array costs
+ * O(log k) to skip `k` documents, so the common term costs little more than the rare one.
+ *
+ * Cursors are transparent, so that they can be kept in an array and built without allocating. A cursor does
+ * not own the cursors it combines, nor the documents it walks.
+ */
+
+#ifndef CURSOR_H
+#define CURSOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "docset.h"
+#include "postings.h"
+
+/**
+ * Document of a cursor that is past its last document. Greater than every document ID, so that exhausted
+ * cursors need no special case when looking for the smallest document.
+ */
+#define CURSOR_END UINT32_MAX
+
+/**
+ * Kind of cursor
+ */
+typedef enum cursor_kind {
+    CURSOR_LEAF,  // the documents of a sorted array
+    CURSOR_AND,   // the documents of both `left` and `right`
+    CURSOR_OR,    // the documents of either `left` or `right`
+    CURSOR_ANDNOT // the documents of `left` that are not in `right`
+} cursor_kind_t;
+
+/**
+ * Type of cursor. `cursor_t` is an alias for `struct cursor`
+ */
+typedef struct cursor {
+    cursor_kind_t kind;
+    doc_id_t doc;          // the current document, CURSOR_END once past the last
+    const doc_id_t *docs;  // leaves: the documents, strictly increasing
+    const uint32_t *freqs; // leaves: the frequency in each document, NULL if every frequency is 1
+    size_t len;            // leaves: the number of documents
+    size_t pos;            // leaves: the position of the current document
+    struct cursor *left;   // operators: the operands
+    struct cursor *right;
+} cursor_t;
+
+/**
+ * @brief Initialize a cursor over a postings list, on its first document
+ * @param c: pointer to cursor
+ * @param postings: the postings list, or NULL for a term that is not in the index (which has no documents)
+ */
+void cursor_init_postings(cursor_t *c, const postings_t *postings);
+
+/**
+ * @brief Initialize a cursor over a sorted array of documents, on its first document. Every frequency is 1.
+ * @param c: pointer to cursor
+ * @param docs: the documents, strictly increasing. Not copied, and must outlive the cursor.
+ * @param len: number of documents, 0 for a cursor with no documents
+ */
+void cursor_init_docs(cursor_t *c, const doc_id_t *docs, size_t len);
+
+/**
+ * @brief Initialize the AND of two cursors, on its first document
+ * @param c: pointer to cursor
+ * @param left: cursor on its first document, moved by `c` from now on
+ * @param right: cursor on its first document, moved by `c` from now on
+ */
+void cursor_init_and(cursor_t *c, cursor_t *left, cursor_t *right);
+
+/**
+ * @brief Initialize the OR of two cursors, on its first document. See `cursor_init_and`.
+ */
+void cursor_init_or(cursor_t *c, cursor_t *left, cursor_t *right);
+
+/**
+ * @brief Initialize the ANDNOT of two cursors, on its first document. See `cursor_init_and`.
+ */
+void cursor_init_andnot(cursor_t *c, cursor_t *left, cursor_t *right);
+
+/**
+ * @brief Get the current document of a cursor
+ * @returns the document, or CURSOR_END if the cursor is past its last document
+ */
+static inline doc_id_t cursor_doc(const cursor_t *c) {
+    return c->doc;
+}
+
+/**
+ * @brief Move a cursor to its next document
+ * @returns the new current document, or CURSOR_END if there is none
+ */
+doc_id_t cursor_next(cursor_t *c);
+
+/**
+ * @brief Move a cursor to its first document that is at least `doc`. A cursor already there does not move.
+ * @returns the new current document, or CURSOR_END if there is none
+ */
+doc_id_t cursor_skip_to(cursor_t *c, doc_id_t doc);
+
+/**
+ * @brief Get the frequency of the current document of a cursor: its frequency in a leaf, the sum of the
+ * frequencies of the operands of an AND or OR that are on it, and the frequency in `left` of an ANDNOT.
+ * @returns the frequency, or 0 if the cursor is past its last document
+ */
+uint32_t cursor_freq(const cursor_t *c);
+
+
+#endif /* CURSOR_H */
@@ -0,0 +1,22 @@
+/**
+ * @brief Document IDs.
+ *
+ * Document IDs are dense, and assigned by the index in the order the documents are indexed. Postings and
+ * cursors keep them in ascending order.
+ */
+
+#ifndef DOCSET_H
+#define DOCSET_H
+
+#include <stdint.h>
+
+/**
+ * Type of document ID
+ */
+typedef uint32_t doc_id_t;
+
+static inline int compare_doc_ids(doc_id_t a, doc_id_t b) {
+    return (a > b) - (a < b);
+}
+
+#endif /* DOCSET_H */
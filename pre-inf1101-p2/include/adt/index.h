@@ -8,14 +8,19 @@
 
 #include <stddef.h> // for size_t
 #include <stdbool.h>
+#include <stdio.h>
 
 #include "defs.h"
 #include "list.h"
 #include "map.h"
 #include "set.h"
+#include "strtypes.h"
+#include "docset.h"
+#include "postings.h"
 #include "printing.h"
 #include "common.h"
 #include "ast.h"
+#include "completions.h"
 
 
 /**
@@ -23,6 +28,28 @@
  */
 typedef struct index index_t;
 
+/**
+ * Ranking function used to score query results
+ */
+typedef enum ranking {
+    RANKING_TFIDF, // term frequency (relative to document length) times inverse document frequency
+    RANKING_BM25,  // Okapi BM25, see `index_set_ranking`
+} ranking_t;
+
+/**
+ * Default BM25 parameters. `k1` controls how quickly repeated occurrences of a term saturate, `b` how strongly
+ * scores are normalised by document length (0 = not at all, 1 = fully).
+ */
+#define BM25_DEFAULT_K1 1.2
+#define BM25_DEFAULT_B 0.75
+
+/**
+ * Maximum number of terms a prefix (`term*`), fuzzy term (`term~k`) or substring (`*term*`) may expand to.
+ * Queries with one that matches more terms are rejected with an error, rather than evaluated as an arbitrarily
+ * large union.
+ */
+#define TERM_EXPANSION_MAX 256
+
 /**
  * Type of query_result produced by a index query.
  * Higher score implies the document is more relevant.
@@ -30,15 +57,25 @@ typedef struct index index_t;
 typedef struct query_result {
     char *doc_name;
     double score;
-    map_t *term_frequency; // map of term -> frequency
+    map_t *term_frequency; // always NULL: term frequencies are kept by the index, in its forward index
 } query_result_t;
 
+/**
+ * A completion of a prefix: an indexed term starting with it
+ */
+typedef struct completion {
+    char *term;
+    size_t doc_frequency; // number of documents containing the term
+} completion_t;
+
 /**
  * @brief Create a new index
- * @param n_docs: number of documents to be indexed
- * @param n_terms: number of unique terms to be indexed
+ * @param cmpfn: function for comparing terms
+ * @param hashfn: function for hashing terms
  * @returns a pointer to the newly allocated index, or NULL on failure
- * 
+ *
+ * @note The index keys everything by string, and uses containers specialised for strings (see strtypes.h)
+ * rather than `cmpfn`/`hashfn`. They are kept for compatibility with existing callers.
  */
 index_t *index_create(cmp_fn cmpfn, hash64_fn hashfn);
 
@@ -49,6 +86,79 @@ index_t *index_create(cmp_fn cmpfn, hash64_fn hashfn);
  */
 void index_destroy(index_t *index);
 
+/**
+ * @brief Tell the index how many documents it should expect to be given in total. The index uses this as a
+ * cardinality hint to presize its internal structures, rather than growing them step by step during bulk
+ * ingest.
+ *
+ * @param index: pointer to index
+ * @param n_docs: expected total number of documents
+ *
+ * @note Purely an optimization hint. Indexing more or fewer documents than this is perfectly valid.
+ */
+void index_expect_documents(index_t *index, size_t n_docs);
+
+/**
+ * @brief Set the ranking function used to score query results. Defaults to `RANKING_TFIDF`.
+ *
+ * @param index: pointer to index
+ * @param ranking: the ranking function
+ * @param k1: BM25 term frequency saturation, must be >= 0. Ignored for tf-idf.
+ * @param b: BM25 length normalisation, must be in the range [0, 1]. Ignored for tf-idf.
+ * @returns 0 on success, or a negative status code if the parameters are out of range
+ *
+ * @note For BM25, the score contribution of every (term, document) pair is precomputed and quantised to 8
+ * bits by the first query after documents were added, so scoring a candidate is a table lookup and an add
+ * per term.
+ */
+int index_set_ranking(index_t *index, ranking_t ranking, double k1, double b);
+
+/**
+ * @brief Enable anytime top-k evaluation of ranked disjunctions, i.e. queries that only OR terms together.
+ *
+ * Such queries are then evaluated term-at-a-time over postings ordered by decreasing impact (precomputed score
+ * contribution), and stop as soon as the remaining postings cannot change which documents make the top `k`,
+ * or once `budget` postings have been processed. Only the (at most) `k` best documents are returned. Other
+ * queries are evaluated in full, as usual.
+ *
+ * @param index: pointer to index
+ * @param k: number of results to find. 0 disables anytime evaluation (the default).
+ * @param budget: maximum number of postings to process per query, 0 for no limit. If the budget runs out,
+ * the results are the best found so far, which may not be the true top `k`.
+ *
+ * @note Impacts are quantised to 8 bits, so documents whose scores differ by less than roughly 1/255 of the
+ * highest possible term score may be ranked as equal when choosing the top `k`. The scores of the returned documents are computed in
+ * full, exactly as for other queries.
+ */
+void index_set_topk(index_t *index, size_t k, size_t budget);
+
+/**
+ * @brief Enable or disable positional mode, where the index also stores the position of every occurrence of
+ * every term, delta encoded per document (see `positions.h`). Positions are what phrase queries are evaluated
+ * with, and nothing else uses them, so the index stores none unless enabled. Disabled by default.
+ *
+ * Stop words are not terms, but in positional mode their postings and positions are kept as well, so that a
+ * phrase with stop words only matches where those exact stop words are.
+ *
+ * @param index: pointer to index
+ * @param enabled: whether to store positions
+ * @returns 0 on success, otherwise a negative status code. Can only be changed before any documents are
+ * indexed.
+ */
+int index_set_positional(index_t *index, bool enabled);
+
+/**
+ * @brief Enable or disable the trigram index of the terms, which substring queries (`*term*`) find the terms
+ * containing a substring with. It is built as documents are indexed, from the terms seen for the first time.
+ * Without it, a substring query checks every term of the index. Disabled by default.
+ *
+ * @param index: pointer to index
+ * @param enabled: whether to build the trigram index
+ * @returns 0 on success, otherwise a negative status code. Can only be changed before any documents are
+ * indexed.
+ */
+int index_set_trigrams(index_t *index, bool enabled);
+
 /**
  * @brief Index a document and its words
  *
@@ -65,6 +175,20 @@ void index_destroy(index_t *index);
  */
 int index_document(index_t *index, char *doc_name, list_t *words);
 
+/**
+ * @brief Freeze the index for querying, once all documents are indexed. The terms are moved from the hash map
+ * used while indexing to a compact, sorted dictionary, which shares the storage of common prefixes between
+ * terms. Queries look terms up through a minimal perfect hash of them, built alongside the dictionary, and a
+ * 32-bit fingerprint per term, which lets a term that is not in the index through with a probability of 2^-32.
+ *
+ * @param index: pointer to index
+ * @returns 0 on success, otherwise a negative status code. The index is left as it was on failure.
+ *
+ * @note Freezing is optional, and an index can still be given more documents after being frozen. The first of
+ * those thaws it, rebuilding the map, so it should be frozen again once they are all indexed.
+ */
+int index_freeze(index_t *index);
+
 /**
  * @brief Search the index for documents that match the query
  *
@@ -78,9 +202,45 @@ int index_document(index_t *index, char *doc_name, list_t *words);
  *
  * @note the index may remove strings from the given list of tokens, as long as they are cleaned up (freed) by
  * the index. The list itself should not be destroyed.
+ *
+ * @note the results, and their document names, belong to the index, and are valid until the next query (see
+ * `index_query_into`). The list belongs to the caller: destroy it without freeing them, i.e.
+ * `list_destroy(results, NULL)`.
  */
 list_t *index_query(index_t *index, list_t *query_tokens, char *errbuf);
 
+/**
+ * @brief Search the index for documents that match the query, like `index_query`, but return the results as an
+ * array rather than a list
+ *
+ * @param n_results: set to the number of results
+ * @returns NULL if the query was malformed or otherwise invalid, otherwise an array of `n_results`
+ * `query_result_t` structs, sorted by score in descending order
+ *
+ * @note the results, and their document names, belong to the index, and are valid until the next query. They
+ * are allocated from memory that the next query reuses, and only grows when a query needs more of it than any
+ * before, so a query that was asked before makes no heap allocations. Do not free them.
+ */
+query_result_t *index_query_into(index_t *index, list_t *query_tokens, size_t *n_results, char *errbuf);
+
+/**
+ * @brief Find the terms starting with a prefix that occur in the most documents, to complete a term as it is
+ * typed
+ *
+ * @param index: pointer to index
+ * @param prefix: the prefix
+ * @param out: caller-provided array of at least `COMPLETIONS_K` completions, set to the completions by
+ * decreasing document frequency (alphabetically if equal). The terms are allocated, and must be freed by the
+ * caller.
+ * @param n_out: set to the number of completions, at most `COMPLETIONS_K`
+ * @returns 0 on success, otherwise a negative status code
+ *
+ * @note The completions of every prefix are computed when the index is frozen, so this is a lookup of the
+ * prefix in the term dictionary and of its completions in a hash table. An index that is not frozen is frozen
+ * first.
+ */
+int index_complete(index_t *index, const char *prefix, completion_t *out, size_t *n_out);
+
 /**
  * @brief Get the number of unique documents and terms that have been indexed
  * @param n_docs: pointer to size_t - must be set to the number of docs
@@ -88,6 +248,14 @@ list_t *index_query(index_t *index, list_t *query_tokens, char *errbuf);
  */
 void index_stat(index_t *index, size_t *n_docs, size_t *n_terms);
 
+/**
+ * @brief Print statistics on the data structures of the index, such as load factors, chain lengths, tree
+ * heights and memory use. For structures that exist per document/term, a sample is aggregated.
+ * @param index: pointer to index
+ * @param f: stream to print to
+ */
+void index_print_stats(index_t *index, FILE *f);
+
 
 /* Helper function */
 
@@ -95,9 +263,80 @@ void index_stat(index_t *index, size_t *n_docs, size_t *n_terms);
 
 bool stop_word(const char *term);
 
-double calculate_tfidf(index_t *index, AST *ast, char *doc_name);
+/**
+ * @brief Calculate the TF-IDF of a query for a single document. Kept for callers of the old interface, and
+ * slow: the query is compiled every call, and scored in memory of its own rather than the index's query arena,
+ * which would free the results of the last query. Queries are scored by `index_query`.
+ * @param index: pointer to index
+ * @param ast: the parsed query
+ * @param doc_id: the document to score
+ * @returns the score, or 0 if the query could not be compiled or the document is not in the index
+ */
+double calculate_tfidf(index_t *index, AST *ast, doc_id_t doc_id);
+
+/**
+ * @brief Look up the postings of each of the given terms, a batch at a time, without allocating
+ * @param terms: array of `n` terms
+ * @param out_postings: caller-provided array of `n` postings. `out_postings[i]` is set to the postings of
+ * `terms[i]`, or NULL if the term is not indexed. The postings are borrowed from the index.
+ * @returns the number of terms that were found
+ */
+size_t index_lookup_terms(index_t *index, char **terms, size_t n, const postings_t **out_postings);
+
+/**
+ * @brief Look up the postings of a stop word. Stop words are not terms, and `index_lookup_terms` does not find
+ * them, but a positional index keeps their postings and positions for phrases to check.
+ * @returns the postings, borrowed from the index, or NULL if `word` is not a stop word or the index is not
+ * positional
+ */
+const postings_t *index_lookup_stop_word(index_t *index, const char *word);
+
+/**
+ * @brief Find the documents containing a phrase: every term of it, at the given offsets from each other
+ *
+ * The documents containing every term are found first, by intersecting the postings. Only for those are the
+ * positions of the terms decoded, and merged to find where the phrase occurs. Like everything else a query
+ * needs, the state of the terms is allocated from the memory of the query, and their positions are decoded
+ * into a buffer that the index keeps between queries.
+ *
+ * @param index: pointer to index, which must be positional (see `index_set_positional`)
+ * @param postings: array of `n` postings of the terms, as returned by `index_lookup_terms`, or by
+ * `index_lookup_stop_word` for stop words. NULL if a term is not indexed.
+ * @param offsets: array of `n` offsets. `offsets[i]` is the position of term i relative to the start of the
+ * phrase.
+ * @param n: number of terms
+ * @param out: caller-provided array with room for as many documents as the shortest of the postings. Set to
+ * the documents, in increasing order.
+ * @param n_out: set to the number of documents
+ * @param errmsg: Caller-provided buffer to write error messages to (min. buffer size = LINE_MAX)
+ * @returns 0 on success, otherwise a negative error code (e.g. the index is not positional), with `errmsg` set
+ */
+int index_match_phrase(
+    index_t *index,
+    const postings_t **postings,
+    const uint32_t *offsets,
+    size_t n,
+    doc_id_t *out,
+    size_t *n_out,
+    char *errmsg
+);
 
-map_t *index_get_terms_map(index_t *index); // From Ai
+/**
+ * @brief Expand every prefix (`term*`) of a query to the indexed terms starting with it, every fuzzy term
+ * (`term~k`) to the indexed terms within `k` edits of it, and every substring (`*term*`) to the indexed terms
+ * containing it. All in sorted order.
+ * @param index: pointer to index
+ * @param ast: the query. The terms of its prefix, fuzzy and substring nodes are set.
+ * @param arena: the arena the ast is allocated from, which the terms are allocated from as well
+ * @param errmsg: Caller-provided buffer to write error messages to (min. buffer size = LINE_MAX)
+ * @returns 0 on success, otherwise a negative error code, with `errmsg` set. A prefix, fuzzy term or substring
+ * that matches more than `TERM_EXPANSION_MAX` terms is an error.
+ *
+ * @note Terms are enumerated from the sorted dictionary of a frozen index: prefixes as a range of it, fuzzy
+ * terms by intersecting it with a Levenshtein automaton. Neither looks at the rest of the vocabulary. Substrings
+ * are looked up in the trigram index, see `index_set_trigrams`. An index that is not frozen is frozen first.
+ */
+int index_expand_terms(index_t *index, AST *ast, arena_t *arena, char *errmsg);
 
 
 #endif /* INDEX_H */
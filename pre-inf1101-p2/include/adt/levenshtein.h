@@ -0,0 +1,86 @@
+/**
+ * @brief Levenshtein automaton: accepts the strings within a given edit distance of a term.
+ *
+ * The automaton is simulated row by row, the way the edit distance itself is computed by dynamic
+ * programming: the state after reading a string is the row of distances from it to every prefix of the term.
+ * Reading one more character computes the next row from the current one. Callers walking strings that share
+ * prefixes (e.g. a sorted dictionary) keep the row of each prefix, and only step through what differs.
+ *
+ * A state is dead once every distance in its row is above the maximum. No string it leads to is accepted, so
+ * callers can skip every string starting with what has been read so far.
+ */
+
+#ifndef LEVENSHTEIN_H
+#define LEVENSHTEIN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Highest supported edit distance. The number of strings within a distance grows quickly, and above 2 they
+ * are rarely what a user meant.
+ */
+#define LEVENSHTEIN_MAX_EDITS 2
+
+/**
+ * Type of automaton. `levenshtein_t` is an alias for `struct levenshtein`
+ */
+typedef struct levenshtein levenshtein_t;
+
+/**
+ * @brief Create an automaton
+ * @param term: the term to match. The automaton keeps its own copy.
+ * @param max_edits: maximum number of insertions, deletions and substitutions, at most LEVENSHTEIN_MAX_EDITS
+ * @returns the automaton, or NULL on failure
+ */
+levenshtein_t *levenshtein_create(const char *term, unsigned max_edits);
+
+/**
+ * @brief Destroy an automaton
+ * @note this is safe to call with `lev` == NULL, where it simply returns
+ */
+void levenshtein_destroy(levenshtein_t *lev);
+
+/**
+ * @brief Get the number of bytes of a state (row)
+ */
+size_t levenshtein_state_size(const levenshtein_t *lev);
+
+/**
+ * @brief Write the start state, i.e. the state after reading the empty string
+ * @param lev: pointer to automaton
+ * @param state: buffer of `levenshtein_state_size` bytes
+ */
+void levenshtein_start(const levenshtein_t *lev, uint8_t *state);
+
+/**
+ * @brief Read one character
+ * @param lev: pointer to automaton
+ * @param state: the current state
+ * @param c: the character
+ * @param next: buffer of `levenshtein_state_size` bytes, set to the state after reading `c`
+ * @returns false if the next state is dead, i.e. no string continuing from it is accepted
+ */
+bool levenshtein_step(const levenshtein_t *lev, const uint8_t *state, char c, uint8_t *next);
+
+/**
+ * @brief Find the smallest character greater than `c` that leads from `state` to a state that is not dead.
+ * Every character that does not occur in the term behaves the same, so this only has to try the characters
+ * of the term, and one character that is not in it.
+ *
+ * @param lev: pointer to automaton
+ * @param state: the current state
+ * @param c: the character to search from
+ * @param scratch: buffer of `levenshtein_state_size` bytes, overwritten
+ * @returns the character, or -1 if there is none
+ */
+int levenshtein_next_char(const levenshtein_t *lev, const uint8_t *state, uint8_t c, uint8_t *scratch);
+
+/**
+ * @brief Check whether the string read so far is accepted, i.e. within the maximum distance of the term
+ */
+bool levenshtein_accepts(const levenshtein_t *lev, const uint8_t *state);
+
+
+#endif /* LEVENSHTEIN_H */
@@ -144,4 +144,13 @@ void list_resetiter(list_iter_t *iter);
 
 void *list_peek(list_iter_t *iter);
 
+/**
+ * @brief Copy the items of a list into an array, in order, without allocating an iterator
+ * @param list: pointer to list
+ * @param out: array of at least `n` items
+ * @param n: the most items to copy
+ * @returns the number of items copied
+ */
+size_t list_toarray(list_t *list, void **out, size_t n);
+
 #endif /* LIST_H */
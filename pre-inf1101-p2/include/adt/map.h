@@ -45,6 +45,30 @@ typedef struct entry {
  */
 map_t *map_create(cmp_fn cmpfn, hash64_fn hashfn);
 
+/**
+ * @brief Creates a new, empty map, presized to hold `capacity` entries without having to grow. Otherwise
+ * identical to `map_create`.
+ *
+ * @param cmpfn: function for comparing keys
+ * @param hashfn: function for hashing entry keys
+ * @param capacity: expected number of entries. This is only a hint - the map will still grow past it if
+ * needed. 0 gives the default initial size.
+ *
+ * @returns NULL on error, otherwise a pointer to the newly created map
+ */
+map_t *map_create_with_capacity(cmp_fn cmpfn, hash64_fn hashfn, size_t capacity);
+
+/**
+ * @brief Make room for (at least) `n_entries` entries in total, so that the map does not have to grow
+ * while they are inserted. Never shrinks the map.
+ *
+ * @param map: pointer to a map
+ * @param n_entries: total number of entries the map should be able to hold
+ *
+ * @returns 0 on success, otherwise a negative error code. The map is left unchanged on failure.
+ */
+int map_reserve(map_t *map, size_t n_entries);
+
 /**
  * @brief Destroys the given map. Optional functionality to also destroy values
  * @param map: pointer to a map
@@ -103,6 +127,54 @@ entry_t *map_remove(map_t *map, void *key);
  */
 entry_t *map_get(map_t *map, void *key);
 
+/**
+ * @brief Get the entries associated with a batch of keys. Equivalent to calling `map_get` for each key, but
+ * lets the implementation overlap the memory latency of independent lookups (e.g. by hashing all keys and
+ * prefetching their buckets before resolving any of them).
+ *
+ * @param map: pointer to a map
+ * @param keys: array of `n` keys. Duplicates are allowed.
+ * @param n: number of keys
+ * @param out_entries: caller-provided array of (at least) `n` entry pointers. `out_entries[i]` is set to the
+ * entry associated with `keys[i]`, or NULL if the key is not present in the map.
+ *
+ * @returns The number of keys that were found
+ *
+ * @warning The returned entries are borrowed to the caller by the map, see `map_get`.
+ */
+size_t map_get_batch(map_t *map, void **keys, size_t n, entry_t **out_entries);
+
+/**
+ * Number of bins in the chain length histogram of `map_stats_t`
+ */
+#define MAP_STATS_HIST_LEN 8
+
+/**
+ * Introspection data of a map, filled in by `map_stats`. Intended for tuning hash functions and load factors
+ * against real data. Fields that make no sense for the underlying implementation are left as 0.
+ */
+typedef struct map_stats {
+    size_t length;      // number of entries
+    size_t capacity;    // number of buckets
+    double load_factor; // length / capacity
+    size_t max_chain;   // length of the longest chain
+    /**
+     * chain_hist[i] is the number of buckets with a chain of length i. The last bin counts all chains of
+     * length MAP_STATS_HIST_LEN - 1 or longer.
+     */
+    size_t chain_hist[MAP_STATS_HIST_LEN];
+    size_t n_resizes;   // number of times the map has been resized (grown and rehashed)
+    double resize_secs; // total time spent resizing, in seconds
+    size_t bytes;       // memory used by the map itself, not counting keys and values
+} map_stats_t;
+
+/**
+ * @brief Collect statistics on the internal state of a map. This is O(n) for most implementations.
+ * @param map: pointer to a map
+ * @param stats: pointer to stats to fill in
+ */
+void map_stats(map_t *map, map_stats_t *stats);
+
 /**
  * Type of map iterator. `map_iter_t` is an alias for `struct map_iter`
  */
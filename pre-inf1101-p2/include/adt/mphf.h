@@ -0,0 +1,59 @@
+/**
+ * @brief Minimal perfect hash function over a fixed set of 64-bit key hashes, BBHash style.
+ *
+ * Maps each of the `n` hashes it is built from to a distinct slot in [0, n), using a few bits per key. The keys
+ * themselves are not stored, so any other hash is mapped to some slot as well (or to `n`). Callers that need to
+ * reject unknown keys store a fingerprint of the key in each slot, and compare against it.
+ *
+ * The hashes are placed in levels of bit arrays. Every hash is hashed again to a position in the first level,
+ * and those that end up alone at their position keep it. The rest move on to the next (smaller) level, and so
+ * on. A slot is the number of set bits before the position of the hash, across all levels.
+ */
+
+#ifndef MPHF_H
+#define MPHF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Type of minimal perfect hash function. `mphf_t` is an alias for `struct mphf`
+ */
+typedef struct mphf mphf_t;
+
+/**
+ * @brief Build a minimal perfect hash function
+ * @param hashes: array of `n` distinct hashes. Should be well mixed, e.g. FNV-1a of strings.
+ * @param n: number of hashes, less than 2^32
+ * @returns the function, or NULL on failure (including duplicate hashes)
+ */
+mphf_t *mphf_build(const uint64_t *hashes, size_t n);
+
+/**
+ * @brief Destroy a minimal perfect hash function
+ * @note this is safe to call with `mphf` == NULL, where it simply returns
+ */
+void mphf_destroy(mphf_t *mphf);
+
+/**
+ * @brief Get the slot of a hash
+ * @param mphf: pointer to function
+ * @param hash: hash to look up
+ * @returns the slot of the hash, in the range [0, n), if it was one of the hashes the function was built from.
+ * Otherwise either some slot in that range, or `n`.
+ */
+size_t mphf_lookup(const mphf_t *mphf, uint64_t hash);
+
+/**
+ * @brief Get the memory used by a minimal perfect hash function, in bytes
+ */
+size_t mphf_bytes(const mphf_t *mphf);
+
+/**
+ * @brief Get the number of levels of a minimal perfect hash function. Lookups of known hashes probe one
+ * level per level they have to pass through, i.e. at most this many.
+ */
+size_t mphf_levels(const mphf_t *mphf);
+
+
+#endif /* MPHF_H */
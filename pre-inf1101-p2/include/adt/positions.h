@@ -0,0 +1,75 @@
+/**
+ * @brief Position lists of a term: for every document containing the term, the positions (token offsets) it
+ * occurs at.
+ *
+ * Positions are appended document by document, in the same order as the postings of the term, and are
+ * compressed: the first position in a document is stored as is, and every following one as the gap from the
+ * one before it, all as varints (7 bits per byte). Gaps are mostly small, so most positions take up one byte.
+ *
+ * The byte offset where each document starts is kept alongside, so the positions of any one document can be
+ * decoded without decoding those before it.
+ */
+
+#ifndef POSITIONS_H
+#define POSITIONS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Type of position lists. `positions_t` is an alias for `struct positions`
+ */
+typedef struct positions {
+    uint8_t *data; // the encoded positions of every document
+    size_t len;
+    size_t capacity;
+    uint32_t *offsets; // offsets[i] is the byte offset in `data` of the positions of the i-th document
+    size_t n_docs;
+    size_t offsets_capacity;
+    uint32_t last; // the last position appended, which the next one in the same document is a gap from
+} positions_t;
+
+/**
+ * @brief Initialize empty position lists
+ */
+void positions_init(positions_t *p);
+
+/**
+ * @brief Free the arrays of position lists. Does not free `p` itself.
+ */
+void positions_deinit(positions_t *p);
+
+/**
+ * @brief Make room for one more position, whether it is in a new document or not. The next `positions_add`
+ * is then guaranteed to succeed.
+ * @returns 0 on success, otherwise a negative error code
+ */
+int positions_reserve(positions_t *p);
+
+/**
+ * @brief Append a position
+ * @param p: pointer to position lists
+ * @param new_doc: true if this is the first position in a new document, false if it is in the same document as
+ * the previous one
+ * @param pos: the position. Must be greater than the previous one, if in the same document.
+ * @returns 0 on success, otherwise a negative error code. The lists are left unchanged on failure.
+ */
+int positions_add(positions_t *p, bool new_doc, uint32_t pos);
+
+/**
+ * @brief Decode the positions of a document
+ * @param p: pointer to position lists
+ * @param i: index of the document, i.e. its index in the postings of the term
+ * @param count: number of positions in the document, i.e. the frequency of the term in it
+ * @param out: array of at least `count` positions, set to the positions in increasing order
+ */
+void positions_decode(const positions_t *p, size_t i, uint32_t count, uint32_t *out);
+
+/**
+ * @brief Get the memory used by position lists, not counting the struct itself
+ */
+size_t positions_bytes(const positions_t *p);
+
+
+#endif /* POSITIONS_H */
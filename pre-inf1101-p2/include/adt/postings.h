@@ -0,0 +1,152 @@
+/**
+ * @brief Postings list: the documents containing a term, along with the frequency of the term in each.
+ *
+ * Documents are kept as a sorted array of IDs, with the frequencies in a parallel array, so that walking the
+ * documents alone touches nothing else. Documents are appended in increasing ID order, which is the order
+ * the index assigns them in.
+ *
+ * Most terms occur in only one or two documents. Lists that short are stored inline, in the space the struct
+ * otherwise uses for its array pointers, and only get arrays of their own once they outgrow it.
+ *
+ * The struct is transparent so that callers walking a list (e.g. scoring) can read it without a function
+ * call per document. Get the arrays with `postings_docs` and `postings_freqs` rather than through the union.
+ */
+
+#ifndef POSTINGS_H
+#define POSTINGS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "docset.h"
+
+/**
+ * Number of documents a list can hold inline: as many (document, frequency) pairs as fit in two pointers
+ */
+#define POSTINGS_INLINE_CAPACITY ((2 * sizeof(void *)) / (sizeof(doc_id_t) + sizeof(uint32_t)))
+
+/**
+ * Type of postings list. `postings_t` is an alias for `struct postings`
+ */
+typedef struct postings {
+    /* docs: document IDs, strictly increasing. freqs[i] is the frequency of the term in docs[i].
+        Inline while the capacity is at most POSTINGS_INLINE_CAPACITY */
+    union {
+        struct {
+            doc_id_t *docs;
+            uint32_t *freqs;
+        } heap;
+        struct {
+            doc_id_t docs[POSTINGS_INLINE_CAPACITY];
+            uint32_t freqs[POSTINGS_INLINE_CAPACITY];
+        } inl;
+    } store;
+
+    uint8_t *impacts; // impacts[i] is the quantised score contribution of docs[i], NULL until computed
+    size_t len;
+    size_t capacity;
+
+    /* optional copy of the list ordered by decreasing impact, see `postings_order_by_impact` */
+    doc_id_t *impact_docs;
+    uint8_t *impact_levels; // impact_levels[i] is the impact of impact_docs[i]
+} postings_t;
+
+/**
+ * @brief Check whether the documents of a list are stored inline
+ */
+static inline bool postings_is_inline(const postings_t *p) {
+    return p->capacity <= POSTINGS_INLINE_CAPACITY;
+}
+
+/**
+ * @brief Get the document IDs of a list, in increasing order
+ * @param p: pointer to postings list
+ * @returns array of `p->len` document IDs. Invalidated by `postings_add`.
+ */
+static inline const doc_id_t *postings_docs(const postings_t *p) {
+    return postings_is_inline(p) ? p->store.inl.docs : p->store.heap.docs;
+}
+
+/**
+ * @brief Get the frequencies of the term in each document of a list
+ * @param p: pointer to postings list
+ * @returns array of `p->len` frequencies, in the same order as `postings_docs`. Invalidated by `postings_add`.
+ */
+static inline const uint32_t *postings_freqs(const postings_t *p) {
+    return postings_is_inline(p) ? p->store.inl.freqs : p->store.heap.freqs;
+}
+
+/**
+ * @brief Initialize an empty postings list
+ * @param p: pointer to postings list
+ */
+void postings_init(postings_t *p);
+
+/**
+ * @brief Free the arrays of a postings list. Does not free `p` itself.
+ * @param p: pointer to postings list
+ */
+void postings_deinit(postings_t *p);
+
+/**
+ * @brief Count one more occurrence of the term in `doc`. If `doc` is the last document of the list, its
+ * frequency is incremented. Otherwise, it is appended with a frequency of 1.
+ *
+ * @param p: pointer to postings list
+ * @param doc: ID of the document. Must be greater than or equal to the last document of the list.
+ *
+ * @returns 0 on success, otherwise a negative error code. The list is left unchanged on failure.
+ */
+int postings_add(postings_t *p, doc_id_t doc);
+
+/**
+ * @brief Find the first position at or after `from` where the document ID is at least `doc`. Searches by
+ * galloping (exponential search followed by binary search), so skipping `k` positions costs O(log k).
+ *
+ * @param p: pointer to postings list
+ * @param from: position to start searching from
+ * @param doc: document ID to search for
+ *
+ * @returns The found position, or `p->len` if every document from `from` and out is less than `doc`
+ */
+size_t postings_seek(const postings_t *p, size_t from, doc_id_t doc);
+
+/**
+ * @brief Like `postings_seek`, in any array of strictly increasing document IDs
+ * @param docs: the documents
+ * @param len: number of documents
+ * @param from: position to start searching from
+ * @param doc: document ID to search for
+ *
+ * @returns The found position, or `len` if every document from `from` and out is less than `doc`
+ */
+size_t docs_seek(const doc_id_t *docs, size_t len, size_t from, doc_id_t doc);
+
+/**
+ * @brief Make room for one impact per document of the list. The contents of the impacts are left to the
+ * caller, who is expected to fill in all `p->len` of them.
+ *
+ * @param p: pointer to postings list
+ * @returns 0 on success, otherwise a negative error code. The previous impacts (if any) are kept on failure.
+ */
+int postings_reserve_impacts(postings_t *p);
+
+/**
+ * @brief Build the impact ordered copy of the list from its impacts: the documents sorted by decreasing impact,
+ * and by increasing ID within an impact. Replaces any previous copy.
+ *
+ * @param p: pointer to postings list. All `p->len` impacts must be filled in.
+ * @returns 0 on success, otherwise a negative error code
+ */
+int postings_order_by_impact(postings_t *p);
+
+/**
+ * @brief Get the memory used by the postings list, not counting the struct itself
+ * @param p: pointer to postings list
+ * @returns number of bytes allocated
+ */
+size_t postings_bytes(const postings_t *p);
+
+
+#endif /* POSTINGS_H */
@@ -0,0 +1,151 @@
+/**
+ * @brief A query compiled to a flat postfix program, which is opened as a tree of cursors to find its documents.
+ *
+ * The ast of a query is a tree of individually allocated nodes. A program is the same query as one array of
+ * instructions in postfix order: each leaf pushes its documents, and each operator pops the results of its two
+ * operands and pushes its own. Walking the array once is all it takes to score the query, or to open it.
+ *
+ * The right side of an ANDNOT is often a single common term, as in `x &! the`. Rather than reading its postings
+ * whole, `OP_EXCLUDE` seeks ahead in them to each document of the left side in turn, so the cost depends on the
+ * left side alone (and only logarithmically on the right side).
+ *
+ * A program holds the query twice. `code` is the query as it was written, which scoring runs on the scores of
+ * the leaves. `match` is the query rewritten to find the same documents with less work, which is what is run
+ * to find them. The rewriting is boolean algebra: terms that are not in the index match nothing, `a && a` is
+ * `a`, `a || (a && b)` is `a`, `a &! a` matches nothing, and so on. Equal subqueries are only evaluated once,
+ * and their result saved for the next time it is needed.
+ *
+ * A program is opened as a tree of cursors (see `cursor.h`), to walk its documents one at a time without
+ * building a result per operator. Only phrases, whose positions cursors do not walk, and results that are used
+ * more than once, which a cursor could only walk once, are built up front.
+ *
+ * The leaves of a program are numbered in the order they are written in the query, which is also the
+ * pre-order of the ast (see `ast_collect_terms`). A compiled program owns its terms, so it outlives its ast,
+ * and can be cached.
+ *
+ * The structs are transparent so that scoring can walk the instructions itself.
+ */
+
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ast.h"
+#include "cursor.h"
+#include "docset.h"
+#include "postings.h"
+
+// forward declaration
+struct index;
+typedef struct index index_t;
+
+/**
+ * Operation of an instruction
+ */
+typedef enum opcode {
+    OP_EMPTY,   // push no documents
+    OP_TERM,    // push the documents of leaf `leaf`
+    OP_UNION,   // push the documents of any of the leaves [leaf, leaf + n_leaves), i.e. a prefix, fuzzy term or
+                // substring
+    OP_PHRASE,  // push the documents with the leaves [leaf, leaf + n_leaves) at their offsets from each other
+    OP_AND,     // pop two results, push their intersection
+    OP_OR,      // pop two results, push their union
+    OP_ANDNOT,  // pop two results, push the documents of the first that are not in the second
+    OP_EXCLUDE, // pop a result, push its documents that none of the leaves [leaf, leaf + n_leaves) have
+    OP_SAVE,    // save the result on top of the stack in slot `leaf`, leaving it there
+    OP_LOAD     // push the result saved in slot `leaf`
+} opcode_t;
+
+/**
+ * Type of instruction. Operators leave `leaf` and `n_leaves` at 0, and `OP_SAVE`/`OP_LOAD` use `leaf` as slot.
+ */
+typedef struct instr {
+    opcode_t op;
+    uint32_t leaf;
+    uint32_t n_leaves;
+} instr_t;
+
+/**
+ * Type of program. `program_t` is an alias for `struct program`
+ */
+typedef struct program {
+    instr_t *code;      // the query as written, for scoring
+    size_t n_code;
+    size_t max_depth;   // deepest the stack gets while running `code`
+    instr_t *match;     // the rewritten query, for finding the documents
+    size_t n_match;
+    size_t match_depth; // deepest the stack gets while running `match`
+    size_t n_slots;     // number of results `match` saves
+    char **terms;       // the term of each leaf, pointing into `strings`
+    char *strings;      // the terms, back to back with their null terminators
+    uint32_t *offsets;  // position of each leaf in its phrase, 0 outside phrases
+    size_t n_leaves;
+} program_t;
+
+/**
+ * Scratch space for opening programs, reused by every program opened with it. Initialize it to all zero.
+ */
+typedef struct program_scratch {
+    size_t *sizes; // the most documents of each result on the stack, while sizing what is built up front
+    size_t sizes_capacity;
+    const postings_t **postings; // postings of each leaf
+    size_t postings_capacity;
+    doc_id_t *saved; // saved results, back to back
+    size_t saved_capacity;
+    size_t *slots;   // start of each saved result in `saved`, followed by its length
+    size_t slots_capacity;
+    cursor_t *nodes;     // cursors of an opened program
+    size_t nodes_capacity;
+    cursor_t **operands; // stack of cursors while opening a program
+    size_t operands_capacity;
+} program_scratch_t;
+
+/**
+ * @brief Compile a query
+ * @param ast: the query, with its prefixes, fuzzy terms and substrings expanded (see `index_expand_terms`)
+ * @param index: the index the query is for. Its terms are looked up to rewrite the query.
+ * @returns the program, or NULL on failure
+ *
+ * @note the program copies what it needs of the ast, which may be destroyed right after. It is only valid for
+ * the index as it is, since a term that is not in the index is rewritten as matching nothing.
+ */
+program_t *program_compile(AST *ast, index_t *index);
+
+/**
+ * @brief Destroy a program
+ * @note this is safe to call with `program` == NULL, where it simply returns
+ */
+void program_destroy(program_t *program);
+
+/**
+ * @brief Check whether a program only ORs terms together, i.e. whether every document matching any of its
+ * leaves matches the program (as written)
+ */
+bool program_is_disjunction(const program_t *program);
+
+/**
+ * @brief Open a program on an index as a tree of cursors, which walks the documents of its rewritten query
+ * @param program: the program
+ * @param index: the index to find the documents in
+ * @param scratch: scratch space, see `program_scratch_t`. Holds the cursors, so it must not be used for
+ * another program while they are walked.
+ * @param out_root: set to the root cursor, on the first matching document
+ * @param errmsg: Caller-provided buffer to write error messages to (min. buffer size = LINE_MAX)
+ * @returns 0 on success, otherwise a negative error code, with `errmsg` set
+ *
+ * @note the cursors walk the postings of the index, and are only valid until it is changed
+ */
+int program_open(
+    const program_t *program, index_t *index, program_scratch_t *scratch, cursor_t **out_root, char *errmsg
+);
+
+/**
+ * @brief Free the scratch space for opening programs. Does not free `scratch` itself.
+ */
+void program_scratch_deinit(program_scratch_t *scratch);
+
+
+#endif /* PROGRAM_H */
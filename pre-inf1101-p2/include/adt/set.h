@@ -112,6 +112,24 @@ set_t *set_difference(set_t *a, set_t *b);
  */
 cmp_fn set_get_cmpfn(set_t *set); // From ai
 
+/**
+ * Introspection data of a set, filled in by `set_stats`. Fields that make no sense for the underlying
+ * implementation are left as 0.
+ */
+typedef struct set_stats {
+    size_t length;      // number of elements
+    size_t height;      // height of the tree, 0 if empty
+    size_t n_rotations; // number of rotations performed to keep the tree balanced
+    size_t bytes;       // memory used by the set itself, not counting the elements
+} set_stats_t;
+
+/**
+ * @brief Collect statistics on the internal state of a set. This is O(n) for most implementations.
+ * @param set: pointer to a set
+ * @param stats: pointer to stats to fill in
+ */
+void set_stats(set_t *set, set_stats_t *stats);
+
 /**
  * Type of set iterator. `set_iter_t` is an alias for `struct set_iter`
  */
@@ -0,0 +1,20 @@
+/**
+ * @brief String keyed maps used by the index, generated from `typedmap.h`.
+ *
+ * - `strmap`: string -> pointer
+ *
+ * The maps do not own their keys. Ownership is up to the user, see the `destroy` functions.
+ */
+
+#ifndef STRTYPES_H
+#define STRTYPES_H
+
+#include <stddef.h>
+#include <string.h>
+
+#include "common.h"
+#include "typedmap.h"
+
+DEFINE_MAP(strmap, char *, void *, strcmp, fnv1a64_str)
+
+#endif /* STRTYPES_H */
@@ -0,0 +1,161 @@
+/**
+ * @brief Immutable, sorted dictionary of strings, each mapped to a 32-bit value.
+ *
+ * Terms are front coded: they are stored in sorted order, in blocks of `TERMDICT_BLOCK_SIZE`, where the first
+ * term of a block is stored in full and every following term only as the length of the prefix it shares with
+ * the term before it, and the rest of the term. Sorted vocabularies share long prefixes, so this is several
+ * times smaller than storing every term on its own.
+ *
+ * Exact lookups binary search the first terms of the blocks, then scan a single block. Terms can also be
+ * enumerated in order by prefix, by (lexicographic) range, or by edit distance to a term.
+ */
+
+#ifndef TERMDICT_H
+#define TERMDICT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Number of terms per block. Lookups scan up to this many terms, and each block stores its first term in full.
+ */
+#define TERMDICT_BLOCK_SIZE 16
+
+/**
+ * Type of dictionary. `termdict_t` is an alias for `struct termdict`
+ */
+typedef struct termdict termdict_t;
+
+/**
+ * Type of dictionary iterator. The fields are private.
+ */
+typedef struct termdict_iter {
+    const termdict_t *dict;
+    size_t pos;         // position of the next term
+    size_t offset;      // byte offset of the next term
+    char *term;         // the current term, decoded
+    uint32_t value;     // value of the current term
+    int pending;        // 1 if the current term is yet to be returned
+    const char *prefix; // if not NULL, stop at the first term without this prefix
+    size_t prefix_len;
+    const char *hi;     // if not NULL, stop at the first term >= this
+
+    /* if `fuzzy` is not NULL, only terms the automaton accepts are returned, see `termdict_iter_fuzzy` */
+    struct levenshtein *fuzzy;
+    uint8_t *states;     // state of the automaton after each prefix of `term`
+    size_t states_depth; // length of the longest prefix of `term` that has a valid state
+    char *bound;         // scratch space for the term to skip ahead to
+    size_t visited;      // number of terms decoded so far
+} termdict_iter_t;
+
+/**
+ * @brief Build a dictionary
+ * @param terms: array of `n` strings, strictly increasing by `strcmp`
+ * @param values: array of `n` values, where `values[i]` belongs to `terms[i]`
+ * @param n: number of terms
+ * @returns the dictionary, or NULL on failure (including terms not being strictly increasing)
+ *
+ * @note The dictionary keeps its own copy of the terms
+ */
+termdict_t *termdict_build(const char **terms, const uint32_t *values, size_t n);
+
+/**
+ * @brief Destroy a dictionary
+ * @note this is safe to call with `dict` == NULL, where it simply returns
+ */
+void termdict_destroy(termdict_t *dict);
+
+/**
+ * @brief Get the number of terms in a dictionary
+ */
+size_t termdict_length(const termdict_t *dict);
+
+/**
+ * @brief Get the memory used by a dictionary, in bytes
+ */
+size_t termdict_bytes(const termdict_t *dict);
+
+/**
+ * @brief Get the sum of the lengths of every term, i.e. their size stored without front coding
+ */
+size_t termdict_raw_bytes(const termdict_t *dict);
+
+/**
+ * @brief Look up the value of a term
+ * @param dict: pointer to dictionary
+ * @param term: term to look up
+ * @param value: set to the value of the term, if found
+ * @returns 1 if the term was found, otherwise 0
+ */
+int termdict_get(const termdict_t *dict, const char *term, uint32_t *value);
+
+/**
+ * @brief Find the positions of the terms starting with a prefix
+ * @param dict: pointer to dictionary
+ * @param prefix: the prefix
+ * @param lo: set to the position (in sorted order) of the first term with the prefix
+ * @param hi: set to the position after the last term with the prefix. Equal to `lo` if there are none.
+ * @returns 0 on success, otherwise a negative error code
+ */
+int termdict_prefix_range(const termdict_t *dict, const char *prefix, size_t *lo, size_t *hi);
+
+/**
+ * @brief Initialize an iterator over the terms in the range [lo, hi), in order
+ * @param dict: pointer to dictionary
+ * @param iter: iterator to initialize
+ * @param lo: nullable. If given, start at the first term >= lo
+ * @param hi: nullable. If given, stop at the first term >= hi. Must outlive the iterator.
+ * @returns 0 on success, otherwise a negative error code
+ */
+int termdict_iter_range(const termdict_t *dict, termdict_iter_t *iter, const char *lo, const char *hi);
+
+/**
+ * @brief Initialize an iterator over the terms starting with `prefix`, in order
+ * @param dict: pointer to dictionary
+ * @param iter: iterator to initialize
+ * @param prefix: prefix of the terms to iterate. Must outlive the iterator.
+ * @returns 0 on success, otherwise a negative error code
+ */
+int termdict_iter_prefix(const termdict_t *dict, termdict_iter_t *iter, const char *prefix);
+
+/**
+ * @brief Initialize an iterator over the terms within an edit distance of `term`, in order
+ *
+ * The terms are intersected with a Levenshtein automaton (see `levenshtein.h`). Terms sharing a prefix with
+ * the one before them only step the automaton through the rest, and once a prefix can no longer lead to a
+ * match, every term starting with it is skipped by searching for the next term past them. Only a small part
+ * of the dictionary is decoded, see the `visited` field.
+ *
+ * @param dict: pointer to dictionary
+ * @param iter: iterator to initialize
+ * @param term: term to match
+ * @param max_edits: maximum edit distance, at most LEVENSHTEIN_MAX_EDITS
+ * @returns 0 on success, otherwise a negative error code
+ */
+int termdict_iter_fuzzy(const termdict_t *dict, termdict_iter_t *iter, const char *term, unsigned max_edits);
+
+/**
+ * @brief Move an iterator forward to the term at position `pos` of the dictionary (in sorted order), which
+ * the next call to `termdict_iter_next` then returns. Jumps straight to the block of the term, and only
+ * decodes the terms before it in that block.
+ * @param iter: pointer to iterator, initialized with `termdict_iter_range`
+ * @param pos: position of the term, at or after that of the term the iterator would return next
+ * @returns 0 on success, or a negative error code if `pos` is out of range or behind the iterator
+ */
+int termdict_iter_seek_pos(termdict_iter_t *iter, size_t pos);
+
+/**
+ * @brief Get the next term of an iterator
+ * @param iter: pointer to iterator
+ * @param value: nullable. Set to the value of the term.
+ * @returns the term, or NULL when done. Owned by the iterator, and only valid until the next call.
+ */
+const char *termdict_iter_next(termdict_iter_t *iter, uint32_t *value);
+
+/**
+ * @brief Free the resources of an iterator. Does not free `iter` itself.
+ */
+void termdict_iter_deinit(termdict_iter_t *iter);
+
+
+#endif /* TERMDICT_H */
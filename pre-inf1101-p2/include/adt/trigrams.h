@@ -0,0 +1,78 @@
+/**
+ * @brief Trigram index of a set of terms: for every sequence of three characters, the ids of the terms
+ * containing it.
+ *
+ * Every term containing a string of three or more characters contains each of its trigrams, so the terms
+ * containing the string are among those found in the lists of all of them. Intersecting the lists gives a
+ * small set of candidates, which are then checked against the string itself, rather than every term.
+ *
+ * Terms are added with increasing ids, so each list is sorted, and can be intersected in a single merge.
+ */
+
+#ifndef TRIGRAMS_H
+#define TRIGRAMS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+/**
+ * Number of characters of an n-gram
+ */
+#define TRIGRAM_LEN 3
+
+/**
+ * Type of trigram index. `trigrams_t` is an alias for `struct trigrams`
+ */
+typedef struct trigrams trigrams_t;
+
+/**
+ * @brief Create an empty trigram index
+ * @returns the index, or NULL on failure
+ */
+trigrams_t *trigrams_create(void);
+
+/**
+ * @brief Destroy a trigram index
+ * @note this is safe to call with `trigrams` == NULL, where it simply returns
+ */
+void trigrams_destroy(trigrams_t *trigrams);
+
+/**
+ * @brief Add the trigrams of a term. Terms shorter than `TRIGRAM_LEN` have none, and are not added.
+ * @param trigrams: pointer to trigram index
+ * @param term: the term
+ * @param id: id of the term. Must be greater than that of every term added before it.
+ * @returns 0 on success, otherwise a negative error code. The term may be partially added on failure.
+ */
+int trigrams_add(trigrams_t *trigrams, const char *term, uint32_t id);
+
+/**
+ * @brief Find the terms that may contain a string, i.e. those that contain each of its trigrams
+ * @param trigrams: pointer to trigram index
+ * @param str: the string, at least `TRIGRAM_LEN` characters long
+ * @param arena: the arena to allocate the candidates, and the lists they are found in, from
+ * @param out_ids: set to an array of the ids of the candidates, in increasing order, allocated from `arena`.
+ * NULL if there are none.
+ * @param out_n: set to the number of candidates
+ * @returns 0 on success, otherwise a negative error code
+ *
+ * @note A candidate contains every trigram of `str`, but not necessarily `str` itself.
+ */
+int trigrams_candidates(
+    const trigrams_t *trigrams, const char *str, arena_t *arena, uint32_t **out_ids, size_t *out_n
+);
+
+/**
+ * @brief Get the number of distinct trigrams in the index
+ */
+size_t trigrams_length(const trigrams_t *trigrams);
+
+/**
+ * @brief Get the memory used by a trigram index, in bytes
+ */
+size_t trigrams_bytes(const trigrams_t *trigrams);
+
+
+#endif /* TRIGRAMS_H */
@@ -0,0 +1,409 @@
+/**
+ * @implements map.h (as a template)
+ *
+ * @brief Type-specialised hash map with separate chaining, generated at compile time.
+ *
+ * `hashmap.c` goes through `cmp_fn`/`hash64_fn` function pointers for every comparison and hash, which keeps
+ * the compiler from inlining them. `DEFINE_MAP` instead generates a map for one specific key/value type,
+ * with the comparison and hash function inlined into every operation. The behavior mirrors `hashmap.c`:
+ * the map starts at `TYPEDMAP_N_BUCKETS_INITIAL` buckets and doubles when a collision occurs at or above
+ * the `TYPEDMAP_LF_GROW` load factor.
+ *
+ * Differences from the generic map:
+ * - values are stored by value, and entries live inside the chain nodes (one allocation per entry)
+ * - the hash of each key is cached in its node, so resizing never rehashes keys, and chains compare hashes
+ *   before keys
+ * - `_put` is a find-or-insert, which avoids hashing twice for the common "get, insert if missing" pattern
+ * - iterators live on the stack
+ *
+ * `DEFINE_MAP(name, key_type, val_type, cmpfn, hashfn)` generates:
+ *
+ * - `name_t`, `name_entry_t` (with the fields `key` and `val`), `name_iter_t`
+ * - `name_t *name_create(void)`
+ * - `name_t *name_create_with_capacity(size_t capacity)`
+ * - `int name_reserve(name_t *map, size_t n_entries)`
+ * - `void name_destroy(name_t *map, void (*entry_freefn)(name_entry_t *))`
+ * - `size_t name_length(name_t *map)`
+ * - `name_entry_t *name_put(name_t *map, key_type key, int *inserted)`
+ * - `name_entry_t *name_get(name_t *map, key_type key)`
+ * - `size_t name_get_batch(name_t *map, key_type const *keys, size_t n, name_entry_t **out_entries)`
+ * - `int name_remove(name_t *map, key_type key, name_entry_t *removed)`
+ * - `void name_stats(name_t *map, map_stats_t *stats)`
+ * - `void name_iter_init(name_t *map, name_iter_t *iter)`, `int name_hasnext(name_iter_t *iter)`,
+ *   `name_entry_t *name_next(name_iter_t *iter)`
+ *
+ * `cmpfn(a, b)` must return 0 if the keys are equal, and `hashfn(key)` must return a `uint64_t`. Both should
+ * be visible to the compiler (e.g. `static inline`) for them to be inlined.
+ *
+ * All generated functions are `static inline`, so a map may be defined in a header shared between several
+ * translation units.
+ *
+ * @note Like the generic map, the generated maps PANIC on allocation failure during insertion.
+ */
+
+#ifndef TYPEDMAP_H
+#define TYPEDMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "printing.h"
+#include "defs.h"
+#include "map.h"
+
+/* how many buckets each map should start with. Must be a power of two. */
+#define TYPEDMAP_N_BUCKETS_INITIAL 16
+
+/* double the number of buckets when a collision occurs at or above this load factor threshold */
+#define TYPEDMAP_LF_GROW 0.75
+
+/* number of keys `_get_batch` hashes and prefetches before resolving any of them */
+#define TYPEDMAP_BATCH_GROUP_SIZE 16
+
+#if defined(__GNUC__) || defined(__clang__)
+#  define TYPEDMAP_PREFETCH(addr) __builtin_prefetch((addr), 0, 3)
+#else
+#  define TYPEDMAP_PREFETCH(addr) ((void) (addr))
+#endif
+
+/* the length threshold where a map of the given capacity will grow on a collision */
+static inline size_t typedmap_rehash_threshold(size_t capacity) {
+    return (size_t) ((double) capacity * TYPEDMAP_LF_GROW);
+}
+
+/* number of buckets needed to hold `n_entries` entries below the load factor threshold */
+static inline size_t typedmap_capacity_for(size_t n_entries) {
+    size_t capacity = TYPEDMAP_N_BUCKETS_INITIAL;
+
+    while (typedmap_rehash_threshold(capacity) <= n_entries) {
+        capacity *= 2;
+    }
+
+    return capacity;
+}
+
+/* seconds elapsed since `t_start` */
+static inline double typedmap_secs_since(struct timespec *t_start) {
+    struct timespec t_end;
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+    return (double) (t_end.tv_sec - t_start->tv_sec) + (double) (t_end.tv_nsec - t_start->tv_nsec) / 1.0E9;
+}
+
+#define DEFINE_MAP(name, key_type, val_type, cmpfn, hashfn)                                                  \
+                                                                                                             \
+    typedef key_type name##_key_t;                                                                           \
+    typedef val_type name##_val_t;                                                                           \
+                                                                                                             \
+    typedef struct name##_entry {                                                                            \
+        name##_key_t key;                                                                                    \
+        name##_val_t val;                                                                                    \
+    } name##_entry_t;                                                                                        \
+                                                                                                             \
+    typedef struct name##_node name##_node_t;                                                                \
+    struct name##_node {                                                                                     \
+        name##_entry_t entry;                                                                                \
+        uint64_t hash;                                                                                       \
+        name##_node_t *overflow;                                                                             \
+    };                                                                                                       \
+                                                                                                             \
+    typedef struct name {                                                                                    \
+        name##_node_t **buckets;                                                                             \
+        size_t capacity; /* always a power of two */                                                         \
+        size_t length;                                                                                       \
+        size_t rehash_threshold;                                                                             \
+        size_t n_resizes;                                                                                    \
+        double resize_secs;                                                                                  \
+    } name##_t;                                                                                              \
+                                                                                                             \
+    typedef struct name##_iter {                                                                             \
+        name##_node_t **buckets;                                                                             \
+        name##_node_t *next;                                                                                 \
+        size_t i_curr_bucket;                                                                                \
+        size_t n_remaining;                                                                                  \
+    } name##_iter_t;                                                                                         \
+                                                                                                             \
+    /* resize the bucket array. Hashes are cached in the nodes, so no keys are rehashed. */                  \
+    static inline int name##_resize(name##_t *map, size_t new_capacity) {                                    \
+        struct timespec t_start;                                                                             \
+        clock_gettime(CLOCK_MONOTONIC, &t_start);                                                            \
+                                                                                                             \
+        name##_node_t **new_buckets = calloc(new_capacity, sizeof(name##_node_t *));                         \
+        if (new_buckets == NULL) {                                                                           \
+            return -1;                                                                                       \
+        }                                                                                                    \
+                                                                                                             \
+        for (size_t i_old = 0; i_old < map->capacity; i_old++) {                                             \
+            name##_node_t *node = map->buckets[i_old];                                                       \
+                                                                                                             \
+            while (node) {                                                                                   \
+                name##_node_t *next = node->overflow;                                                        \
+                size_t i_new = node->hash & (new_capacity - 1);                                              \
+                                                                                                             \
+                node->overflow = new_buckets[i_new];                                                         \
+                new_buckets[i_new] = node;                                                                   \
+                node = next;                                                                                 \
+            }                                                                                                \
+        }                                                                                                    \
+                                                                                                             \
+        free(map->buckets);                                                                                  \
+        map->buckets = new_buckets;                                                                          \
+        map->capacity = new_capacity;                                                                        \
+        map->rehash_threshold = typedmap_rehash_threshold(new_capacity);                                     \
+        map->n_resizes += 1;                                                                                 \
+        map->resize_secs += typedmap_secs_since(&t_start);                                                   \
+                                                                                                             \
+        return 0;                                                                                            \
+    }                                                                                                        \
+                                                                                                             \
+    static inline name##_t *name##_create_with_capacity(size_t capacity) {                                   \
+        name##_t *map = malloc(sizeof(name##_t));                                                            \
+        if (map == NULL) {                                                                                   \
+            pr_error("Failed to allocate memory\n");                                                         \
+            return NULL;                                                                                     \
+        }                                                                                                    \
+                                                                                                             \
+        size_t n_buckets = typedmap_capacity_for(capacity);                                                  \
+                                                                                                             \
+        map->buckets = calloc(n_buckets, sizeof(name##_node_t *));                                           \
+        if (map->buckets == NULL) {                                                                          \
+            pr_error("Failed to allocate memory\n");                                                         \
+            free(map);                                                                                       \
+            return NULL;                                                                                     \
+        }                                                                                                    \
+                                                                                                             \
+        map->capacity = n_buckets;                                                                           \
+        map->length = 0;                                                                                     \
+        map->rehash_threshold = typedmap_rehash_threshold(n_buckets);                                        \
+        map->n_resizes = 0;                                                                                  \
+        map->resize_secs = 0.0;                                                                              \
+                                                                                                             \
+        return map;                                                                                          \
+    }                                                                                                        \
+                                                                                                             \
+    static inline name##_t *name##_create(void) {                                                            \
+        return name##_create_with_capacity(0);                                                               \
+    }                                                                                                        \
+                                                                                                             \
+    static inline int name##_reserve(name##_t *map, size_t n_entries) {                                      \
+        size_t new_capacity = typedmap_capacity_for(n_entries);                                              \
+                                                                                                             \
+        if (new_capacity <= map->capacity) {                                                                 \
+            return 0;                                                                                        \
+        }                                                                                                    \
+        return name##_resize(map, new_capacity);                                                             \
+    }                                                                                                        \
+                                                                                                             \
+    /* entry_freefn is nullable. If present, it is called on every entry before it is freed. */              \
+    static inline void name##_destroy(name##_t *map, void (*entry_freefn)(name##_entry_t *)) {               \
+        if (!map) {                                                                                          \
+            return;                                                                                          \
+        }                                                                                                    \
+                                                                                                             \
+        for (size_t i = 0; i < map->capacity; i++) {                                                         \
+            name##_node_t *node = map->buckets[i];                                                           \
+                                                                                                             \
+            while (node) {                                                                                   \
+                name##_node_t *next = node->overflow;                                                        \
+                if (entry_freefn) {                                                                          \
+                    entry_freefn(&node->entry);                                                              \
+                }                                                                                            \
+                free(node);                                                                                  \
+                node = next;                                                                                 \
+            }                                                                                                \
+        }                                                                                                    \
+                                                                                                             \
+        free(map->buckets);                                                                                  \
+        free(map);                                                                                           \
+    }                                                                                                        \
+                                                                                                             \
+    static inline size_t name##_length(name##_t *map) {                                                      \
+        return map->length;                                                                                  \
+    }                                                                                                        \
+                                                                                                             \
+    static inline name##_node_t *name##_find(name##_t *map, name##_key_t key, uint64_t hash) {               \
+        name##_node_t *node = map->buckets[hash & (map->capacity - 1)];                                      \
+                                                                                                             \
+        while (node) {                                                                                       \
+            if (node->hash == hash && cmpfn(node->entry.key, key) == 0) {                                    \
+                return node;                                                                                 \
+            }                                                                                                \
+            node = node->overflow;                                                                           \
+        }                                                                                                    \
+                                                                                                             \
+        return NULL;                                                                                         \
+    }                                                                                                        \
+                                                                                                             \
+    /**                                                                                                      \
+     * Get the entry for `key`, inserting a new entry if it is not present. The value of a new entry is      \
+     * zeroed, and `*inserted` (nullable) is set to 1 - otherwise 0. The returned entry is owned by the map, \
+     * but its value may be modified freely. Its address is stable until the entry is removed.               \
+     */                                                                                                      \
+    static inline name##_entry_t *name##_put(name##_t *map, name##_key_t key, int *inserted) {               \
+        uint64_t hash = hashfn(key);                                                                         \
+        name##_node_t *found = name##_find(map, key, hash);                                                  \
+                                                                                                             \
+        if (inserted) {                                                                                      \
+            *inserted = (found == NULL);                                                                     \
+        }                                                                                                    \
+        if (found) {                                                                                         \
+            return &found->entry;                                                                            \
+        }                                                                                                    \
+                                                                                                             \
+        name##_node_t *new_node = malloc(sizeof(name##_node_t));                                             \
+        if (new_node == NULL) {                                                                              \
+            PANIC("Failed to allocate memory\n");                                                            \
+        }                                                                                                    \
+                                                                                                             \
+        memset(&new_node->entry.val, 0, sizeof(name##_val_t));                                               \
+        new_node->entry.key = key;                                                                           \
+        new_node->hash = hash;                                                                               \
+                                                                                                             \
+        size_t bucket_i = hash & (map->capacity - 1);                                                        \
+        name##_node_t *head = map->buckets[bucket_i];                                                        \
+        new_node->overflow = head;                                                                           \
+        map->buckets[bucket_i] = new_node;                                                                   \
+        map->length++;                                                                                       \
+                                                                                                             \
+        /* on a collision above the load factor, grow & rehash */                                            \
+        if (head && (map->length >= map->rehash_threshold)) {                                                \
+            if (name##_resize(map, map->capacity * 2) != 0) {                                                \
+                PANIC("Failed to rehash\n");                                                                 \
+            }                                                                                                \
+        }                                                                                                    \
+                                                                                                             \
+        return &new_node->entry;                                                                             \
+    }                                                                                                        \
+                                                                                                             \
+    static inline name##_entry_t *name##_get(name##_t *map, name##_key_t key) {                              \
+        name##_node_t *node = name##_find(map, key, hashfn(key));                                            \
+        return node ? &node->entry : NULL;                                                                   \
+    }                                                                                                        \
+                                                                                                             \
+    /* see map_get_batch */                                                                                  \
+    static inline size_t name##_get_batch(                                                                   \
+        name##_t *map, const name##_key_t *keys, size_t n, name##_entry_t **out_entries                      \
+    ) {                                                                                                      \
+        uint64_t hashes[TYPEDMAP_BATCH_GROUP_SIZE];                                                          \
+        name##_node_t *heads[TYPEDMAP_BATCH_GROUP_SIZE];                                                     \
+        size_t n_found = 0;                                                                                  \
+                                                                                                             \
+        for (size_t base = 0; base < n; base += TYPEDMAP_BATCH_GROUP_SIZE) {                                 \
+            size_t group_n = (n - base < TYPEDMAP_BATCH_GROUP_SIZE) ? n - base : TYPEDMAP_BATCH_GROUP_SIZE;  \
+                                                                                                             \
+            for (size_t i = 0; i < group_n; i++) {                                                           \
+                hashes[i] = hashfn(keys[base + i]);                                                          \
+                TYPEDMAP_PREFETCH(&map->buckets[hashes[i] & (map->capacity - 1)]);                           \
+            }                                                                                                \
+            for (size_t i = 0; i < group_n; i++) {                                                           \
+                heads[i] = map->buckets[hashes[i] & (map->capacity - 1)];                                    \
+                if (heads[i]) {                                                                              \
+                    TYPEDMAP_PREFETCH(heads[i]);                                                             \
+                }                                                                                            \
+            }                                                                                                \
+            for (size_t i = 0; i < group_n; i++) {                                                           \
+                name##_node_t *node = heads[i];                                                              \
+                out_entries[base + i] = NULL;                                                                \
+                                                                                                             \
+                while (node) {                                                                               \
+                    if (node->hash == hashes[i] && cmpfn(node->entry.key, keys[base + i]) == 0) {            \
+                        out_entries[base + i] = &node->entry;                                                \
+                        n_found++;                                                                           \
+                        break;                                                                               \
+                    }                                                                                        \
+                    node = node->overflow;                                                                   \
+                }                                                                                            \
+            }                                                                                                \
+        }                                                                                                    \
+                                                                                                             \
+        return n_found;                                                                                      \
+    }                                                                                                        \
+                                                                                                             \
+    /* remove the entry for `key`. Returns 1 and copies it to `removed` (nullable) if found, otherwise 0 */  \
+    static inline int name##_remove(name##_t *map, name##_key_t key, name##_entry_t *removed) {              \
+        uint64_t hash = hashfn(key);                                                                         \
+        size_t bucket_i = hash & (map->capacity - 1);                                                        \
+        name##_node_t *node = map->buckets[bucket_i];                                                        \
+        name##_node_t *prev = NULL;                                                                          \
+                                                                                                             \
+        while (node && !(node->hash == hash && cmpfn(node->entry.key, key) == 0)) {                          \
+            prev = node;                                                                                     \
+            node = node->overflow;                                                                           \
+        }                                                                                                    \
+        if (!node) {                                                                                         \
+            return 0;                                                                                        \
+        }                                                                                                    \
+                                                                                                             \
+        if (!prev) {                                                                                         \
+            map->buckets[bucket_i] = node->overflow;                                                         \
+        } else {                                                                                             \
+            prev->overflow = node->overflow;                                                                 \
+        }                                                                                                    \
+        if (removed) {                                                                                       \
+            *removed = node->entry;                                                                          \
+        }                                                                                                    \
+                                                                                                             \
+        free(node);                                                                                          \
+        map->length--;                                                                                       \
+        return 1;                                                                                            \
+    }                                                                                                        \
+                                                                                                             \
+    static inline void name##_stats(name##_t *map, map_stats_t *stats) {                                     \
+        memset(stats, 0, sizeof(map_stats_t));                                                               \
+                                                                                                             \
+        stats->length = map->length;                                                                         \
+        stats->capacity = map->capacity;                                                                     \
+        stats->load_factor = (double) map->length / (double) map->capacity;                                  \
+        stats->n_resizes = map->n_resizes;                                                                   \
+        stats->resize_secs = map->resize_secs;                                                               \
+        stats->bytes = sizeof(name##_t) + map->capacity * sizeof(name##_node_t *);                           \
+        stats->bytes += map->length * sizeof(name##_node_t);                                                 \
+                                                                                                             \
+        for (size_t i = 0; i < map->capacity; i++) {                                                         \
+            size_t chain_len = 0;                                                                            \
+                                                                                                             \
+            for (name##_node_t *node = map->buckets[i]; node; node = node->overflow) {                       \
+                chain_len++;                                                                                 \
+            }                                                                                                \
+            if (chain_len > stats->max_chain) {                                                              \
+                stats->max_chain = chain_len;                                                                \
+            }                                                                                                \
+            if (chain_len >= MAP_STATS_HIST_LEN) {                                                           \
+                chain_len = MAP_STATS_HIST_LEN - 1;                                                          \
+            }                                                                                                \
+            stats->chain_hist[chain_len] += 1;                                                               \
+        }                                                                                                    \
+    }                                                                                                        \
+                                                                                                             \
+    /* inserting or removing entries during iteration is undefined behavior */                               \
+    static inline void name##_iter_init(name##_t *map, name##_iter_t *iter) {                                \
+        iter->buckets = map->buckets;                                                                        \
+        iter->next = map->buckets[0];                                                                        \
+        iter->i_curr_bucket = 0;                                                                             \
+        iter->n_remaining = map->length;                                                                     \
+    }                                                                                                        \
+                                                                                                             \
+    static inline int name##_hasnext(name##_iter_t *iter) {                                                  \
+        return iter->n_remaining != 0;                                                                       \
+    }                                                                                                        \
+                                                                                                             \
+    static inline name##_entry_t *name##_next(name##_iter_t *iter) {                                         \
+        if (iter->n_remaining == 0) {                                                                        \
+            return NULL;                                                                                     \
+        }                                                                                                    \
+                                                                                                             \
+        name##_node_t *curr = iter->next;                                                                    \
+        while (curr == NULL) {                                                                               \
+            iter->i_curr_bucket += 1;                                                                        \
+            curr = iter->buckets[iter->i_curr_bucket];                                                       \
+        }                                                                                                    \
+                                                                                                             \
+        iter->next = curr->overflow;                                                                         \
+        iter->n_remaining -= 1;                                                                              \
+        return &curr->entry;                                                                                 \
+    }
+
+#endif /* TYPEDMAP_H */
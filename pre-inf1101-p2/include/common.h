@@ -40,6 +40,31 @@ int compare_pointers(const void *a, const void *b);
  */
 uint64_t hash_string_fnv1a64(const void *str);
 
+/**
+ * @brief Inline variant of `hash_string_fnv1a64`, for type-specialised containers (see `typedmap.h`) where the
+ * hash function can be inlined rather than called through a `hash64_fn` pointer.
+ * @param str: null-terminated string
+ * @returns The 64 bit hash of `str`
+ */
+static inline uint64_t fnv1a64_str(const char *str) {
+    /* note that these values are NOT chosen randomly. Modifying them will break the function. */
+    const uint64_t FNV_offset_basis = 0xcbf29ce484222325;
+    const uint64_t FNV_prime = 0x100000001b3;
+
+    uint64_t hash = FNV_offset_basis;
+    const uint8_t *p = (const uint8_t *) str;
+
+    while (*p) {
+        /* FNV-1a hash differs from the FNV-1 hash only by the
+         * order in which the multiply and XOR is performed */
+        hash ^= (uint64_t) *p;
+        hash *= FNV_prime;
+        p++;
+    }
+
+    return hash;
+}
+
 /**
  * @param c: character-type integer
  * @returns a positive integer if character is a newline, otherwise 0
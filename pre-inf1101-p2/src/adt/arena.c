@@ -0,0 +1,136 @@
+/**
+ * @implements arena.h
+ */
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+/* every allocation is aligned to this */
+#define ARENA_ALIGN alignof(max_align_t)
+
+/* a chunk of memory to allocate from, followed by its `size` bytes */
+typedef struct chunk {
+    struct chunk *next; // the chunk allocated before this one
+    size_t size;
+    size_t used;
+    alignas(ARENA_ALIGN) unsigned char data[];
+} chunk_t;
+
+struct arena {
+    chunk_t *chunks; // the chunk being allocated from, followed by the full ones
+    size_t n_chunks;
+    size_t bytes;
+};
+
+
+/* allocate a chunk of at least `size` bytes, in front of the others. returns 0 on success */
+static int add_chunk(arena_t *arena, size_t size) {
+    chunk_t *chunk = malloc(sizeof(chunk_t) + size);
+    if (chunk == NULL) {
+        return -1;
+    }
+
+    chunk->next = arena->chunks;
+    chunk->size = size;
+    chunk->used = 0;
+    arena->chunks = chunk;
+    arena->n_chunks += 1;
+    arena->bytes += size;
+    return 0;
+}
+
+/* free every chunk */
+static void free_chunks(arena_t *arena) {
+    while (arena->chunks) {
+        chunk_t *next = arena->chunks->next;
+        free(arena->chunks);
+        arena->chunks = next;
+    }
+
+    arena->n_chunks = 0;
+    arena->bytes = 0;
+}
+
+arena_t *arena_create(void) {
+    return calloc(1, sizeof(arena_t));
+}
+
+void arena_destroy(arena_t *arena) {
+    if (arena == NULL) {
+        return;
+    }
+
+    free_chunks(arena);
+    free(arena);
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+    chunk_t *chunk = arena->chunks;
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        /* the next chunk is twice the size of the last, and fits the allocation regardless */
+        size_t chunk_size = chunk ? 2 * chunk->size : ARENA_INITIAL_CHUNK;
+        while (chunk_size < size) {
+            chunk_size *= 2;
+        }
+
+        if (add_chunk(arena, chunk_size) != 0) {
+            return NULL;
+        }
+        chunk = arena->chunks;
+    }
+
+    void *ptr = &chunk->data[chunk->used];
+    chunk->used += size;
+    return ptr;
+}
+
+void *arena_calloc(arena_t *arena, size_t n, size_t size) {
+    if (size && n > SIZE_MAX / size) {
+        return NULL;
+    }
+
+    void *ptr = arena_alloc(arena, n * size);
+    if (ptr) {
+        memset(ptr, 0, n * size);
+    }
+    return ptr;
+}
+
+char *arena_strdup(arena_t *arena, const char *str) {
+    return arena_strndup(arena, str, strlen(str));
+}
+
+char *arena_strndup(arena_t *arena, const char *str, size_t n) {
+    size_t len = strnlen(str, n);
+    char *copy = arena_alloc(arena, len + 1);
+    if (copy) {
+        memcpy(copy, str, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+void arena_reset(arena_t *arena) {
+    if (arena->n_chunks <= 1) {
+        if (arena->chunks) {
+            arena->chunks->used = 0;
+        }
+        return;
+    }
+
+    /* replace the chunks by one that fits them all. If that fails, the next allocation starts over */
+    size_t bytes = arena->bytes;
+    free_chunks(arena);
+    add_chunk(arena, bytes);
+}
+
+size_t arena_bytes(const arena_t *arena) {
+    return arena->bytes;
+}
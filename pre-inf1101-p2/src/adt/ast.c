@@ -12,24 +12,26 @@
 #include "set.h"
 #include "printing.h"
 #include "common.h"
+#include "levenshtein.h"
 #include "index.h"
 #include "ast.h"
 
 
 /* forward declaration */
-static AST *parse_recursive_expression(list_iter_t *token_iter, char *errmsg);
-static AST *parse_andnot(list_iter_t *tokens, char *errmsg);
-static AST *parse_or(list_iter_t *tokens, char *errmsg);
-static AST *parse_and(list_iter_t *tokens, char *errmsg);
-static AST *parse_term(list_iter_t *tokens, char *errmsg);
+static AST *parse_recursive_expression(list_iter_t *token_iter, arena_t *arena, char *errmsg);
+static AST *parse_andnot(list_iter_t *tokens, arena_t *arena, char *errmsg);
+static AST *parse_or(list_iter_t *tokens, arena_t *arena, char *errmsg);
+static AST *parse_and(list_iter_t *tokens, arena_t *arena, char *errmsg);
+static AST *parse_term(list_iter_t *tokens, arena_t *arena, char *errmsg);
+static AST *parse_phrase(list_iter_t *tokens, arena_t *arena, char *errmsg);
 
 
 
-/* Creation and Deletion */
+/* Creation */
 
 /* Create a new ast for a term */
-AST *ast_create_term(char *term) {
-    AST *ast_node = malloc(sizeof(AST));
+AST *ast_create_term(arena_t *arena, char *term) {
+    AST *ast_node = arena_alloc(arena, sizeof(AST));
     if (ast_node == NULL) {
         pr_error("Failed to allocate memory for AST node\n");
         return NULL;
@@ -37,51 +39,97 @@ AST *ast_create_term(char *term) {
 
     /* initialize the type, and dup the term to the term field in data*/
     ast_node->type = AST_TERM;
-    ast_node->data.term = strdup(term);
+    ast_node->data.term = arena_strdup(arena, term);
     if (ast_node->data.term == NULL) {
         pr_error("Failed to duplicate term string\n");
-        free(ast_node);
         return NULL;
     }
 
     return ast_node;
 }
 
-/* Create a new ast for an operator */
-AST *ast_create_operator(int type, AST *left, AST *right) {
-    AST *ast_node = malloc(sizeof(AST));
+/* Create a new ast for a prefix, fuzzy or substring node matching `str`. The terms are filled in by the index */
+static AST *create_expansion(arena_t *arena, int type, const char *str, size_t len, unsigned max_edits) {
+    AST *ast_node = arena_alloc(arena, sizeof(AST));
     if (ast_node == NULL) {
         pr_error("Failed to allocate memory for AST node\n");
         return NULL;
     }
 
-    /* initialize the node to its respective field in the struct */
     ast_node->type = type;
-    ast_node->data.children.left = left;
-    ast_node->data.children.right = right;
+    ast_node->data.expansion.str = arena_strndup(arena, str, len);
+    ast_node->data.expansion.max_edits = max_edits;
+    ast_node->data.expansion.terms = NULL;
+    ast_node->data.expansion.n_terms = 0;
+    if (ast_node->data.expansion.str == NULL) {
+        pr_error("Failed to duplicate term string\n");
+        return NULL;
+    }
 
     return ast_node;
 }
 
-/* Frees the memory of the ast nodes and it children */
-void ast_destroy(AST *node) {
-    if (node == NULL) {
-        pr_error("AST node is NULL\n");
-        return;
+/* Create a new ast for a prefix token (`prefix*`, including the '*') */
+AST *ast_create_prefix(arena_t *arena, char *token) {
+    /* the prefix is the token without its '*' */
+    return create_expansion(arena, AST_PREFIX, token, strlen(token) - 1, 0);
+}
+
+/* Create a new ast for a fuzzy term (`term~k`) */
+AST *ast_create_fuzzy(arena_t *arena, char *term, unsigned max_edits) {
+    return create_expansion(arena, AST_FUZZY, term, strlen(term), max_edits);
+}
+
+/* Create a new ast for a substring token (`*substring*`, including the '*'s) */
+AST *ast_create_substring(arena_t *arena, char *token) {
+    /* the substring is the token without its '*'s */
+    return create_expansion(arena, AST_SUBSTRING, token + 1, strlen(token) - 2, 0);
+}
+
+/* Create a new ast for a phrase. Every word becomes a term, stop words too: they only match within phrases */
+AST *ast_create_phrase(arena_t *arena, char **words, size_t n_words) {
+    AST *ast_node = arena_alloc(arena, sizeof(AST));
+    if (ast_node == NULL) {
+        pr_error("Failed to allocate memory for AST node\n");
+        return NULL;
     }
 
-    /* recurcively destroy the ast 
-        check the type of node to be freed */
-    if (node->type == AST_AND || node->type == AST_OR || node->type == AST_ANDNOT) {
-        ast_destroy(node->data.children.left);
-        ast_destroy(node->data.children.right);
+    ast_node->type = AST_PHRASE;
+    ast_node->data.phrase.terms = arena_alloc(arena, (n_words + 1) * sizeof(char *));
+    ast_node->data.phrase.offsets = arena_alloc(arena, (n_words + 1) * sizeof(uint32_t));
+    ast_node->data.phrase.n_terms = 0;
+    if (ast_node->data.phrase.terms == NULL || ast_node->data.phrase.offsets == NULL) {
+        pr_error("Failed to allocate memory for phrase\n");
+        return NULL;
+    }
+
+    for (size_t i = 0; i < n_words; i++) {
+        ast_node->data.phrase.terms[i] = arena_strdup(arena, words[i]);
+        if (ast_node->data.phrase.terms[i] == NULL) {
+            pr_error("Failed to duplicate term string\n");
+            return NULL;
+        }
+        ast_node->data.phrase.offsets[i] = (uint32_t) i;
     }
-    else if (node->type == AST_TERM) {
-        free(node->data.term);
+    ast_node->data.phrase.n_terms = n_words;
+
+    return ast_node;
+}
+
+/* Create a new ast for an operator */
+AST *ast_create_operator(arena_t *arena, int type, AST *left, AST *right) {
+    AST *ast_node = arena_alloc(arena, sizeof(AST));
+    if (ast_node == NULL) {
+        pr_error("Failed to allocate memory for AST node\n");
+        return NULL;
     }
 
-    free(node);
+    /* initialize the node to its respective field in the struct */
+    ast_node->type = type;
+    ast_node->data.children.left = left;
+    ast_node->data.children.right = right;
 
+    return ast_node;
 }
 
 
@@ -91,9 +139,9 @@ void ast_destroy(AST *node) {
 /* Parse a list of tokens to the ast
     this is the top level function that calls the recursive part
     helping hand from ai - see chatlog_1 */
-AST *parse_expression(list_iter_t *token_iter, char *errmsg) {
+AST *parse_expression(list_iter_t *token_iter, arena_t *arena, char *errmsg) {
     /* calls the recursive part */
-    AST *ast = parse_recursive_expression(token_iter, errmsg);
+    AST *ast = parse_recursive_expression(token_iter, arena, errmsg);
 
     /* check for failiure */
     if (ast == NULL) {
@@ -108,7 +156,6 @@ AST *parse_expression(list_iter_t *token_iter, char *errmsg) {
             snprintf(errmsg, LINE_MAX, "Unexpected token '%s' after expression", next_token);
         }
 
-        ast_destroy(ast);
         return NULL;
 
     }
@@ -119,9 +166,9 @@ AST *parse_expression(list_iter_t *token_iter, char *errmsg) {
 /* Parses the expression using the ANDNOT operator
     this is the recursive part of the parser - helping hand from ai
     - see chatlog_1 */
-static AST *parse_recursive_expression(list_iter_t *token_iter, char *errmsg) {
+static AST *parse_recursive_expression(list_iter_t *token_iter, arena_t *arena, char *errmsg) {
     /* parse the expression using the ANDNOT operator */
-    AST *ast = parse_andnot(token_iter, errmsg);
+    AST *ast = parse_andnot(token_iter, arena, errmsg);
     if (ast == NULL) {
         if (errmsg[0] == '\0') {
             snprintf(errmsg, LINE_MAX, "Failed to parse expression");
@@ -133,9 +180,9 @@ static AST *parse_recursive_expression(list_iter_t *token_iter, char *errmsg) {
 }
 
 /* Parses the && term, building the ast */
-static AST *parse_and(list_iter_t *tokens, char *errmsg) {
+static AST *parse_and(list_iter_t *tokens, arena_t *arena, char *errmsg) {
     /* parse the initial term for the left node */
-    AST *left = parse_term(tokens, errmsg);
+    AST *left = parse_term(tokens, arena, errmsg);
     if (left == NULL) {
         if (errmsg[0] == '\0') {
             snprintf(errmsg, LINE_MAX, "Failed to parse left term");
@@ -148,23 +195,20 @@ static AST *parse_and(list_iter_t *tokens, char *errmsg) {
     while (peeking_token != NULL && strcmp(peeking_token, "&&") == 0) {
     list_next(tokens); /* consume the "&&" token
         parse the next term for the right node */
-    AST *right = parse_term(tokens, errmsg);
+    AST *right = parse_term(tokens, arena, errmsg);
     if (right == NULL) {
         if (errmsg[0] == '\0') {
             snprintf(errmsg, LINE_MAX, "Failed to parse right term");
         }
-        ast_destroy(left);
         return NULL;
     }
 
     /* create the AST node for the AND operator */
-        AST *ast_and_node = ast_create_operator(AST_AND, left, right);
+        AST *ast_and_node = ast_create_operator(arena, AST_AND, left, right);
         if (ast_and_node == NULL) {
         if (errmsg[0] == '\0') {
             snprintf(errmsg, LINE_MAX, "Failed to create AST for AND operator");
         }
-        ast_destroy(left);
-        ast_destroy(right);
         return NULL;
     }
 
@@ -178,10 +222,10 @@ static AST *parse_and(list_iter_t *tokens, char *errmsg) {
 }
 
 /* Parses the || term, building the ast */
-static AST *parse_or(list_iter_t *tokens, char *errmsg) {
+static AST *parse_or(list_iter_t *tokens, arena_t *arena, char *errmsg) {
 
     /* parse the AND term */
-    AST *left = parse_and(tokens, errmsg);
+    AST *left = parse_and(tokens, arena, errmsg);
     if (left == NULL) {
         if (errmsg[0] == '\0') {
             snprintf(errmsg, LINE_MAX, "Failed to parse left term");
@@ -193,23 +237,20 @@ static AST *parse_or(list_iter_t *tokens, char *errmsg) {
     while (peeking_token != NULL && strcmp(peeking_token, "||") == 0) {
     list_next(tokens); /* consume the "||" token
         parse the next term for the right node */
-    AST *right = parse_and(tokens, errmsg);
+    AST *right = parse_and(tokens, arena, errmsg);
     if (right == NULL) {
         if (errmsg[0] == '\0') {
             snprintf(errmsg, LINE_MAX, "Failed to parse right term");
         }
-        ast_destroy(left);
         return NULL;
     }
 
     /* create the AST node for the OR operator */
-        AST *ast_or_node = ast_create_operator(AST_OR, left, right);
+        AST *ast_or_node = ast_create_operator(arena, AST_OR, left, right);
         if (ast_or_node == NULL) {
         if (errmsg[0] == '\0') {
             snprintf(errmsg, LINE_MAX, "Failed to create AST for OR operator");
         }
-        ast_destroy(left);
-        ast_destroy(right);
         return NULL;
     }
 
@@ -223,9 +264,9 @@ static AST *parse_or(list_iter_t *tokens, char *errmsg) {
 }
 
 /* Parses the &! term, building the ast */
-static AST *parse_andnot(list_iter_t *tokens, char *errmsg) {
+static AST *parse_andnot(list_iter_t *tokens, arena_t *arena, char *errmsg) {
     /* parse the AND term */
-    AST *left = parse_or(tokens, errmsg);
+    AST *left = parse_or(tokens, arena, errmsg);
     if (left == NULL) {
         if (errmsg[0] == '\0') {
             snprintf(errmsg, LINE_MAX, "Failed to parse left term");
@@ -242,31 +283,124 @@ static AST *parse_andnot(list_iter_t *tokens, char *errmsg) {
 
     list_next(tokens); /* consume the "&!" token
         parse the next term for the right node */
-    AST *right = parse_andnot(tokens, errmsg);
+    AST *right = parse_andnot(tokens, arena, errmsg);
     if (right == NULL) {
         if (errmsg[0] == '\0') {
             snprintf(errmsg, LINE_MAX, "Failed to parse right term");
         }
-        ast_destroy(left);
         return NULL;
     }
 
     /* create the AST node for the ANDNOT operator */
-    AST *ast = ast_create_operator(AST_ANDNOT, left, right);
+    AST *ast = ast_create_operator(arena, AST_ANDNOT, left, right);
     if (ast == NULL) {
         if (errmsg[0] == '\0') {
             snprintf(errmsg, LINE_MAX, "Failed to create AST for ANDNOT operator");
         }
-        ast_destroy(left);
-        ast_destroy(right);
         return NULL;
     }
 
     return ast;
 }
 
+/* Parses a fuzzy term token, `term~k`, where `tilde` points to the '~' */
+static AST *parse_fuzzy(char *token, char *tilde, arena_t *arena, char *errmsg) {
+    const char *edits = tilde + 1;
+
+    if (tilde == token || strchr(token, '*') != NULL || edits[0] < '0' || edits[0] > '0' + LEVENSHTEIN_MAX_EDITS
+        || edits[1] != '\0') {
+        if (errmsg[0] == '\0') {
+            snprintf(
+                errmsg, LINE_MAX, "Invalid fuzzy term '%s', expected 'term~k' with k at most %d", token,
+                LEVENSHTEIN_MAX_EDITS
+            );
+        }
+        return NULL;
+    }
+
+    /* the term is the token up to the '~' */
+    char *term = arena_strndup(arena, token, (size_t) (tilde - token));
+    if (term == NULL) {
+        pr_error("Failed to duplicate term string\n");
+        return NULL;
+    }
+
+    return ast_create_fuzzy(arena, term, (unsigned) (edits[0] - '0'));
+}
+
+/* Parses a quoted phrase, `"term term ..."`. The quotes are part of the first and last token of it */
+static AST *parse_phrase(list_iter_t *tokens, arena_t *arena, char *errmsg) {
+    size_t n_words = 0;
+    size_t capacity = 8;
+    char **words = arena_alloc(arena, capacity * sizeof(char *));
+    if (words == NULL) {
+        pr_error("Failed to allocate memory for phrase\n");
+        return NULL;
+    }
+
+    /* skip the opening quote, then collect words until one ends with the closing quote */
+    char *token = list_next(tokens);
+    char *word = token + 1;
+    while (1) {
+        size_t len = strlen(word);
+        bool closing = len > 0 && word[len - 1] == '"';
+        len -= closing;
+
+        for (size_t i = 0; i < len; i++) {
+            if (!is_ascii_alnum(word[i])) {
+                if (errmsg[0] == '\0') {
+                    snprintf(errmsg, LINE_MAX, "Invalid word '%s' in phrase, expected only terms", token);
+                }
+                return NULL;
+            }
+        }
+
+        if (len > 0) {
+            /* the arena cannot grow an allocation, so a full array is copied to one twice the size */
+            if (n_words == capacity) {
+                char **new_words = arena_alloc(arena, 2 * capacity * sizeof(char *));
+                if (new_words == NULL) {
+                    pr_error("Failed to allocate memory for phrase\n");
+                    return NULL;
+                }
+                memcpy(new_words, words, n_words * sizeof(char *));
+                words = new_words;
+                capacity *= 2;
+            }
+            words[n_words] = arena_strndup(arena, word, len);
+            if (words[n_words] == NULL) {
+                pr_error("Failed to duplicate term string\n");
+                return NULL;
+            }
+            n_words += 1;
+        }
+
+        if (closing) {
+            break;
+        }
+
+        token = list_next(tokens);
+        if (token == NULL) {
+            if (errmsg[0] == '\0') {
+                snprintf(errmsg, LINE_MAX, "Expected '\"' to end the phrase");
+            }
+            return NULL;
+        }
+        word = token;
+    }
+
+    if (n_words == 0) {
+        if (errmsg[0] == '\0') {
+            snprintf(errmsg, LINE_MAX, "Empty phrase");
+        }
+        return NULL;
+    }
+
+    return ast_create_phrase(arena, words, n_words);
+}
+
 /* Parses a single term or a subquery, handles parentheses with grouping - help from ai */
-static AST *parse_term(list_iter_t *tokens, char *errmsg) {
+static AST *parse_term(list_iter_t *tokens, arena_t *arena, char *errmsg) {
     char *token = list_peek(tokens);
 
     if (token == NULL) {
@@ -278,7 +412,7 @@ static AST *parse_term(list_iter_t *tokens, char *errmsg) {
     if (strcmp(token, "(") == 0) {
         list_next(tokens);
         /* recursively parse the subquery */
-        AST *subquery = parse_recursive_expression(tokens, errmsg);
+        AST *subquery = parse_recursive_expression(tokens, arena, errmsg);
         if (subquery == NULL) {
             if (errmsg[0] == '\0') {
                 snprintf(errmsg, LINE_MAX, "Failed to parse subquery: %s", token);
@@ -292,12 +426,13 @@ static AST *parse_term(list_iter_t *tokens, char *errmsg) {
             if (errmsg[0] == '\0') {
                 snprintf(errmsg, LINE_MAX, "Expected ')' but found '%s'", token);
             }
-            ast_destroy(subquery);
             return NULL;
         }
 
         list_next(tokens);
         return subquery;
+    } else if (token[0] == '"') {
+        return parse_phrase(tokens, arena, errmsg);
     } else { /* note: this holdes to much power and is causing problems with a select few inputs
                 at the time of writing this I dont have the time to fix this */
         /* check if the token is valid */
@@ -309,228 +444,82 @@ static AST *parse_term(list_iter_t *tokens, char *errmsg) {
             return NULL;
         }
 
-        return ast_create_term(token);
-    }
-}
-
-
-
-/* Utility and Debugging */
-
-/* Traverses and evaluates the ast returning the result as a set of documents
-Inspiration from https://www.reddit.com/r/C_Programming/comments/lzq2t2/how_to_make_an_ast_in_c/
-got a lot of help debugging from ai and it ended up fixing and making most of this function
-in the AST_TERM case
-see chatlog_1 */
-set_t *ast_result(AST *node, index_t *index, char *errmsg) {
-    if (node == NULL) {
-        snprintf(errmsg, LINE_MAX, "AST node is NULL");
-        return NULL;
-    }
-
-
-    /* we check the type of node to be handled */
-    switch (node->type) {
-        case AST_TERM: {
-            /* handles term node */
-            if (node->data.term == NULL) {
-                snprintf(errmsg, LINE_MAX, "Term is NULL");
-                return NULL;
-            }
-
-            /* get the terms map */
-            map_t *terms_map = index_get_terms_map(index);
-            if (terms_map == NULL) {
-                snprintf(errmsg, LINE_MAX, "Index terms map is NULL");
-                set_t *empty_set = set_create((cmp_fn) strcmp);
-                if (empty_set == NULL) {
-                    snprintf(errmsg, LINE_MAX, "Failed to create empty set");
-                }
-                return empty_set;
-            }
-
-            /* check if it exists */
-            entry_t *term_entry = map_get(terms_map, node->data.term);
-            if (term_entry == NULL) {
-                /* if the term is not found create a new set */
-                set_t *empty_set = set_create((cmp_fn) strcmp);
-                if (empty_set == NULL) {
-                    pr_error("Failed to create empty set\n");
-                }
-                return empty_set;
-            } else { /* got this from AI as my implementation did not work
-                    and i couldnt get it to work see chatlog_1 */
-                // Term found. Manually create a shallow copy of the set.
-                set_t *original_set = (set_t *)term_entry->val;
-                if (original_set == NULL) { // Should not happen, but check
-                    snprintf(errmsg, LINE_MAX, "Internal error: Set for term '%s' is NULL", node->data.term);
-                    return NULL; // Or return empty set
-                }
-
-                // Create a new empty set using the original set's comparison function
-                cmp_fn original_cmpfn = set_get_cmpfn(original_set); // <<< Use accessor
-                if (original_cmpfn == NULL) {
-                    // This could happen if original_set was NULL, though checked above.
-                    // Or if set_get_cmpfn fails for some reason.
-                    snprintf(errmsg, LINE_MAX, "Failed to get comparison function for term '%s'", node->data.term);
-                    return NULL;
-                }
-                set_t *result_set = set_create(original_cmpfn); // <<< Pass the retrieved function
-                if (result_set == NULL) {
-                    snprintf(errmsg, LINE_MAX, "Failed to create result set for term '%s'", node->data.term);
-                    return NULL; // Allocation failed
-                }
-
-                // Iterate through the original set and insert items into the new set
-                set_iter_t *iter = set_createiter(original_set);
-                if (iter == NULL) {
-                    snprintf(errmsg, LINE_MAX, "Failed to create iterator for term '%s'", node->data.term);
-                    set_destroy(result_set, NULL); // Clean up the partially created set
-                    return NULL;
-                }
-
-                bool insert_error = false;
-                while (set_hasnext(iter)) {
-                    void *item = set_next(iter);
-                    // Insert the item pointer (shallow copy). set_insert returns NULL on success.
-                    // We need to check the return value in case set_insert fails internally (e.g., malloc)
-                    if (set_insert(result_set, item) != NULL) {
-                         // Check if the element already existed (non-NULL return). This shouldn't happen
-                         // if we're copying into a fresh set, unless set_insert has other failure modes
-                         // or the original set had duplicates (which it shouldn't).
-                         // Let's assume non-NULL means error for simplicity here, though the set interface
-                         // documentation says non-NULL means "already existed". If it can fail malloc,
-                         // it should ideally return a specific error or use PANIC.
-                         // For now, treat any non-NULL return as an issue during copy.
-                            snprintf(errmsg, LINE_MAX, "Failed to insert item into result set copy for term '%s'", node->data.term);
-                            insert_error = true;
-                         break; // Stop copying on error
-                    }
-                }
-                set_destroyiter(iter); // Clean up the iterator
-
-                if (insert_error) {
-                    set_destroy(result_set, NULL); // Clean up the failed copy
-                    return NULL; // Return NULL on copy failure
-                }
-
-                return result_set; // Return the newly created shallow copy
+        if (strchr(token, '"') != NULL) {
+            if (errmsg[0] == '\0') {
+                snprintf(errmsg, LINE_MAX, "Unexpected '\"' in '%s', phrases must be quoted as a whole", token);
             }
-
+            return NULL;
         }
 
-        /* some changes were made to all the cases with help from AI */
-        case AST_AND: {
-            /* handles the AND operator */
-            if (node->data.children.left == NULL || node->data.children.right == NULL) {
-                snprintf(errmsg, LINE_MAX, "Left or right child is NULL");
-                return NULL;
-            }
-
-            /* recursively get the result of the left and right children */
-            set_t *left_result = ast_result(node->data.children.left, index, errmsg);
-            if (left_result == NULL) {
-                snprintf(errmsg, LINE_MAX, "Failed to get left result");
-                return NULL;
-            }
-
-            set_t *right_result = ast_result(node->data.children.right, index, errmsg);
-            if (right_result == NULL) {
-                snprintf(errmsg, LINE_MAX, "Failed to get right result");
-                set_destroy(left_result, NULL);
-                return NULL;
-            }
-
-            /* performe a set_intersection on the children */
-            set_t *intersection = set_intersection(left_result, right_result);
-            if (intersection == NULL) {
-                snprintf(errmsg, LINE_MAX, "Intersection failed");
-                set_destroy(left_result, NULL);
-                set_destroy(right_result, NULL);
-                return NULL;
-            }
-
-            set_destroy(left_result, NULL);
-            set_destroy(right_result, NULL);
-            return intersection;
-
+        /* a '~' followed by the maximum number of edits makes the term fuzzy */
+        char *tilde = strchr(token, '~');
+        if (tilde != NULL) {
+            return parse_fuzzy(token, tilde, arena, errmsg);
         }
 
+        /* a '*' at the end makes the term a prefix, and one at both ends a substring */
+        char *wildcard = strchr(token, '*');
+        if (wildcard == NULL) {
+            return ast_create_term(arena, token);
+        }
 
-        case AST_OR: {
-            /* handles the OR operator */
-            if (node->data.children.left == NULL || node->data.children.right == NULL) {
-                snprintf(errmsg, LINE_MAX, "Left or right child is NULL");
-                return NULL;
-            }
-
-            /* recursively get the result of the left and right children */
-            set_t *left_result = ast_result(node->data.children.left, index, errmsg);
-            if (left_result == NULL) {
-                snprintf(errmsg, LINE_MAX, "Failed to get left result");
-                return NULL;
-            }
-
-            set_t *right_result = ast_result(node->data.children.right, index, errmsg);
-            if (right_result == NULL) {
-                snprintf(errmsg, LINE_MAX, "Failed to get right result");
-                set_destroy(left_result, free);
-                return NULL;
-            }
-
-            /* performe a set_union on the children */
-            set_t *union_ = set_union(left_result, right_result);
-            if (union_ == NULL) {
-                snprintf(errmsg, LINE_MAX, "Union failed");
-                set_destroy(left_result, NULL);
-                set_destroy(right_result, NULL);
-                return NULL;
+        size_t len = strlen(token);
+        if (wildcard == token && len > 2 && token[len - 1] == '*' && strchr(token + 1, '*') == &token[len - 1]) {
+            return ast_create_substring(arena, token);
+        }
+        if (wildcard == token || wildcard[1] != '\0') {
+            if (errmsg[0] == '\0') {
+                snprintf(
+                    errmsg,
+                    LINE_MAX,
+                    "Invalid wildcard in '%s', only prefixes ('term*') and substrings ('*term*') are supported",
+                    token
+                );
             }
-
-            set_destroy(left_result, NULL);
-            set_destroy(right_result, NULL);
-            return union_;
+            return NULL;
         }
 
+        return ast_create_prefix(arena, token);
+    }
+}
 
-        case AST_ANDNOT: {
-            /* handles the ANDNOT operator - done by autocomplete */
-            if (node->data.children.left == NULL || node->data.children.right == NULL) {
-                snprintf(errmsg, LINE_MAX, "Left or right child is NULL");
-                return NULL;
-            }
 
-            /* recursively get the result of the left and right children */
-            set_t *left_result = ast_result(node->data.children.left, index, errmsg);
-            if (left_result == NULL) {
-                snprintf(errmsg, LINE_MAX, "Failed to get left result");
-                return NULL;
-            }
 
-            set_t *right_result = ast_result(node->data.children.right, index, errmsg);
-            if (right_result == NULL) {
-                snprintf(errmsg, LINE_MAX, "Failed to get right result");
-                set_destroy(left_result, NULL);
-                return NULL;
-            }
+/* Utility and Debugging */
 
-            /* performe a set_difference on the children */
-            set_t *difference = set_difference(left_result, right_result);
-            if (difference == NULL) {
-                snprintf(errmsg, LINE_MAX, "Difference failed");
-                set_destroy(left_result, NULL);
-                set_destroy(right_result, NULL);
-                return NULL;
-            }
+size_t ast_count_terms(AST *node) {
+    if (node == NULL) {
+        return 0;
+    }
+    if (node->type == AST_TERM) {
+        return 1;
+    }
+    if (node->type == AST_PREFIX || node->type == AST_FUZZY || node->type == AST_SUBSTRING) {
+        return node->data.expansion.n_terms;
+    }
+    if (node->type == AST_PHRASE) {
+        return node->data.phrase.n_terms;
+    }
+    return ast_count_terms(node->data.children.left) + ast_count_terms(node->data.children.right);
+}
 
-            set_destroy(left_result, NULL);
-            set_destroy(right_result, NULL);
-            return difference;
-        }
-        
-        default:
-            snprintf(errmsg, LINE_MAX, "Invalid AST node type");
-            return NULL;
+size_t ast_collect_terms(AST *node, char **terms) {
+    if (node == NULL) {
+        return 0;
     }
-    
-}
\ No newline at end of file
+    if (node->type == AST_TERM) {
+        terms[0] = node->data.term;
+        return 1;
+    }
+    if (node->type == AST_PREFIX || node->type == AST_FUZZY || node->type == AST_SUBSTRING) {
+        memcpy(terms, node->data.expansion.terms, node->data.expansion.n_terms * sizeof(char *));
+        return node->data.expansion.n_terms;
+    }
+    if (node->type == AST_PHRASE) {
+        memcpy(terms, node->data.phrase.terms, node->data.phrase.n_terms * sizeof(char *));
+        return node->data.phrase.n_terms;
+    }
+
+    size_t n_left = ast_collect_terms(node->data.children.left, terms);
+    return n_left + ast_collect_terms(node->data.children.right, &terms[n_left]);
+}
@@ -0,0 +1,300 @@
+/**
+ * @implements completions.h
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "completions.h"
+#include "printing.h"
+
+/* a term of a top-k list */
+typedef struct top_entry {
+    uint32_t weight;
+    uint32_t pos;
+} top_entry_t;
+
+/* a trie node that is still being built: the terms from `lo` on that share their first `depth` characters */
+typedef struct build_node {
+    size_t depth;
+    size_t lo;
+    top_entry_t top[COMPLETIONS_K];
+    size_t n_top;
+} build_node_t;
+
+/* slot of the table of cached nodes. A node is identified by its range of terms, `hi` is 0 in empty slots */
+typedef struct node_slot {
+    uint32_t lo;
+    uint32_t hi;
+    uint32_t node;
+} node_slot_t;
+
+struct completions {
+    uint32_t *weights; // weight of every term, by position
+    size_t n_terms;
+    uint32_t *tops;    // `COMPLETIONS_K` positions per cached node
+    uint32_t *ranges;  // lo and hi of every cached node, used to build the table
+    size_t n_nodes;
+    size_t nodes_capacity;
+    node_slot_t *slots;
+    size_t n_slots;
+};
+
+
+/* true if `a` comes before `b` in a top-k list */
+static inline bool heavier(top_entry_t a, top_entry_t b) {
+    return a.weight > b.weight || (a.weight == b.weight && a.pos < b.pos);
+}
+
+/* merge the top-k list `src` into `dst`, keeping the `COMPLETIONS_K` heaviest terms */
+static void merge_top(top_entry_t *dst, size_t *n_dst, const top_entry_t *src, size_t n_src) {
+    top_entry_t merged[COMPLETIONS_K];
+    size_t i = 0, j = 0, n = 0;
+
+    while (n < COMPLETIONS_K && (i < *n_dst || j < n_src)) {
+        if (j == n_src || (i < *n_dst && heavier(dst[i], src[j]))) {
+            merged[n++] = dst[i++];
+        } else {
+            merged[n++] = src[j++];
+        }
+    }
+
+    memcpy(dst, merged, n * sizeof(top_entry_t));
+    *n_dst = n;
+}
+
+static inline size_t node_slot(uint32_t lo, uint32_t hi, size_t n_slots) {
+    uint64_t key = ((uint64_t) lo << 32) | hi;
+    return (size_t) ((key * 0x9E3779B97F4A7C15ULL) >> 32) & (n_slots - 1);
+}
+
+/* cache the top-k list of the node [lo, hi). returns 0 on success */
+static int add_node(completions_t *completions, size_t lo, size_t hi, const top_entry_t *top) {
+    if (completions->n_nodes == completions->nodes_capacity) {
+        size_t new_capacity = completions->nodes_capacity ? completions->nodes_capacity * 2 : 64;
+        uint32_t *new_tops = realloc(completions->tops, new_capacity * COMPLETIONS_K * sizeof(uint32_t));
+        if (new_tops == NULL) {
+            return -1;
+        }
+        completions->tops = new_tops;
+
+        uint32_t *new_ranges = realloc(completions->ranges, new_capacity * 2 * sizeof(uint32_t));
+        if (new_ranges == NULL) {
+            return -1;
+        }
+        completions->ranges = new_ranges;
+        completions->nodes_capacity = new_capacity;
+    }
+
+    uint32_t *dst = &completions->tops[completions->n_nodes * COMPLETIONS_K];
+    for (size_t i = 0; i < COMPLETIONS_K; i++) {
+        dst[i] = top[i].pos;
+    }
+    completions->ranges[2 * completions->n_nodes] = (uint32_t) lo;
+    completions->ranges[2 * completions->n_nodes + 1] = (uint32_t) hi;
+    completions->n_nodes += 1;
+    return 0;
+}
+
+/* build the table of cached nodes from their ranges. returns 0 on success */
+static int build_table(completions_t *completions) {
+    size_t n_slots = 16;
+    while (n_slots < 2 * completions->n_nodes) {
+        n_slots *= 2;
+    }
+
+    completions->slots = calloc(n_slots, sizeof(node_slot_t));
+    if (completions->slots == NULL) {
+        return -1;
+    }
+    completions->n_slots = n_slots;
+
+    for (size_t i = 0; i < completions->n_nodes; i++) {
+        uint32_t lo = completions->ranges[2 * i];
+        uint32_t hi = completions->ranges[2 * i + 1];
+        size_t slot = node_slot(lo, hi, n_slots);
+
+        /* the root has the same range as its only child, if every term shares a prefix */
+        while (completions->slots[slot].hi != 0
+               && (completions->slots[slot].lo != lo || completions->slots[slot].hi != hi)) {
+            slot = (slot + 1) & (n_slots - 1);
+        }
+        if (completions->slots[slot].hi == 0) {
+            completions->slots[slot] = (node_slot_t) { lo, hi, (uint32_t) i };
+        }
+    }
+
+    /* the ranges are only needed to build the table */
+    free(completions->ranges);
+    completions->ranges = NULL;
+    return 0;
+}
+
+/**
+ * Walk the trie of the terms bottom up, in a single pass over the terms. The nodes on the path to the current
+ * term are kept on a stack. The length of the prefix a term shares with the next one tells how many of them
+ * end with it: those deeper than that. Each node that ends passes its top-k list on to its parent.
+ */
+static int build_nodes(completions_t *completions, const char **terms) {
+    size_t n = completions->n_terms;
+    size_t stack_capacity = 16;
+    size_t sp = 0;
+    build_node_t *stack = malloc(stack_capacity * sizeof(build_node_t));
+    if (stack == NULL) {
+        return -1;
+    }
+
+    stack[sp++] = (build_node_t) { .depth = 0, .lo = 0, .n_top = 0 };
+
+    for (size_t i = 1; i <= n; i++) {
+        /* the term before this one, to be added to the deepest node it is in */
+        top_entry_t carry[COMPLETIONS_K] = { { completions->weights[i - 1], (uint32_t) (i - 1) } };
+        size_t n_carry = 1;
+        size_t lo = i - 1;
+
+        /* the shared prefix length, or -1 past the last term so that every node ends */
+        long shared = -1;
+        if (i < n) {
+            shared = 0;
+            while (terms[i - 1][shared] != '\0' && terms[i - 1][shared] == terms[i][shared]) {
+                shared++;
+            }
+        }
+
+        while (sp > 0 && shared < (long) stack[sp - 1].depth) {
+            build_node_t *node = &stack[--sp];
+            merge_top(node->top, &node->n_top, carry, n_carry);
+
+            if (i - node->lo > COMPLETIONS_K && add_node(completions, node->lo, i, node->top) != 0) {
+                free(stack);
+                return -1;
+            }
+
+            memcpy(carry, node->top, node->n_top * sizeof(top_entry_t));
+            n_carry = node->n_top;
+            lo = node->lo;
+        }
+        if (sp == 0) {
+            break; // past the last term
+        }
+
+        if (shared > (long) stack[sp - 1].depth) {
+            if (sp == stack_capacity) {
+                build_node_t *new_stack = realloc(stack, 2 * stack_capacity * sizeof(build_node_t));
+                if (new_stack == NULL) {
+                    free(stack);
+                    return -1;
+                }
+                stack = new_stack;
+                stack_capacity *= 2;
+            }
+
+            build_node_t *node = &stack[sp++];
+            node->depth = (size_t) shared;
+            node->lo = lo;
+            memcpy(node->top, carry, n_carry * sizeof(top_entry_t));
+            node->n_top = n_carry;
+        } else {
+            merge_top(stack[sp - 1].top, &stack[sp - 1].n_top, carry, n_carry);
+        }
+    }
+
+    free(stack);
+    return 0;
+}
+
+completions_t *completions_build(const char **terms, const uint32_t *weights, size_t n) {
+    if (n >= UINT32_MAX) {
+        pr_error("Too many terms for completions: %zu\n", n);
+        return NULL;
+    }
+
+    completions_t *completions = calloc(1, sizeof(completions_t));
+    if (completions == NULL) {
+        pr_error("Failed to allocate memory for completions\n");
+        return NULL;
+    }
+
+    completions->n_terms = n;
+    completions->weights = malloc((n + 1) * sizeof(uint32_t));
+    if (completions->weights == NULL) {
+        pr_error("Failed to allocate memory for completions\n");
+        completions_destroy(completions);
+        return NULL;
+    }
+    memcpy(completions->weights, weights, n * sizeof(uint32_t));
+
+    if (build_nodes(completions, terms) != 0 || build_table(completions) != 0) {
+        pr_error("Failed to allocate memory for completions\n");
+        completions_destroy(completions);
+        return NULL;
+    }
+
+    return completions;
+}
+
+void completions_destroy(completions_t *completions) {
+    if (completions == NULL) {
+        return;
+    }
+
+    free(completions->weights);
+    free(completions->tops);
+    free(completions->ranges);
+    free(completions->slots);
+    free(completions);
+}
+
+size_t completions_top(const completions_t *completions, size_t lo, size_t hi, uint32_t *out) {
+    if (hi > completions->n_terms) {
+        hi = completions->n_terms;
+    }
+    if (lo >= hi) {
+        return 0;
+    }
+
+    /* the range of a prefix with more than k terms is a cached node */
+    if (hi - lo > COMPLETIONS_K) {
+        size_t slot = node_slot((uint32_t) lo, (uint32_t) hi, completions->n_slots);
+        while (completions->slots[slot].hi != 0) {
+            if (completions->slots[slot].lo == lo && completions->slots[slot].hi == hi) {
+                memcpy(
+                    out,
+                    &completions->tops[completions->slots[slot].node * COMPLETIONS_K],
+                    COMPLETIONS_K * sizeof(uint32_t)
+                );
+                return COMPLETIONS_K;
+            }
+            slot = (slot + 1) & (completions->n_slots - 1);
+        }
+    }
+
+    /* a small range, or one no prefix maps to. Keep the heaviest terms in order while scanning it */
+    top_entry_t top[COMPLETIONS_K];
+    size_t n_top = 0;
+
+    for (size_t pos = lo; pos < hi; pos++) {
+        top_entry_t entry = { completions->weights[pos], (uint32_t) pos };
+        merge_top(top, &n_top, &entry, 1);
+    }
+
+    for (size_t i = 0; i < n_top; i++) {
+        out[i] = top[i].pos;
+    }
+    return n_top;
+}
+
+uint32_t completions_weight(const completions_t *completions, size_t pos) {
+    return completions->weights[pos];
+}
+
+size_t completions_nodes(const completions_t *completions) {
+    return completions->n_nodes;
+}
+
+size_t completions_bytes(const completions_t *completions) {
+    return sizeof(completions_t) + completions->n_terms * sizeof(uint32_t)
+        + completions->nodes_capacity * COMPLETIONS_K * sizeof(uint32_t)
+        + completions->n_slots * sizeof(node_slot_t);
+}
@@ -0,0 +1,170 @@
+/**
+ * @implements cursor.h
+ */
+
+#include <stddef.h>
+
+#include "cursor.h"
+
+/* the document at the position of a leaf */
+static inline doc_id_t leaf_doc(const cursor_t *c) {
+    return (c->pos < c->len) ? c->docs[c->pos] : CURSOR_END;
+}
+
+static inline doc_id_t min_doc(doc_id_t a, doc_id_t b) {
+    return (a < b) ? a : b;
+}
+
+/* move the operands of an AND forward until they are on the same document */
+static doc_id_t align_and(cursor_t *c) {
+    doc_id_t left = cursor_doc(c->left);
+    doc_id_t right = cursor_doc(c->right);
+
+    while (left != right) {
+        if (left < right) {
+            left = cursor_skip_to(c->left, right);
+        } else {
+            right = cursor_skip_to(c->right, left);
+        }
+    }
+
+    /* both are CURSOR_END once either is */
+    c->doc = left;
+    return c->doc;
+}
+
+/* move the left operand of an ANDNOT forward until the right operand does not have its document */
+static doc_id_t align_andnot(cursor_t *c) {
+    doc_id_t left = cursor_doc(c->left);
+
+    while (left != CURSOR_END && cursor_skip_to(c->right, left) == left) {
+        left = cursor_next(c->left);
+    }
+
+    c->doc = left;
+    return c->doc;
+}
+
+void cursor_init_postings(cursor_t *c, const postings_t *postings) {
+    if (postings == NULL) {
+        cursor_init_docs(c, NULL, 0);
+        return;
+    }
+
+    cursor_init_docs(c, postings_docs(postings), postings->len);
+    c->freqs = postings_freqs(postings);
+}
+
+void cursor_init_docs(cursor_t *c, const doc_id_t *docs, size_t len) {
+    *c = (cursor_t) { .kind = CURSOR_LEAF, .docs = docs, .len = len, .pos = 0 };
+    c->doc = leaf_doc(c);
+}
+
+void cursor_init_and(cursor_t *c, cursor_t *left, cursor_t *right) {
+    *c = (cursor_t) { .kind = CURSOR_AND, .left = left, .right = right };
+    align_and(c);
+}
+
+void cursor_init_or(cursor_t *c, cursor_t *left, cursor_t *right) {
+    *c = (cursor_t) { .kind = CURSOR_OR, .left = left, .right = right };
+    c->doc = min_doc(cursor_doc(left), cursor_doc(right));
+}
+
+void cursor_init_andnot(cursor_t *c, cursor_t *left, cursor_t *right) {
+    *c = (cursor_t) { .kind = CURSOR_ANDNOT, .left = left, .right = right };
+    align_andnot(c);
+}
+
+doc_id_t cursor_next(cursor_t *c) {
+    if (c->doc == CURSOR_END) {
+        return CURSOR_END;
+    }
+
+    switch (c->kind) {
+        case CURSOR_LEAF:
+            c->pos += 1;
+            c->doc = leaf_doc(c);
+            return c->doc;
+
+        case CURSOR_AND:
+            cursor_next(c->left);
+            return align_and(c);
+
+        case CURSOR_OR: {
+            /* every operand on the current document moves past it */
+            doc_id_t left = cursor_doc(c->left);
+            doc_id_t right = cursor_doc(c->right);
+            if (left == c->doc) {
+                left = cursor_next(c->left);
+            }
+            if (right == c->doc) {
+                right = cursor_next(c->right);
+            }
+            c->doc = min_doc(left, right);
+            return c->doc;
+        }
+
+        case CURSOR_ANDNOT:
+            cursor_next(c->left);
+            return align_andnot(c);
+    }
+
+    return CURSOR_END;
+}
+
+doc_id_t cursor_skip_to(cursor_t *c, doc_id_t doc) {
+    if (c->doc >= doc) {
+        return c->doc;
+    }
+
+    switch (c->kind) {
+        case CURSOR_LEAF:
+            c->pos = docs_seek(c->docs, c->len, c->pos, doc);
+            c->doc = leaf_doc(c);
+            return c->doc;
+
+        case CURSOR_AND:
+            cursor_skip_to(c->left, doc);
+            return align_and(c);
+
+        case CURSOR_OR:
+            c->doc = min_doc(cursor_skip_to(c->left, doc), cursor_skip_to(c->right, doc));
+            return c->doc;
+
+        case CURSOR_ANDNOT:
+            cursor_skip_to(c->left, doc);
+            return align_andnot(c);
+    }
+
+    return CURSOR_END;
+}
+
+uint32_t cursor_freq(const cursor_t *c) {
+    if (c->doc == CURSOR_END) {
+        return 0;
+    }
+
+    switch (c->kind) {
+        case CURSOR_LEAF:
+            return c->freqs ? c->freqs[c->pos] : 1;
+
+        case CURSOR_AND:
+            return cursor_freq(c->left) + cursor_freq(c->right);
+
+        case CURSOR_OR: {
+            uint32_t freq = 0;
+            if (cursor_doc(c->left) == c->doc) {
+                freq += cursor_freq(c->left);
+            }
+            if (cursor_doc(c->right) == c->doc) {
+                freq += cursor_freq(c->right);
+            }
+            return freq;
+        }
+
+        case CURSOR_ANDNOT:
+            return cursor_freq(c->left);
+    }
+
+    return 0;
+}
@@ -360,4 +360,14 @@ void *list_peek(list_iter_t *iter) {
     }
 
     return NULL;
-}
\ No newline at end of file
+}
+
+/* copy the items into an array, for callers that cannot allocate an iterator */
+size_t list_toarray(list_t *list, void **out, size_t n) {
+    size_t i = 0;
+    for (lnode_t *node = list->leftmost; node != NULL && i < n; node = node->right) {
+        out[i++] = node->item;
+    }
+
+    return i;
+}
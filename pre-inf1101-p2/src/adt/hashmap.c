@@ -10,6 +10,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "printing.h"
 #include "defs.h"
@@ -29,6 +30,19 @@
  */
 #define LF_GROW 0.75
 
+/**
+ * Number of keys `map_get_batch` resolves per group. All keys of a group are hashed and have their bucket
+ * prefetched before the first chain is walked, so up to this many cache misses are in flight at once.
+ */
+#define BATCH_GROUP_SIZE 16
+
+/* hint that `addr` will be read soon. No-op on compilers without the builtin. */
+#if defined(__GNUC__) || defined(__clang__)
+#  define PREFETCH(addr) __builtin_prefetch((addr), 0, 3)
+#else
+#  define PREFETCH(addr) ((void) (addr))
+#endif
+
 
 
 typedef struct mnode mnode_t;
@@ -44,6 +58,8 @@ struct map {
     size_t capacity;
     size_t length;
     size_t rehash_threshold;
+    size_t n_resizes;
+    double resize_secs;
 };
 
 /**
@@ -89,6 +105,9 @@ static inline mnode_t *map_flatten(map_t *map) {
  * we must rehash for all nodes.
  */
 static inline int map_resize(map_t *map, size_t new_capacity) {
+    struct timespec t_start, t_end;
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+
     mnode_t **new_buckets = calloc(new_capacity, sizeof(mnode_t *));
     if (new_buckets == NULL) {
         return -1;
@@ -126,17 +145,38 @@ static inline int map_resize(map_t *map, size_t new_capacity) {
 
     // pr_info(" -> { c: %zu, t: %zu }\n", map->capacity, map->rehash_threshold);
 
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+    map->n_resizes += 1;
+    map->resize_secs += (double) (t_end.tv_sec - t_start.tv_sec);
+    map->resize_secs += (double) (t_end.tv_nsec - t_start.tv_nsec) / 1.0E9;
+
     return 0;
 }
 
-map_t *map_create(cmp_fn cmpfn, hash64_fn hashfn) {
+/**
+ * Get the number of buckets needed to hold `n_entries` entries below the load factor threshold. The
+ * capacity is kept a power of two multiple of the initial capacity, as if the map had grown to it.
+ */
+static inline size_t capacity_for(size_t n_entries) {
+    size_t capacity = N_BUCKETS_INITIAL;
+
+    while (calc_rehash_threshold(capacity) <= n_entries) {
+        capacity *= 2;
+    }
+
+    return capacity;
+}
+
+map_t *map_create_with_capacity(cmp_fn cmpfn, hash64_fn hashfn, size_t capacity) {
     map_t *map = malloc(sizeof(map_t));
     if (map == NULL) {
         pr_error("Failed to allocate memory\n");
         return NULL;
     }
 
-    map->buckets = calloc(N_BUCKETS_INITIAL, sizeof(mnode_t *));
+    size_t n_buckets = capacity_for(capacity);
+
+    map->buckets = calloc(n_buckets, sizeof(mnode_t *));
     if (map->buckets == NULL) {
         pr_error("Failed to allocate memory\n");
         free(map);
@@ -146,12 +186,28 @@ map_t *map_create(cmp_fn cmpfn, hash64_fn hashfn) {
     map->cmpfn = cmpfn;
     map->hashfn = hashfn;
     map->length = 0;
-    map->capacity = N_BUCKETS_INITIAL;
-    map->rehash_threshold = calc_rehash_threshold(N_BUCKETS_INITIAL);
+    map->capacity = n_buckets;
+    map->rehash_threshold = calc_rehash_threshold(n_buckets);
+    map->n_resizes = 0;
+    map->resize_secs = 0.0;
 
     return map;
 }
 
+map_t *map_create(cmp_fn cmpfn, hash64_fn hashfn) {
+    return map_create_with_capacity(cmpfn, hashfn, 0);
+}
+
+int map_reserve(map_t *map, size_t n_entries) {
+    size_t new_capacity = capacity_for(n_entries);
+
+    if (new_capacity <= map->capacity) {
+        return 0; // already large enough
+    }
+
+    return map_resize(map, new_capacity);
+}
+
 void map_destroy(map_t *map, free_fn key_freefn, free_fn val_freefn) {
     if (!map) {
         return;
@@ -283,6 +339,84 @@ entry_t *map_get(map_t *map, void *key) {
     return NULL;
 }
 
+/**
+ * Group prefetching: each group of keys is resolved in three passes. The first hashes every key and
+ * prefetches its bucket slot, the second loads the chain heads and prefetches the first node, and the third
+ * walks the chains. By the time a chain is walked, its memory is (hopefully) already in cache.
+ */
+size_t map_get_batch(map_t *map, void **keys, size_t n, entry_t **out_entries) {
+    size_t bucket_i[BATCH_GROUP_SIZE];
+    mnode_t *heads[BATCH_GROUP_SIZE];
+    size_t n_found = 0;
+
+    for (size_t base = 0; base < n; base += BATCH_GROUP_SIZE) {
+        size_t group_n = (n - base < BATCH_GROUP_SIZE) ? n - base : BATCH_GROUP_SIZE;
+
+        /* pass 1: hash all keys, prefetch their bucket slots */
+        for (size_t i = 0; i < group_n; i++) {
+            bucket_i[i] = map->hashfn(keys[base + i]) % map->capacity;
+            PREFETCH(&map->buckets[bucket_i[i]]);
+        }
+
+        /* pass 2: load chain heads, prefetch the first node of each chain */
+        for (size_t i = 0; i < group_n; i++) {
+            heads[i] = map->buckets[bucket_i[i]];
+            if (heads[i]) {
+                PREFETCH(heads[i]);
+            }
+        }
+
+        /* pass 3: resolve */
+        for (size_t i = 0; i < group_n; i++) {
+            mnode_t *node = heads[i];
+            void *key = keys[base + i];
+
+            out_entries[base + i] = NULL;
+
+            while (node) {
+                if (map->cmpfn(node->entry->key, key) == 0) {
+                    out_entries[base + i] = node->entry;
+                    n_found++;
+                    break;
+                }
+                node = node->overflow;
+            }
+        }
+    }
+
+    return n_found;
+}
+
+void map_stats(map_t *map, map_stats_t *stats) {
+    memset(stats, 0, sizeof(map_stats_t));
+
+    stats->length = map->length;
+    stats->capacity = map->capacity;
+    stats->load_factor = (double) map->length / (double) map->capacity;
+    stats->n_resizes = map->n_resizes;
+    stats->resize_secs = map->resize_secs;
+
+    /* every entry costs a node and an entry struct, on top of the bucket array */
+    stats->bytes = sizeof(map_t) + map->capacity * sizeof(mnode_t *);
+    stats->bytes += map->length * (sizeof(mnode_t) + sizeof(entry_t));
+
+    for (size_t i = 0; i < map->capacity; i++) {
+        size_t chain_len = 0;
+
+        for (mnode_t *node = map->buckets[i]; node; node = node->overflow) {
+            chain_len++;
+        }
+
+        if (chain_len > stats->max_chain) {
+            stats->max_chain = chain_len;
+        }
+        if (chain_len >= MAP_STATS_HIST_LEN) {
+            chain_len = MAP_STATS_HIST_LEN - 1;
+        }
+        stats->chain_hist[chain_len] += 1;
+    }
+}
+
 
 struct map_iter {
     mnode_t **buckets;
@@ -5,6 +5,7 @@
 /* set log level for prints in this file */
 #define LOG_LEVEL LOG_LEVEL_DEBUG
 
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -18,16 +19,177 @@
 #include "list.h"
 #include "map.h"
 #include "set.h"
+#include "strtypes.h"
+#include "docset.h"
+#include "postings.h"
+#include "positions.h"
+#include "trigrams.h"
+#include "completions.h"
+#include "termdict.h"
+#include "mphf.h"
 #include "ast.h"
+#include "program.h"
+#include "cursor.h"
+#include "arena.h"
 
 
+/**
+ * Number of documents to index before estimating the final vocabulary size, see `reserve_vocabulary`
+ */
+#define VOCAB_SAMPLE_DOCS 64
+
+/**
+ * Heaps' law exponent used to extrapolate the vocabulary size from the sample. The number of distinct terms
+ * in a collection of `n` tokens is roughly `K * n^beta`, where beta typically is in the range 0.4-0.6 for
+ * english text.
+ */
+#define VOCAB_HEAPS_BETA 0.5
+
+/**
+ * Number of (term, count) pairs the forward index initially has room for. It doubles whenever it is full.
+ */
+#define FWD_INITIAL_CAPACITY 1024
+
+/**
+ * Number of documents the document table initially has room for, unless told otherwise by
+ * `index_expect_documents`. It doubles whenever it is full.
+ */
+#define DOCS_INITIAL_CAPACITY 64
+
+/**
+ * Number of levels impacts are quantised to, i.e. the range of a `uint8_t`. Level 0 is reserved for
+ * documents that do not contain the term.
+ */
+#define IMPACT_LEVELS 256
+
+/**
+ * Number of compiled queries to keep. Once the cache is full, it is emptied, see `cache_program`.
+ */
+#define PROGRAM_CACHE_MAX 256
+
+/**
+ * Number of terms looked up at a time, with the entries or records of the batch on the stack
+ */
+#define LOOKUP_BATCH 64
+
+/**
+ * Number of results the array of a query starts out with, doubling as needed
+ */
+#define RESULTS_INITIAL_CAPACITY 64
+
+/**
+ * Interned term. Each distinct term is stored exactly once, and every other structure of the index refers to
+ * it by pointer, so terms can be compared by address instead of by `strcmp`.
+ */
+typedef struct term {
+    char *str;      // canonical copy of the term, owned by the record
+    uint32_t id;    // dense id, assigned in order of first occurrence
+    postings_t postings; // documents containing the term, with the frequency in each
+
+    /* cached idf, valid only while `idf_generation` matches the generation of the index (see `term_idf`) */
+    double idf;
+    uint64_t idf_generation;
+} term_t;
+
+/* one (term, count) pair of the forward index */
+typedef struct fwd_posting {
+    uint32_t term_id;
+    uint32_t count;
+} fwd_posting_t;
+
+/**
+ * Per-document statistics, stored column by column and indexed by document ID. Scoring only touches the
+ * columns it needs, and fetches each with a single array index.
+ */
+typedef struct doc_table {
+    size_t capacity;
+    uint32_t *len;       // number of (non stop word) terms in the document
+    double *norm;        // 1 / len, or 0 for an empty document
+    size_t *name_offset; // offset of the documents name in `names`
+    size_t *fwd_offset;  // the documents (term, count) pairs in the forward index, sorted by term id
+    uint32_t *fwd_len;
+    double *bm25_norm;   // k1 * (1 - b + b * len / average len), see `prepare_impacts`
+
+    /* the names of every document, back to back with their null terminators */
+    char *names;
+    size_t names_len;
+    size_t names_capacity;
+} doc_table_t;
+
+/**
+ * Slot of the perfect hash of a frozen index. The fingerprint rejects terms that are not in the index, which
+ * the perfect hash maps to some slot all the same.
+ */
+typedef struct {
+    uint32_t fingerprint;
+    uint32_t term_id;
+} mph_slot_t;
+
 struct index {
-    map_t *terms;
-    set_t *docs;
+    strmap_t *terms; // intern table, term string -> term_t. NULL while frozen
+    termdict_t *dict; // sorted dictionary, term string -> term id. Only while frozen, see `index_freeze`
+    mphf_t *mph;      // perfect hash of the terms to slots of `mph_slots`. Only while frozen, if it could be built
+    mph_slot_t *mph_slots;
+    completions_t *completions; // most frequent terms of every prefix of `dict`. Only while frozen, if built
+    term_t **records; // every term record, by term id. Owns the records
+    size_t records_capacity;
+    doc_table_t docs;
     size_t n_docs;
     size_t n_terms;
-    map_t *term_frequency;
-    map_t *doc_term_count; 
+    size_t n_tokens;      // number of (non stop word) terms indexed in total
+    size_t expected_docs; // cardinality hint, 0 if unknown
+    uint64_t generation;  // incremented by every indexed document, invalidates the cached idf of all terms
+
+    ranking_t ranking;
+    double bm25_k1;
+    double bm25_b;
+    /* generation the impacts of the postings were computed in, 0 if they are not valid */
+    uint64_t impacts_generation;
+    double dequant[IMPACT_LEVELS]; // score of each impact level
+
+    /* positional mode, see `index_set_positional`. `positions` holds the position lists of each term, by term
+        id, with room for as many terms as `records`. NULL unless positional */
+    bool positional;
+    positions_t *positions;
+
+    /* stop words are not terms, but a positional index keeps their postings and positions all the same, so that
+        phrases can check them. By their place in `stop_words`. NULL unless positional */
+    term_t *stop_records;
+    positions_t *stop_positions;
+
+    /* trigrams of the terms, for substring queries. NULL unless enabled, see `index_set_trigrams`. The lists
+        hold term ids, and `term_ranks` maps them to positions in `dict`. Only while frozen */
+    trigrams_t *trigrams;
+    uint32_t *term_ranks;
+
+    /* anytime evaluation of disjunctions, see `index_set_topk`. Disabled when topk is 0 */
+    size_t topk;
+    size_t topk_budget;
+
+    /* forward index: the (term, count) pairs of every document, back to back in one array */
+    fwd_posting_t *fwd;
+    size_t fwd_len;
+    size_t fwd_capacity;
+
+    /* scratch buffer for the term ids of the document being indexed */
+    uint32_t *scratch_ids;
+    size_t scratch_capacity;
+
+    /* compiled programs of recent queries, query string -> program_t. NULL until the first query. They are
+        only valid in the generation they were compiled in, as the terms of prefixes etc. change with the index */
+    strmap_t *programs;
+    uint64_t programs_generation;
+    size_t programs_hits;
+    size_t programs_misses;
+    program_scratch_t query_scratch; // scratch space for running programs, kept between queries
+
+    /* the positions of every term of a phrase in the document being checked, kept between queries */
+    uint32_t *phrase_positions;
+    size_t phrase_capacity;
+
+    /* memory of the query being answered: its ast, scoring state and results. Reset by the next query */
+    arena_t *query_arena;
+    size_t n_queries;
 };
 
 
@@ -51,32 +213,102 @@ int compare_results_by_score(query_result_t *a, query_result_t *b) {
 
 /* Helper Functions for index_destroy */
 
-/* destroys the set stored in index->terms */
-static void free_term_set(void *set_ptr) {
-    if (set_ptr) {
-        set_destroy(set_ptr, NULL);
+/* create the record of a new term, with empty postings */
+static term_t *term_create(const char *str, uint32_t id) {
+    term_t *record = malloc(sizeof(term_t));
+    if (record == NULL) {
+        return NULL;
+    }
+
+    record->str = strdup(str);
+    record->id = id;
+    record->idf = 0.0;
+    record->idf_generation = 0; // the index starts at generation 1, so the cache starts out stale
+    postings_init(&record->postings);
+    if (record->str == NULL) {
+        free(record);
+        return NULL;
     }
+
+    return record;
 }
 
+/* destroys a term record. Its string is also the key of its entry in index->terms */
+static void term_destroy(term_t *record) {
+    postings_deinit(&record->postings);
+    free(record->str);
+    free(record);
+}
 
-/* destroys the values in index->term_frequency
-    this has ownership of its keys and values */
-static void free_term_freq_map(void *map_ptr) {
-    if (map_ptr) {
-        map_destroy(map_ptr, free, free);
-    }
+
+/* destroys a cached program, and the query string it is cached by */
+static void program_entry_destroy(strmap_entry_t *entry) {
+    free(entry->key);
+    program_destroy(entry->val);
+}
+
+/* frees every column of the document table */
+static void doc_table_deinit(doc_table_t *docs) {
+    free(docs->len);
+    free(docs->norm);
+    free(docs->name_offset);
+    free(docs->fwd_offset);
+    free(docs->fwd_len);
+    free(docs->bm25_norm);
+    free(docs->names);
 }
 
 
-/* frees the size_t value in index_doc_term_count
-     */
-static void free_size_t_ptr(void *ptr) {
-    free(ptr);
+/* the stop words are listed at the end of the file. `stop_word_id` returns the place of a term in them, or -1 */
+extern const char *stop_words[];
+static int stop_word_id(const char *term);
+static size_t stop_words_count(void);
+
+/* frees the postings and positions of the stop words, if any */
+static void stop_words_deinit(index_t *index) {
+    if (index->stop_records) {
+        for (size_t i = 0; i < stop_words_count(); i++) {
+            postings_deinit(&index->stop_records[i].postings);
+        }
+    }
+    if (index->stop_positions) {
+        for (size_t i = 0; i < stop_words_count(); i++) {
+            positions_deinit(&index->stop_positions[i]);
+        }
+    }
+
+    free(index->stop_records);
+    free(index->stop_positions);
+    index->stop_records = NULL;
+    index->stop_positions = NULL;
 }
 
+/* makes an empty record and position list for every stop word. returns 0 on success */
+static int stop_words_init(index_t *index) {
+    size_t n = stop_words_count();
+
+    index->stop_records = calloc(n, sizeof(term_t));
+    index->stop_positions = calloc(n, sizeof(positions_t));
+    if (index->stop_records == NULL || index->stop_positions == NULL) {
+        stop_words_deinit(index);
+        return -1;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        index->stop_records[i].str = (char *) stop_words[i];
+        index->stop_records[i].id = (uint32_t) i;
+        postings_init(&index->stop_records[i].postings);
+        positions_init(&index->stop_positions[i]);
+    }
 
+    return 0;
+}
 
 index_t *index_create(cmp_fn cmpfn, hash64_fn hashfn) {
+    /* the index only has string keys, and uses containers specialised for them (see strtypes.h) */
+    UNUSED(cmpfn);
+    UNUSED(hashfn);
+
     index_t *index = malloc(sizeof(index_t));
     if (index == NULL) {
         pr_error("Failed to allocate memory for index\n");
@@ -85,51 +317,61 @@ index_t *index_create(cmp_fn cmpfn, hash64_fn hashfn) {
 
     /* initialize count for docs and terms*/
     index->terms = NULL;
-    index->docs = NULL;
-    index->term_frequency = NULL;
-    index->doc_term_count = NULL;
+    index->dict = NULL;
+    index->mph = NULL;
+    index->mph_slots = NULL;
+    index->records = NULL;
+    index->records_capacity = 0;
+    memset(&index->docs, 0, sizeof(doc_table_t));
     index->n_docs = 0;
     index->n_terms = 0;
-
-    /* createe the map to store the index */
-    index->terms = map_create(cmpfn, hashfn);
-    if (index->terms == NULL) {
-        pr_error("Failed to create map for index\n");
-        free(index);
-        return NULL;
-    }
-
-    /* create the set that will store the documents */
-    index->docs = set_create((cmp_fn) strcmp);
-    if (index->docs == NULL) {
-        pr_error("Failed to create set for index\n");
-        map_destroy(index->terms, NULL, NULL);
-        free(index);
-        return NULL;
-    }
-
-    /* create a map for the terms frequency */
-    index->term_frequency = map_create(cmpfn, hashfn);
-    if (index->term_frequency == NULL) {
-        pr_error("Failed to create map for term frequency\n");
-        map_destroy(index->terms, NULL, NULL);
-        set_destroy(index->docs, NULL);
+    index->n_tokens = 0;
+    index->expected_docs = 0;
+    index->generation = 1;
+    index->ranking = RANKING_TFIDF;
+    index->bm25_k1 = BM25_DEFAULT_K1;
+    index->bm25_b = BM25_DEFAULT_B;
+    index->impacts_generation = 0;
+    index->positional = false;
+    index->positions = NULL;
+    index->stop_records = NULL;
+    index->stop_positions = NULL;
+    index->trigrams = NULL;
+    index->term_ranks = NULL;
+    index->completions = NULL;
+    index->topk = 0;
+    index->topk_budget = 0;
+    index->fwd = NULL;
+    index->fwd_len = 0;
+    index->fwd_capacity = 0;
+    index->scratch_ids = NULL;
+    index->scratch_capacity = 0;
+    index->programs = NULL;
+    index->programs_generation = 0;
+    index->programs_hits = 0;
+    index->programs_misses = 0;
+    memset(&index->query_scratch, 0, sizeof(program_scratch_t));
+    index->phrase_positions = NULL;
+    index->phrase_capacity = 0;
+    index->n_queries = 0;
+
+    index->query_arena = arena_create();
+    if (index->query_arena == NULL) {
+        pr_error("Failed to allocate memory for queries\n");
         free(index);
         return NULL;
     }
 
-    /* create a map for the document term count
-        that is per document */
-    index->doc_term_count = map_create(cmpfn, hashfn);
-    if (index->doc_term_count == NULL) {
-        pr_error("Failed to create map for document frequency\n");
-        map_destroy(index->terms, NULL, NULL);
-        set_destroy(index->docs, NULL);
-        map_destroy(index->term_frequency, NULL, NULL);
+    /* createe the map to store the index */
+    index->terms = strmap_create();
+    if (index->terms == NULL) {
+        pr_error("Failed to create map for index\n");
+        arena_destroy(index->query_arena);
         free(index);
         return NULL;
     }
 
+    /* the document table is allocated as documents are added */
 
     return index;
 }
@@ -140,438 +382,2237 @@ void index_destroy(index_t *index) {
         return;
     }
 
-    /* destroys the terms, keys and values owned by the map */
-    if (index->terms) {
-        map_destroy(index->terms, free, free_term_set);
-    }
-
-    /* destroys the term_frequency in index
-        keys owned index->docs (NULL), values owned by map */
-    if (index->term_frequency) {
-        map_destroy(index->term_frequency, NULL, free_term_freq_map);
-    }
-
-    /* destroy doc_term_count in index
-        keys are owned by index->docs (NULL), values owned by map,
-        value should be malloced size _T*/
-    if (index->doc_term_count) {
-        map_destroy(index->doc_term_count, NULL, free_size_t_ptr);
+    /* destroys the term records, and the map (or dictionary) of them */
+    for (size_t i = 0; i < index->n_terms; i++) {
+        term_destroy(index->records[i]);
     }
-
-    /* destroy the docs in index
-        items owned by the set */
-    if (index->docs) {
-        set_destroy(index->docs, free);
+    free(index->records);
+    if (index->positions) {
+        for (size_t i = 0; i < index->n_terms; i++) {
+            positions_deinit(&index->positions[i]);
+        }
+        free(index->positions);
     }
-
+    stop_words_deinit(index);
+    trigrams_destroy(index->trigrams);
+    free(index->term_ranks);
+    completions_destroy(index->completions);
+    strmap_destroy(index->terms, NULL);
+    termdict_destroy(index->dict);
+    mphf_destroy(index->mph);
+    free(index->mph_slots);
+
+    /* destroy the document table, including the document names */
+    doc_table_deinit(&index->docs);
+
+    free(index->fwd);
+    free(index->scratch_ids);
+    strmap_destroy(index->programs, program_entry_destroy);
+    program_scratch_deinit(&index->query_scratch);
+    free(index->phrase_positions);
+    arena_destroy(index->query_arena);
     free(index);
 }
 
 
 
 
-int index_document(index_t *index, char *doc_name, list_t *terms) {
-    if (index == NULL || doc_name == NULL || terms == NULL) {
-        pr_error("Arguments cannot be NULL\n");
-        return -1;
+/* grow every column of the document table to hold (at least) `n` documents. returns 0 on success */
+static int doc_table_reserve(doc_table_t *docs, size_t n) {
+    if (n <= docs->capacity) {
+        return 0;
     }
 
+    size_t new_capacity = docs->capacity ? docs->capacity : DOCS_INITIAL_CAPACITY;
+    while (new_capacity < n) {
+        new_capacity *= 2;
+    }
+
+    /* the columns are grown one by one. If one fails, those already grown are just larger than needed */
+    void *column;
 
-    /* add document to the docs set, duplicate the sting */
-    char *doc_copy = strdup(doc_name);
-    if (doc_copy == NULL) {
-        pr_error("Failed to duplicate document name\n");
+    if ((column = realloc(docs->len, new_capacity * sizeof(uint32_t))) == NULL) {
         return -1;
     }
+    docs->len = column;
 
-    /* add this to docs */
-    set_insert(index->docs, doc_copy);
-    index->n_docs += 1;
+    if ((column = realloc(docs->norm, new_capacity * sizeof(double))) == NULL) {
+        return -1;
+    }
+    docs->norm = column;
 
-    /* create a map to store the frequancy in */
-    map_t *term_freq_doc = map_create((cmp_fn) strcmp, (hash64_fn) hash_string_fnv1a64);
-    if (term_freq_doc == NULL) {
-        pr_error("Failed to create map for term frequency\n");
-        free(doc_copy);
+    if ((column = realloc(docs->name_offset, new_capacity * sizeof(size_t))) == NULL) {
         return -1;
     }
+    docs->name_offset = column;
 
-    /* add the name and freq to the index */
-    map_insert(index->term_frequency, doc_copy, term_freq_doc);
+    if ((column = realloc(docs->fwd_offset, new_capacity * sizeof(size_t))) == NULL) {
+        return -1;
+    }
+    docs->fwd_offset = column;
 
+    if ((column = realloc(docs->fwd_len, new_capacity * sizeof(uint32_t))) == NULL) {
+        return -1;
+    }
+    docs->fwd_len = column;
 
-    /* iterate through the terms list*/
-    list_iter_t *terms_iter = list_createiter(terms);
-    if (terms_iter == NULL) {
-        pr_error("Failed to create iterator for terms\n");
-        free(doc_copy);
+    if ((column = realloc(docs->bm25_norm, new_capacity * sizeof(double))) == NULL) {
         return -1;
     }
+    docs->bm25_norm = column;
 
-    size_t current_doc_term_count = 0; /* used to count the number of terms in the document */
+    docs->capacity = new_capacity;
+    return 0;
+}
 
-    /* iterate throught the list for each term in the list
-        got help from ai debugging see chatlog_1 */
-    while (list_hasnext(terms_iter)) {
-        char *term = list_next(terms_iter);
-        if (term == NULL) {
-            pr_error("Failed to get next term from list\n");
-            continue;
-        }
+/* copy a document name to the end of the names array. returns its offset, or -1 on failure */
+static long doc_table_add_name(doc_table_t *docs, const char *name) {
+    size_t size = strlen(name) + 1;
 
-        /* check if the term is a stop word
-            if it returns true we start over with a new term
-            if it returns false we process that term */
-        if (stop_word(term)) {
-            continue;
+    if (docs->names_len + size > docs->names_capacity) {
+        size_t new_capacity = docs->names_capacity ? docs->names_capacity * 2 : 1024;
+        while (new_capacity < docs->names_len + size) {
+            new_capacity *= 2;
         }
 
-        current_doc_term_count++; /* increment the term count for this document */
-        
-        
-
-        /* check if the term is already in the map */
-        entry_t *entry = map_get(index->terms, term);
-        if (entry == NULL) {
-
-            /* create a seperate copy spcifically for insetion - help from ai */
-            char *term_key_for_index = strdup(term);
-            if (term_key_for_index == NULL) {
-                pr_error("Failed to duplicate term string\n");
-                continue;
-            }
-
-            /* create a new set to store the doc name */
-            set_t *docs_set = set_create((cmp_fn) strcmp);
-            if (docs_set == NULL) {
-                pr_error("Failed to create set for term\n");
-                free(term_key_for_index);
-                continue;
-            }
-            /* add the duplicate doc to the set */
-            set_insert(docs_set, doc_copy);
-            /* add the duplicate term to the map */
-            map_insert(index->terms, term_key_for_index, docs_set);
-            index->n_terms += 1; /* increment the number of terms */
+        char *new_names = realloc(docs->names, new_capacity);
+        if (new_names == NULL) {
+            return -1;
         }
+        docs->names = new_names;
+        docs->names_capacity = new_capacity;
+    }
 
-        /* if the term does exist in the map */
-        else {
-            /* get the existing set of doc names for this term */
-            set_t *existing_set = entry->val;
+    size_t offset = docs->names_len;
+    memcpy(&docs->names[offset], name, size);
+    docs->names_len += size;
+    return (long) offset;
+}
 
-            /* add the duplicate doc to the existing set */
-            set_insert(existing_set, doc_copy);
-        }
+int index_set_ranking(index_t *index, ranking_t ranking, double k1, double b) {
+    if (index == NULL) {
+        pr_error("Arguments cannot be NULL\n");
+        return -1;
+    }
 
-        /* update the term frequency for this document */
-        entry_t *term_freq = map_get(term_freq_doc, term);
-        if (term_freq == NULL) {
+    if (ranking == RANKING_BM25 && (!(k1 >= 0.0) || !(b >= 0.0 && b <= 1.0))) {
+        pr_error("BM25 parameters out of range: k1 = %g, b = %g\n", k1, b);
+        return -1;
+    }
 
-            /* create a seperate copy for TF doc key - help from ai */
-            char *term_key_for_tf = strdup(term);
-            if (term_key_for_tf == NULL) {
-                pr_error("Failed to duplicate term string for term frequency\n");
-                continue;
-            }
+    index->ranking = ranking;
+    index->bm25_k1 = k1;
+    index->bm25_b = b;
 
+    /* the impacts depend on the parameters */
+    index->impacts_generation = 0;
+    return 0;
+}
 
-            /* create a new term count */
-            uint32_t *new_term_count = malloc(sizeof(uint32_t));
-            if (new_term_count == NULL) {
-                pr_error("Failed to allocate memory for term frequency\n");
-                free(term_key_for_tf);
-                continue;
-            }
-            *new_term_count = 1; /* set the frequency to 1 */
-            map_insert(term_freq_doc, term_key_for_tf, new_term_count);
-        } 
-        
-        else {
-            /* increment the existing term frequency */
-            uint32_t *term_freq_value = term_freq->val;
-            *term_freq_value += 1; /* increment the frequency */
-        }
-        
+int index_set_positional(index_t *index, bool enabled) {
+    if (index == NULL) {
+        pr_error("Arguments cannot be NULL\n");
+        return -1;
+    }
 
+    /* documents indexed so far would be missing their positions */
+    if (index->n_docs > 0 && enabled != index->positional) {
+        pr_error("Positional mode can only be changed before any documents are indexed\n");
+        return -1;
     }
 
-    /* store the total count of term for y document
-        this is used later to count the tf-idf */
-    size_t *total_doc_term_count = malloc(sizeof(size_t));
-    if (total_doc_term_count == NULL) {
-        pr_error("Failed to allocate memory for total doc term count\n");
-        free(doc_copy);
-        map_destroy(term_freq_doc, free, free);
+    if (enabled && index->stop_records == NULL && stop_words_init(index) != 0) {
+        pr_error("Failed to allocate memory for the positions of stop words\n");
         return -1;
     }
-    *total_doc_term_count = current_doc_term_count;
+    if (!enabled) {
+        stop_words_deinit(index);
+    }
 
-    /* insert the total count into the map */
-    map_insert(index->doc_term_count, doc_copy, total_doc_term_count);
+    index->positional = enabled;
+    return 0;
+}
 
-    list_destroyiter(terms_iter);
+int index_set_trigrams(index_t *index, bool enabled) {
+    if (index == NULL) {
+        pr_error("Arguments cannot be NULL\n");
+        return -1;
+    }
 
+    /* the terms indexed so far would be missing from it */
+    if (index->n_docs > 0 && enabled != (index->trigrams != NULL)) {
+        pr_error("The trigram index can only be enabled or disabled before any documents are indexed\n");
+        return -1;
+    }
 
+    if (enabled && index->trigrams == NULL) {
+        index->trigrams = trigrams_create();
+        if (index->trigrams == NULL) {
+            return -1;
+        }
+    } else if (!enabled) {
+        trigrams_destroy(index->trigrams);
+        index->trigrams = NULL;
+    }
     return 0;
 }
 
-/* returns the terms - from ai */
-map_t *index_get_terms_map(index_t *index) {
+void index_set_topk(index_t *index, size_t k, size_t budget) {
     if (index == NULL) {
-        return NULL;
+        pr_error("Arguments cannot be NULL\n");
+        return;
+    }
+
+    /* the impact ordered postings are only built while enabled */
+    if (k && !index->topk) {
+        index->impacts_generation = 0;
     }
-    return index->terms;
+
+    index->topk = k;
+    index->topk_budget = budget;
 }
 
-/* got some help from ai with this */
+void index_expect_documents(index_t *index, size_t n_docs) {
+    if (index == NULL) {
+        return;
+    }
+    index->expected_docs = n_docs;
 
-list_t *index_query(index_t *index, list_t *query_tokens, char *errmsg) {
-    
-    if (index == NULL || query_tokens == NULL) {
-        pr_error("Arguments cannot be NULL\n");
-        return NULL;
+    /* the document table gets exactly one row per document */
+    if (doc_table_reserve(&index->docs, n_docs) != 0) {
+        pr_warn("Failed to presize the document table, continuing without\n");
     }
+}
 
-    /* parse the query tokens into the ast */
-    list_iter_t *tokens_iter = list_createiter(query_tokens);
-    if (tokens_iter == NULL) {
-        pr_error("Failed to create iterator for query tokens\n");
-        return NULL;
+/* make room for (at least) `n` more pairs in the forward index. returns 0 on success */
+static int fwd_reserve(index_t *index, size_t n) {
+    size_t needed = index->fwd_len + n;
+    if (needed <= index->fwd_capacity) {
+        return 0;
     }
 
-    /* parse the expression */
-    AST *ast = parse_expression(tokens_iter, errmsg);
-    if (ast == NULL) {
-        if (errmsg[0] == '\0') {
-            snprintf(errmsg, LINE_MAX, "Failed to parse query expression");
-        }
-        list_destroyiter(tokens_iter);
-        return NULL;
+    size_t new_capacity = index->fwd_capacity ? index->fwd_capacity : FWD_INITIAL_CAPACITY;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
     }
-    list_destroyiter(tokens_iter);
 
-    /* call for the ast_results to get matching documents */
-    set_t *result_set = ast_result(ast, index, errmsg);
-    if (result_set == NULL) {
-        snprintf(errmsg, LINE_MAX, "Failed to get result set");
-        ast_destroy(ast);
-        return NULL;
+    /* spans are stored as offsets, so the array is free to move */
+    fwd_posting_t *new_fwd = realloc(index->fwd, new_capacity * sizeof(fwd_posting_t));
+    if (new_fwd == NULL) {
+        return -1;
     }
 
-    /* create a list to store the results */
-    list_t *result_list = list_create((cmp_fn) compare_results_by_score);
-    if (result_list == NULL) {
-        snprintf(errmsg, LINE_MAX, "Failed to create result list");
-        set_destroy(result_set, free);
-        ast_destroy(ast);
-        return NULL;
+    index->fwd = new_fwd;
+    index->fwd_capacity = new_capacity;
+    return 0;
+}
+
+/* make sure the scratch buffer can hold the term ids of a document of `n` tokens. returns 0 on success */
+static int scratch_reserve(index_t *index, size_t n) {
+    if (n <= index->scratch_capacity) {
+        return 0;
     }
 
-    /* then iterate through the list of results for each document */
-    set_iter_t *result_iter = set_createiter(result_set);
-    if (result_iter == NULL) {
-        snprintf(errmsg, LINE_MAX, "Failed to create iterator for result set");
-        set_destroy(result_set, free);
-        ast_destroy(ast);
-        list_destroy(result_list, free);
-        return NULL;
+    uint32_t *new_scratch = realloc(index->scratch_ids, n * sizeof(uint32_t));
+    if (new_scratch == NULL) {
+        return -1;
     }
-    while (set_hasnext(result_iter)) {
-        char *doc_name = set_next(result_iter);
-        if (doc_name == NULL) {
-            snprintf(errmsg, LINE_MAX, "Failed to get next document name");
-            continue;
-        }
 
-        /* create a new query result */
-        query_result_t *result = malloc(sizeof(query_result_t));
-        if (result == NULL) {
-            snprintf(errmsg, LINE_MAX, "Failed to allocate memory for query result");
-            continue;
-        }
+    index->scratch_ids = new_scratch;
+    index->scratch_capacity = n;
+    return 0;
+}
 
-        /* set the document name and score */
-        result->doc_name = strdup(doc_name);
-        if (result->doc_name == NULL) {
-            snprintf(errmsg, LINE_MAX, "Failed to duplicate document name");
-            free(result);
-            continue;
-        }
-        
-        result->score = calculate_tfidf(index, ast, doc_name); /* calculate the score */
+/* make sure the records array has room for `n` terms. returns 0 on success */
+static int records_reserve(index_t *index, size_t n) {
+    if (n <= index->records_capacity) {
+        return 0;
+    }
 
-        /* add the result to the list */
-        if (list_addlast(result_list, result) < 0) {
-            snprintf(errmsg, LINE_MAX, "Failed to add result to list");
-            free(result->doc_name);
-            free(result);
-            set_destroyiter(result_iter);
-            set_destroy(result_set, free);
-            ast_destroy(ast);
-            list_destroy(result_list, free);
-            return NULL;
+    size_t new_capacity = index->records_capacity ? index->records_capacity : 1024;
+    while (new_capacity < n) {
+        new_capacity *= 2;
+    }
+
+    /* the position lists grow first. If the records then fail to, they just have room to spare */
+    if (index->positional) {
+        positions_t *new_positions = realloc(index->positions, new_capacity * sizeof(positions_t));
+        if (new_positions == NULL) {
+            return -1;
         }
+        index->positions = new_positions;
     }
 
-    /* sort the result list */
-    list_sort(result_list);
+    term_t **new_records = realloc(index->records, new_capacity * sizeof(term_t *));
+    if (new_records == NULL) {
+        return -1;
+    }
 
-    /* cleanup and return */
-    set_destroyiter(result_iter);
-    set_destroy(result_set, NULL);
-    ast_destroy(ast);
-    return result_list;
+    index->records = new_records;
+    index->records_capacity = new_capacity;
+    return 0;
+}
 
+static int compare_term_ids(const void *a, const void *b) {
+    uint32_t id_a = *(const uint32_t *) a;
+    uint32_t id_b = *(const uint32_t *) b;
+    return (id_a > id_b) - (id_a < id_b);
+}
+
+/* binary search for the count of a term in the pairs of a document, 0 if the document does not contain it */
+static uint32_t fwd_lookup(index_t *index, doc_id_t doc_id, uint32_t term_id) {
+    const fwd_posting_t *pairs = &index->fwd[index->docs.fwd_offset[doc_id]];
+    size_t len = index->docs.fwd_len[doc_id];
+    size_t lo = 0;
+    size_t hi = len;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (pairs[mid].term_id < term_id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
 
+    return (lo < len && pairs[lo].term_id == term_id) ? pairs[lo].count : 0;
 }
 
-void index_stat(index_t *index, size_t *n_docs, size_t *n_terms) {
-    if (index == NULL || n_docs == NULL || n_terms == NULL) {
-        pr_error("Arguments cannot be NULL\n");
+/**
+ * Presize the terms map and the forward index after indexing a sample of the expected documents. The final
+ * vocabulary size is extrapolated from the sample with Heaps' law, assuming the remaining documents are of
+ * similar length. The forward index grows linearly with the number of documents.
+ */
+static void reserve_vocabulary(index_t *index) {
+    if (index->expected_docs <= index->n_docs || index->n_tokens == 0) {
         return;
     }
 
-    /* get the number of documents and terms in the index */
-    *n_docs = index->n_docs;
-    *n_terms = index->n_terms;
+    double expected_tokens = (double) index->n_tokens * (double) index->expected_docs / (double) index->n_docs;
+    double growth = pow(expected_tokens / (double) index->n_tokens, VOCAB_HEAPS_BETA);
+    size_t expected_terms = (size_t) ((double) index->n_terms * growth);
 
-    /* print the number of documents and terms - from autocomplete */
-    pr_info("Number of documents: %zu\n", *n_docs);
-    pr_info("Number of terms: %zu\n", *n_terms);
+    pr_debug("Expecting a vocabulary of ~%zu terms\n", expected_terms);
 
+    if (strmap_reserve(index->terms, expected_terms) != 0 || records_reserve(index, expected_terms) != 0) {
+        pr_warn("Failed to presize the terms map, continuing without\n");
+    }
+
+    /* in floating point, like the tokens, as the product may not fit a size_t. The pairs still to come are
+        clamped at 0, so that rounding never wraps them around to a huge reservation */
+    double growth_docs = (double) index->expected_docs / (double) index->n_docs;
+    size_t expected_pairs = (size_t) ((double) index->fwd_len * growth_docs);
+    size_t remaining_pairs = (expected_pairs > index->fwd_len) ? expected_pairs - index->fwd_len : 0;
+    if (fwd_reserve(index, remaining_pairs) != 0) {
+        pr_warn("Failed to presize the forward index, continuing without\n");
+    }
 }
 
+/* fingerprint of a term, from its hash. Remixed so that it is independent of the slot the hash is mapped to */
+static inline uint32_t term_fingerprint(uint64_t hash) {
+    hash ^= 0x2545f4914f6cdd1dULL;
+    hash = (hash ^ (hash >> 33)) * 0xff51afd7ed558ccdULL;
+    hash = (hash ^ (hash >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+    return (uint32_t) ((hash ^ (hash >> 33)) >> 32);
+}
 
-/* calculates the TF-IDF recursively for each term in the document
-with help from https://en.wikipedia.org/wiki/Tf%E2%80%93idf and
-https://www.geeksforgeeks.org/understanding-tf-idf-term-frequency-inverse-document-frequency/
-and got help from AI, in regards to compilation errors */
-double calculate_tfidf(index_t *index, AST *ast, char *doc_name) {
+/* build the perfect hash of the terms, and its slots. Needs the strings of the records. returns 0 on success */
+static int build_term_mph(index_t *index) {
+    uint64_t *hashes = malloc((index->n_terms + 1) * sizeof(uint64_t));
+    if (hashes == NULL) {
+        return -1;
+    }
 
-    if (ast == NULL) {
-        pr_error("AST node is NULL\n");
-        return 0.0;
+    for (size_t i = 0; i < index->n_terms; i++) {
+        hashes[i] = fnv1a64_str(index->records[i]->str);
     }
 
-    double tfidf_score = 0.0;
+    mphf_t *mph = mphf_build(hashes, index->n_terms);
+    mph_slot_t *slots = malloc((index->n_terms + 1) * sizeof(mph_slot_t));
+    if (mph == NULL || slots == NULL) {
+        mphf_destroy(mph);
+        free(slots);
+        free(hashes);
+        return -1;
+    }
 
-    switch (ast->type) {
-        case AST_TERM: {
-            /* -- TF -- */
+    for (size_t i = 0; i < index->n_terms; i++) {
+        size_t slot = mphf_lookup(mph, hashes[i]);
+        slots[slot].fingerprint = term_fingerprint(hashes[i]);
+        slots[slot].term_id = (uint32_t) i;
+    }
+    free(hashes);
 
-            /* get the maps entry containing the docs term */
-            entry_t *TF_map_entry = map_get(index->term_frequency, doc_name);
-            if (TF_map_entry == NULL) {
-                return 0.0;
-            }
+    index->mph = mph;
+    index->mph_slots = slots;
+    return 0;
+}
 
-            /* gget the actual value from the map */
-            map_t *doc_term_count = TF_map_entry->val;
-            if (doc_term_count == NULL) {
-                return 0.0;
-            }
+/* memory used by the perfect hash and its slots, in bytes */
+static size_t mph_bytes(index_t *index) {
+    if (index->mph == NULL) {
+        return 0;
+    }
+    return mphf_bytes(index->mph) + index->n_terms * sizeof(mph_slot_t);
+}
 
-            /* get the total number of term in y doc (doc_name) */
-            entry_t *total_entry_count = map_get(index->doc_term_count, doc_name);
-            if (total_entry_count == NULL) {
-                return 0.0;
-            }
-            /* get the total number of terms in the document */
-            size_t *total_num_term_ptr = total_entry_count->val;
-            if (total_num_term_ptr == NULL) { 
-                return 0.0;
-            }
+static int compare_records_by_str(const void *a, const void *b) {
+    return strcmp((*(term_t *const *) a)->str, (*(term_t *const *) b)->str);
+}
+
+int index_freeze(index_t *index) {
+    if (index == NULL) {
+        pr_error("Arguments cannot be NULL\n");
+        return -1;
+    }
+    if (index->dict) {
+        return 0; // already frozen
+    }
 
-            /* this holds the value for the docs */
-            size_t *total_doc_term_count = total_num_term_ptr;
-            if (total_doc_term_count == 0) {
-                return 0.0;
+    term_t **sorted = malloc((index->n_terms + 1) * sizeof(term_t *));
+    const char **strs = malloc((index->n_terms + 1) * sizeof(char *));
+    uint32_t *ids = malloc((index->n_terms + 1) * sizeof(uint32_t));
+    uint32_t *ranks = index->trigrams ? malloc((index->n_terms + 1) * sizeof(uint32_t)) : NULL;
+
+    termdict_t *dict = NULL;
+    completions_t *completions = NULL;
+    if (sorted && strs && ids) {
+        memcpy(sorted, index->records, index->n_terms * sizeof(term_t *));
+        qsort(sorted, index->n_terms, sizeof(term_t *), compare_records_by_str);
+
+        for (size_t i = 0; i < index->n_terms; i++) {
+            strs[i] = sorted[i]->str;
+            ids[i] = sorted[i]->id;
+            if (ranks) {
+                ranks[sorted[i]->id] = (uint32_t) i;
             }
+        }
+        dict = termdict_build(strs, ids, index->n_terms);
 
-            /* calculate the TF for one term */
-            double tf = 0.0;
+        /* completions are ranked by document frequency. The ids were copied by the dictionary, so the array
+            is free to hold the frequencies */
+        for (size_t i = 0; dict && i < index->n_terms; i++) {
+            ids[i] = (uint32_t) sorted[i]->postings.len;
+        }
+        completions = dict ? completions_build(strs, ids, index->n_terms) : NULL;
+    }
 
-            /* get the term count for the term in the document */
-            entry_t *term_count_entry = map_get(doc_term_count, ast->data.term);
-            if (term_count_entry == NULL) {
-                return 0.0;
-            }
+    free(sorted);
+    free(strs);
+    free(ids);
 
-            /* get the actual value from the map */
-            uint32_t *term_count_ptr = term_count_entry->val;
-            if (term_count_ptr == NULL) {
-                return 0.0;
+    if (dict == NULL) {
+        pr_error("Failed to build the term dictionary\n");
+        free(ranks);
+        return -1;
+    }
+    if (completions == NULL) {
+        pr_warn("Failed to build the completions of the terms, prefixes cannot be completed\n");
+    }
+    if (index->trigrams && ranks == NULL) {
+        pr_warn("Failed to map the trigram index to the dictionary, substring queries will check every term\n");
+    }
+
+    /* exact lookups go through the perfect hash. The dictionary is still needed to list the terms in order */
+    if (build_term_mph(index) != 0) {
+        pr_warn("Failed to build the perfect hash of the terms, looking them up in the dictionary instead\n");
+    }
+
+    /* the dictionary now holds the only copy of the terms that is needed. The map and the strings of the
+        records are rebuilt by `index_thaw` if more documents are added */
+    strmap_destroy(index->terms, NULL);
+    index->terms = NULL;
+    for (size_t i = 0; i < index->n_terms; i++) {
+        free(index->records[i]->str);
+        index->records[i]->str = NULL;
+    }
+    index->dict = dict;
+    index->term_ranks = ranks;
+    index->completions = completions;
+    return 0;
+}
+
+/* undo `index_freeze`, restoring the map of terms and the strings of the records. returns 0 on success */
+static int index_thaw(index_t *index) {
+    strmap_t *terms = strmap_create();
+    termdict_iter_t iter;
+
+    if (terms == NULL || strmap_reserve(terms, index->n_terms) != 0
+        || termdict_iter_range(index->dict, &iter, NULL, NULL) != 0) {
+        strmap_destroy(terms, NULL);
+        return -1;
+    }
+
+    const char *str;
+    uint32_t id;
+    int inserted;
+    int status = 0;
+
+    while (status == 0 && (str = termdict_iter_next(&iter, &id)) != NULL) {
+        term_t *record = index->records[id];
+        record->str = strdup(str);
+
+        strmap_entry_t *entry = record->str ? strmap_put(terms, record->str, &inserted) : NULL;
+        if (entry == NULL) {
+            status = -1;
+            break;
+        }
+        entry->val = record;
+    }
+    termdict_iter_deinit(&iter);
+
+    if (status != 0) {
+        /* back to frozen. Strings restored so far are freed again */
+        for (size_t i = 0; i < index->n_terms; i++) {
+            free(index->records[i]->str);
+            index->records[i]->str = NULL;
+        }
+        strmap_destroy(terms, NULL);
+        return -1;
+    }
+
+    termdict_destroy(index->dict);
+    index->dict = NULL;
+    mphf_destroy(index->mph);
+    index->mph = NULL;
+    free(index->mph_slots);
+    index->mph_slots = NULL;
+    free(index->term_ranks);
+    index->term_ranks = NULL;
+    completions_destroy(index->completions);
+    index->completions = NULL;
+    index->terms = terms;
+    return 0;
+}
+
+/* counts a stop word at `position` of a document, in its postings and positions. Stop words are not terms, so
+    this is all that is kept of them, and only by a positional index */
+static void add_stop_word(index_t *index, int stop_id, doc_id_t doc_id, uint32_t position) {
+    postings_t *postings = &index->stop_records[stop_id].postings;
+    positions_t *positions = &index->stop_positions[stop_id];
+    bool new_doc = postings->len == 0 || postings_docs(postings)[postings->len - 1] != doc_id;
+
+    if (positions_reserve(positions) != 0 || postings_add(postings, doc_id) != 0) {
+        return;
+    }
+    positions_add(positions, new_doc, position);
+}
+
+int index_document(index_t *index, char *doc_name, list_t *terms) {
+    if (index == NULL || doc_name == NULL || terms == NULL) {
+        pr_error("Arguments cannot be NULL\n");
+        return -1;
+    }
+
+    /* a frozen index has to go back to its map of terms to take new ones */
+    if (index->dict && index_thaw(index) != 0) {
+        pr_error("Failed to thaw the index\n");
+        free(doc_name);
+        list_destroy(terms, free);
+        return -1;
+    }
+
+    /* make room for the term ids of the document, and the pairs it can add to the forward index.
+        The number of tokens is an upper bound for both, and for the number of new terms */
+    size_t n_tokens = list_length(terms);
+    if (scratch_reserve(index, n_tokens) != 0 || fwd_reserve(index, n_tokens) != 0
+        || records_reserve(index, index->n_terms + n_tokens) != 0
+        || doc_table_reserve(&index->docs, index->n_docs + 1) != 0) {
+        pr_error("Failed to allocate memory for document\n");
+        free(doc_name);
+        list_destroy(terms, free);
+        return -1;
+    }
+
+    /* add the document to the document table, under the next free ID. The index keeps its own copy of
+        the name */
+    doc_table_t *docs = &index->docs;
+    doc_id_t doc_id = (doc_id_t) index->n_docs;
+    long name_offset = doc_table_add_name(docs, doc_name);
+    free(doc_name);
+
+    if (name_offset < 0) {
+        pr_error("Failed to allocate memory for document name\n");
+        list_destroy(terms, free);
+        return -1;
+    }
+
+    /* iterate through the terms list*/
+    list_iter_t *terms_iter = list_createiter(terms);
+    if (terms_iter == NULL) {
+        pr_error("Failed to create iterator for terms\n");
+        docs->names_len = (size_t) name_offset;
+        list_destroy(terms, free);
+        return -1;
+    }
+    index->n_docs += 1;
+    index->generation += 1;
+
+    int inserted;
+    uint32_t *term_ids = index->scratch_ids;
+    size_t current_doc_term_count = 0; /* used to count the number of terms in the document */
+    uint32_t position = 0;             /* position of the next token. Stop words take up a position too */
+
+    /* iterate throught the list for each term in the list
+        got help from ai debugging see chatlog_1 */
+    while (list_hasnext(terms_iter)) {
+        char *term = list_next(terms_iter);
+        if (term == NULL) {
+            pr_error("Failed to get next term from list\n");
+            continue;
+        }
+        uint32_t term_position = position++;
+
+        /* check if the term is a stop word
+            if it is, only its position is kept (if positional), and we start over with a new term
+            if it is not, we process that term */
+        int stop_id = stop_word_id(term);
+        if (stop_id >= 0) {
+            if (index->positional) {
+                add_stop_word(index, stop_id, doc_id, term_position);
+            }
+            continue;
+        }
+
+        /* intern the term, creating its record the first time it is seen */
+        strmap_entry_t *entry = strmap_put(index->terms, term, &inserted);
+        if (inserted) {
+            term_t *new_record = term_create(term, (uint32_t) index->n_terms);
+            if (new_record == NULL) {
+                pr_error("Failed to create entry for term\n");
+                strmap_remove(index->terms, term, NULL);
+                continue;
+            }
+
+            /* the canonical copy compares equal to the term, so it can replace it as key */
+            entry->key = new_record->str;
+            entry->val = new_record;
+            index->records[index->n_terms] = new_record;
+            if (index->positional) {
+                positions_init(&index->positions[index->n_terms]);
+            }
+
+            /* substring queries can always fall back to checking every term, so a failure here is not fatal */
+            if (index->trigrams && trigrams_add(index->trigrams, new_record->str, new_record->id) != 0) {
+                pr_warn("Failed to index the trigrams of '%s', substring queries will check every term\n", term);
+                trigrams_destroy(index->trigrams);
+                index->trigrams = NULL;
+            }
+            index->n_terms += 1; /* increment the number of terms */
+        }
+
+        term_t *record = entry->val;
+        postings_t *postings = &record->postings;
+        bool new_doc = postings->len == 0 || postings_docs(postings)[postings->len - 1] != doc_id;
+
+        /* room for the position is made first, so that it cannot fail once the posting is counted */
+        positions_t *positions = index->positional ? &index->positions[record->id] : NULL;
+        if (positions && positions_reserve(positions) != 0) {
+            continue;
+        }
+
+        /* count the term in this document's postings */
+        if (postings_add(postings, doc_id) != 0) {
+            continue;
+        }
+        if (positions) {
+            positions_add(positions, new_doc, term_position);
+        }
+
+        /* the frequencies are counted below, once every term id of the document is known */
+        term_ids[current_doc_term_count++] = record->id;
+    }
+
+    list_destroyiter(terms_iter);
+
+    /* every term is interned by now, the tokens are no longer needed */
+    list_destroy(terms, free);
+
+    /* sort the term ids, so that equal ids are adjacent and can be counted into (term, count) pairs.
+        These are appended to the forward index in term id order */
+    qsort(term_ids, current_doc_term_count, sizeof(uint32_t), compare_term_ids);
+
+    size_t fwd_offset = index->fwd_len;
+    for (size_t i = 0; i < current_doc_term_count; i++) {
+        if (index->fwd_len > fwd_offset && index->fwd[index->fwd_len - 1].term_id == term_ids[i]) {
+            index->fwd[index->fwd_len - 1].count += 1;
+            continue;
+        }
+        index->fwd[index->fwd_len++] = (fwd_posting_t) { .term_id = term_ids[i], .count = 1 };
+    }
+
+    /* fill in the documents row of the table. The total count of terms is used later to count the tf-idf */
+    docs->len[doc_id] = (uint32_t) current_doc_term_count;
+    docs->norm[doc_id] = current_doc_term_count ? 1.0 / (double) current_doc_term_count : 0.0;
+    docs->name_offset[doc_id] = (size_t) name_offset;
+    docs->fwd_offset[doc_id] = fwd_offset;
+    docs->fwd_len[doc_id] = (uint32_t) (index->fwd_len - fwd_offset);
+    index->n_tokens += current_doc_term_count;
+
+    /* once a sample of the collection is indexed, presize for the rest of it */
+    if (index->n_docs == VOCAB_SAMPLE_DOCS) {
+        reserve_vocabulary(index);
+    }
+
+
+    return 0;
+}
+
+/**
+ * Get the idf of a term. It only changes when documents are added, so it is computed on first use after the
+ * last `index_document`, and then served from the term record.
+ */
+static double term_idf(index_t *index, term_t *record) {
+    if (record->idf_generation != index->generation) {
+        /* get the number of documents containing the term */
+        size_t Df = record->postings.len;
+
+        record->idf = (Df > 0) ? log((double) index->n_docs / (double) Df) : 0.0;
+        record->idf_generation = index->generation;
+    }
+    return record->idf;
+}
+
+/* the BM25 idf of a term found in `df` documents. Unlike the tf-idf one, it stays positive for terms found in
+    (almost) every document */
+static double bm25_idf(index_t *index, size_t df) {
+    double n = (double) index->n_docs;
+    return log(1.0 + (n - (double) df + 0.5) / ((double) df + 0.5));
+}
+
+/* the weight of a term in a document under the current ranking function, given the idf of the term and its
+    frequency in the document */
+static double posting_weight(index_t *index, double idf, uint32_t freq, doc_id_t doc_id) {
+    double tf = (double) freq;
+
+    if (index->ranking == RANKING_BM25) {
+        return idf * tf * (index->bm25_k1 + 1.0) / (tf + index->docs.bm25_norm[doc_id]);
+    }
+    return idf * tf * index->docs.norm[doc_id];
+}
+
+/* the idf of a term under the current ranking function */
+static double ranking_idf(index_t *index, term_t *record) {
+    return (index->ranking == RANKING_BM25) ? bm25_idf(index, record->postings.len) : term_idf(index, record);
+}
+
+/**
+ * Precompute the weight (impact) of every (term, document) pair under the current ranking function, quantised
+ * to `IMPACT_LEVELS` levels. BM25 scores are read straight from the impacts, and anytime evaluation (see
+ * `index_set_topk`) walks the postings in impact order, which is built here too when enabled.
+ *
+ * BM25 weights are bounded and evenly spread, so the levels are evenly spaced from 0 up to the largest weight.
+ * Relative tf-idf weights span several orders of magnitude, so their levels are spaced geometrically from the
+ * smallest to the largest weight instead. Either way, `dequant` holds the weight of each level.
+ *
+ * The BM25 length normalisation of a document depends on the average length of all of them, so it is computed
+ * here, rather than as the document is indexed. Everything stays valid until the next `index_document`,
+ * `index_set_ranking` or `index_set_topk`.
+ *
+ * returns 0 on success
+ */
+static int prepare_impacts(index_t *index) {
+    if (index->impacts_generation == index->generation) {
+        return 0;
+    }
+
+    doc_table_t *docs = &index->docs;
+    bool bm25 = (index->ranking == RANKING_BM25);
+
+    if (bm25) {
+        double k1 = index->bm25_k1;
+        double b = index->bm25_b;
+        double avg_len = index->n_docs ? (double) index->n_tokens / (double) index->n_docs : 0.0;
+
+        for (size_t doc_id = 0; doc_id < index->n_docs; doc_id++) {
+            double rel_len = (avg_len > 0.0) ? (double) docs->len[doc_id] / avg_len : 0.0;
+            docs->bm25_norm[doc_id] = k1 * (1.0 - b + b * rel_len);
+        }
+    }
+
+    /* first pass: find the range of the (nonzero) weights */
+    double min_weight = HUGE_VAL;
+    double max_weight = 0.0;
+    for (size_t term_id = 0; term_id < index->n_terms; term_id++) {
+        term_t *record = index->records[term_id];
+        const postings_t *postings = &record->postings;
+        const doc_id_t *doc_ids = postings_docs(postings);
+        const uint32_t *freqs = postings_freqs(postings);
+        double idf = ranking_idf(index, record);
+
+        for (size_t i = 0; i < postings->len; i++) {
+            double weight = posting_weight(index, idf, freqs[i], doc_ids[i]);
+            if (weight > 0.0) {
+                min_weight = (weight < min_weight) ? weight : min_weight;
+                max_weight = (weight > max_weight) ? weight : max_weight;
+            }
+        }
+    }
+
+    /* level 0 is reserved for documents not containing the term */
+    double step = max_weight / (double) (IMPACT_LEVELS - 1);
+    double log_min = (max_weight > 0.0) ? log(min_weight) : 0.0;
+    double log_step = (max_weight > min_weight) ? (log(max_weight) - log_min) / (double) (IMPACT_LEVELS - 2) : 0.0;
+
+    index->dequant[0] = 0.0;
+    for (size_t level = 1; level < IMPACT_LEVELS; level++) {
+        index->dequant[level] = bm25 ? (double) level * step : exp(log_min + (double) (level - 1) * log_step);
+    }
+
+    /* second pass: quantise */
+    for (size_t term_id = 0; term_id < index->n_terms; term_id++) {
+        term_t *record = index->records[term_id];
+        postings_t *postings = &record->postings;
+
+        if (postings_reserve_impacts(postings) != 0) {
+            return -1;
+        }
+
+        const doc_id_t *doc_ids = postings_docs(postings);
+        const uint32_t *freqs = postings_freqs(postings);
+        double idf = ranking_idf(index, record);
+
+        for (size_t i = 0; i < postings->len; i++) {
+            double weight = posting_weight(index, idf, freqs[i], doc_ids[i]);
+            long level = 0;
+
+            if (weight > 0.0 && bm25) {
+                level = lround(weight / step);
+            } else if (weight > 0.0 && log_step > 0.0) {
+                level = 1 + lround((log(weight) - log_min) / log_step);
+            }
+
+            /* the document does contain the term, so it keeps the lowest nonzero level */
+            if (level < 1) {
+                level = 1;
+            } else if (level > IMPACT_LEVELS - 1) {
+                level = IMPACT_LEVELS - 1;
+            }
+            postings->impacts[i] = (uint8_t) level;
+        }
+
+        if (index->topk && postings_order_by_impact(postings) != 0) {
+            return -1;
+        }
+    }
+
+    index->impacts_generation = index->generation;
+    return 0;
+}
+
+/* resolves each term to its record, NULL if it is not indexed. returns the number found */
+static size_t lookup_terms(index_t *index, char **terms, size_t n, term_t **out_records) {
+    if (index->mph) {
+        size_t n_found = 0;
+
+        /* one probe of the perfect hash (usually its first level), and one of the slots */
+        for (size_t i = 0; i < n; i++) {
+            uint64_t hash = fnv1a64_str(terms[i]);
+            size_t slot = mphf_lookup(index->mph, hash);
+
+            out_records[i] = NULL;
+            if (slot < index->n_terms && index->mph_slots[slot].fingerprint == term_fingerprint(hash)) {
+                out_records[i] = index->records[index->mph_slots[slot].term_id];
+            }
+            n_found += (out_records[i] != NULL);
+        }
+        return n_found;
+    }
+
+    if (index->dict) {
+        size_t n_found = 0;
+        uint32_t id;
+
+        for (size_t i = 0; i < n; i++) {
+            out_records[i] = termdict_get(index->dict, terms[i], &id) ? index->records[id] : NULL;
+            n_found += (out_records[i] != NULL);
+        }
+        return n_found;
+    }
+
+    /* look up the terms a batch at a time */
+    strmap_entry_t *entries[LOOKUP_BATCH];
+    size_t n_found = 0;
+
+    for (size_t start = 0; start < n; start += LOOKUP_BATCH) {
+        size_t n_batch = (n - start < LOOKUP_BATCH) ? n - start : LOOKUP_BATCH;
+        n_found += strmap_get_batch(index->terms, &terms[start], n_batch, entries);
+        for (size_t i = 0; i < n_batch; i++) {
+            out_records[start + i] = entries[i] ? entries[i]->val : NULL;
+        }
+    }
+
+    return n_found;
+}
+
+size_t index_lookup_terms(index_t *index, char **terms, size_t n, const postings_t **out_postings) {
+    if (index == NULL || terms == NULL || out_postings == NULL) {
+        pr_error("Arguments cannot be NULL\n");
+        return 0;
+    }
+
+    term_t *records[LOOKUP_BATCH];
+    size_t n_found = 0;
+
+    for (size_t start = 0; start < n; start += LOOKUP_BATCH) {
+        size_t n_batch = (n - start < LOOKUP_BATCH) ? n - start : LOOKUP_BATCH;
+        n_found += lookup_terms(index, &terms[start], n_batch, records);
+        for (size_t i = 0; i < n_batch; i++) {
+            out_postings[start + i] = records[i] ? &records[i]->postings : NULL;
+        }
+    }
+
+    return n_found;
+}
+
+/* the record a postings list belongs to. Every postings list handed out by the index is part of one */
+static inline term_t *postings_record(const postings_t *postings) {
+    return (term_t *) ((const char *) postings - offsetof(term_t, postings));
+}
+
+/* the position lists of a record, which is either a term or a stop word */
+static inline positions_t *record_positions(index_t *index, const term_t *record) {
+    const term_t *stop_records = index->stop_records;
+    if (stop_records && record >= stop_records && record < stop_records + stop_words_count()) {
+        return &index->stop_positions[record->id];
+    }
+    return &index->positions[record->id];
+}
+
+const postings_t *index_lookup_stop_word(index_t *index, const char *word) {
+    if (index == NULL || word == NULL) {
+        pr_error("Arguments cannot be NULL\n");
+        return NULL;
+    }
+
+    int stop_id = stop_word_id(word);
+    if (stop_id < 0 || index->stop_records == NULL) {
+        return NULL;
+    }
+    return &index->stop_records[stop_id].postings;
+}
+
+/* make sure the phrase buffer can hold `n` positions. returns 0 on success */
+static int phrase_reserve(index_t *index, size_t n) {
+    if (n <= index->phrase_capacity) {
+        return 0;
+    }
+
+    size_t new_capacity = index->phrase_capacity ? index->phrase_capacity : 64;
+    while (new_capacity < n) {
+        new_capacity *= 2;
+    }
+
+    uint32_t *new_positions = realloc(index->phrase_positions, new_capacity * sizeof(uint32_t));
+    if (new_positions == NULL) {
+        return -1;
+    }
+
+    index->phrase_positions = new_positions;
+    index->phrase_capacity = new_capacity;
+    return 0;
+}
+
+/**
+ * Check whether a document contains the phrase, given the positions of each of its terms in the document. The
+ * candidates for where the phrase starts come from the positions of the rarest term, and every other term
+ * walks its positions alongside them, so this is a single merge of the position lists. `heads` is scratch
+ * space for `n` positions.
+ */
+static bool phrase_in_document(
+    uint32_t **positions,
+    const uint32_t *counts,
+    const uint32_t *offsets,
+    size_t n,
+    size_t lead,
+    size_t *heads
+) {
+    memset(heads, 0, n * sizeof(size_t));
+
+    for (uint32_t k = 0; k < counts[lead]; k++) {
+        if (positions[lead][k] < offsets[lead]) {
+            continue; // the phrase would start before the document
+        }
+        uint32_t start = positions[lead][k] - offsets[lead];
+
+        bool found = true;
+        for (size_t i = 0; i < n && found; i++) {
+            uint32_t want = start + offsets[i];
+            while (heads[i] < counts[i] && positions[i][heads[i]] < want) {
+                heads[i]++;
+            }
+            if (heads[i] == counts[i]) {
+                return false; // every later start needs a later position still
+            }
+            found = positions[i][heads[i]] == want;
+        }
+
+        if (found) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int index_match_phrase(
+    index_t *index,
+    const postings_t **postings,
+    const uint32_t *offsets,
+    size_t n,
+    doc_id_t *out,
+    size_t *n_out,
+    char *errmsg
+) {
+    if (index == NULL || (n && (postings == NULL || offsets == NULL)) || n_out == NULL || errmsg == NULL) {
+        pr_error("Arguments cannot be NULL\n");
+        return -1;
+    }
+
+    if (!index->positional) {
+        snprintf(errmsg, LINE_MAX, "Phrase queries need an index with positions (--positions)");
+        return -1;
+    }
+
+    /* a phrase with a term that is not indexed (or no terms at all) is in no document */
+    *n_out = 0;
+    size_t lead = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (postings[i] == NULL) {
+            return 0;
+        }
+        if (postings[i]->len < postings[lead]->len) {
+            lead = i;
+        }
+    }
+    if (n == 0) {
+        return 0;
+    }
+
+    /* the state of each term lives as long as the query, and their positions in a buffer kept between them */
+    size_t *cursors = arena_calloc(index->query_arena, n, sizeof(size_t));
+    size_t *heads = arena_alloc(index->query_arena, n * sizeof(size_t));
+    uint32_t **positions = arena_alloc(index->query_arena, n * sizeof(uint32_t *));
+    uint32_t *counts = arena_alloc(index->query_arena, n * sizeof(uint32_t));
+    size_t n_matches = 0;
+    int status = 0;
+
+    if (cursors == NULL || heads == NULL || positions == NULL || counts == NULL) {
+        status = -1;
+        goto cleanup;
+    }
+
+    /**
+     * Intersect the documents first, leapfrogging from the rarest term: every other term seeks to its
+     * document, and the first one that does not have it moves the rarest term on to the document it does
+     * have. Positions are only decoded for documents with every term.
+     */
+    const doc_id_t *lead_docs = postings_docs(postings[lead]);
+    size_t lead_i = 0;
+
+    while (lead_i < postings[lead]->len) {
+        doc_id_t doc_id = lead_docs[lead_i];
+        bool in_all = true;
+
+        for (size_t i = 0; i < n; i++) {
+            cursors[i] = (i == lead) ? lead_i : postings_seek(postings[i], cursors[i], doc_id);
+            if (cursors[i] == postings[i]->len) {
+                goto cleanup; // no more documents with every term
+            }
+
+            doc_id_t found = postings_docs(postings[i])[cursors[i]];
+            if (found != doc_id) {
+                lead_i = postings_seek(postings[lead], lead_i, found);
+                in_all = false;
+                break;
+            }
+        }
+        if (!in_all) {
+            continue;
+        }
+
+        /* decode the positions of each term in the document, back to back */
+        size_t n_positions = 0;
+        for (size_t i = 0; i < n; i++) {
+            counts[i] = postings_freqs(postings[i])[cursors[i]];
+            n_positions += counts[i];
+        }
+        if (phrase_reserve(index, n_positions) != 0) {
+            status = -1;
+            goto cleanup;
+        }
+
+        n_positions = 0;
+        for (size_t i = 0; i < n; i++) {
+            positions[i] = &index->phrase_positions[n_positions];
+            n_positions += counts[i];
+
+            positions_t *term_positions = record_positions(index, postings_record(postings[i]));
+            positions_decode(term_positions, cursors[i], counts[i], positions[i]);
+        }
+
+        if (phrase_in_document(positions, counts, offsets, n, lead, heads)) {
+            out[n_matches++] = doc_id;
+        }
+        lead_i++;
+    }
+
+cleanup:
+    if (status == 0) {
+        *n_out = n_matches;
+    } else {
+        snprintf(errmsg, LINE_MAX, "Failed to allocate memory for phrase");
+    }
+    return status;
+}
+
+/* writes a prefix, fuzzy or substring node as it was written in the query, for messages */
+static void expansion_token(AST *node, char *buf, size_t size) {
+    if (node->type == AST_PREFIX) {
+        snprintf(buf, size, "%s*", node->data.expansion.str);
+    } else if (node->type == AST_SUBSTRING) {
+        snprintf(buf, size, "*%s*", node->data.expansion.str);
+    } else {
+        snprintf(buf, size, "%s~%u", node->data.expansion.str, node->data.expansion.max_edits);
+    }
+}
+
+/* expands a single prefix or fuzzy node, allocating its terms from `arena`. returns 0 on success */
+static int expand_node(index_t *index, AST *node, arena_t *arena, char *errmsg) {
+    char token[LINE_MAX / 2];
+    expansion_token(node, token, sizeof(token));
+
+    termdict_iter_t iter;
+    int status = (node->type == AST_PREFIX)
+        ? termdict_iter_prefix(index->dict, &iter, node->data.expansion.str)
+        : termdict_iter_fuzzy(index->dict, &iter, node->data.expansion.str, node->data.expansion.max_edits);
+    if (status != 0) {
+        snprintf(errmsg, LINE_MAX, "Failed to look up '%s'", token);
+        return -1;
+    }
+
+    char **terms = arena_alloc(arena, TERM_EXPANSION_MAX * sizeof(char *));
+    if (terms == NULL) {
+        snprintf(errmsg, LINE_MAX, "Failed to allocate memory for '%s'", token);
+        termdict_iter_deinit(&iter);
+        return -1;
+    }
+
+    size_t n = 0;
+    const char *term;
+
+    while ((term = termdict_iter_next(&iter, NULL)) != NULL) {
+        if (n == TERM_EXPANSION_MAX) {
+            snprintf(
+                errmsg,
+                LINE_MAX,
+                "'%s' matches more than %d terms, %s",
+                token,
+                TERM_EXPANSION_MAX,
+                (node->type == AST_PREFIX) ? "use a longer prefix" : "allow fewer edits"
+            );
+            status = -1;
+            break;
+        }
+
+        terms[n] = arena_strdup(arena, term);
+        if (terms[n] == NULL) {
+            snprintf(errmsg, LINE_MAX, "Failed to allocate memory for '%s'", token);
+            status = -1;
+            break;
+        }
+        n++;
+    }
+
+    termdict_iter_deinit(&iter);
+
+    if (status != 0) {
+        return -1;
+    }
+
+    node->data.expansion.terms = terms;
+    node->data.expansion.n_terms = n;
+    return 0;
+}
+
+/**
+ * expands a single substring node. The candidates are the terms with every trigram of the substring, if there is
+ * a trigram index and the substring is long enough to have any. Otherwise every term is. Either way, only the
+ * candidates that contain the substring match. The terms, and the candidates, are allocated from `arena`.
+ * returns 0 on success
+ */
+static int expand_substring(index_t *index, AST *node, arena_t *arena, char *errmsg) {
+    char token[LINE_MAX / 2];
+    expansion_token(node, token, sizeof(token));
+
+    const char *substring = node->data.expansion.str;
+    uint32_t *candidates = NULL;
+    size_t n_candidates = index->n_terms;
+
+    if (index->trigrams && index->term_ranks && strlen(substring) >= TRIGRAM_LEN) {
+        if (trigrams_candidates(index->trigrams, substring, arena, &candidates, &n_candidates) != 0) {
+            snprintf(errmsg, LINE_MAX, "Failed to look up '%s'", token);
+            return -1;
+        }
+
+        /* visit the candidates in the order of the dictionary, so they are decoded in a single pass over it */
+        for (size_t i = 0; i < n_candidates; i++) {
+            candidates[i] = index->term_ranks[candidates[i]];
+        }
+        qsort(candidates, n_candidates, sizeof(uint32_t), compare_term_ids);
+    }
+
+    termdict_iter_t iter;
+    char **terms = arena_alloc(arena, TERM_EXPANSION_MAX * sizeof(char *));
+    if (terms == NULL || termdict_iter_range(index->dict, &iter, NULL, NULL) != 0) {
+        snprintf(errmsg, LINE_MAX, "Failed to allocate memory for '%s'", token);
+        return -1;
+    }
+
+    size_t n = 0;
+    int status = 0;
+
+    for (size_t i = 0; i < n_candidates; i++) {
+        if (candidates && termdict_iter_seek_pos(&iter, candidates[i]) != 0) {
+            snprintf(errmsg, LINE_MAX, "Failed to look up '%s'", token);
+            status = -1;
+            break;
+        }
+
+        const char *term = termdict_iter_next(&iter, NULL);
+        if (term == NULL || strstr(term, substring) == NULL) {
+            continue;
+        }
+
+        if (n == TERM_EXPANSION_MAX) {
+            snprintf(
+                errmsg,
+                LINE_MAX,
+                "'%s' matches more than %d terms, use a longer substring",
+                token,
+                TERM_EXPANSION_MAX
+            );
+            status = -1;
+            break;
+        }
+
+        terms[n] = arena_strdup(arena, term);
+        if (terms[n] == NULL) {
+            snprintf(errmsg, LINE_MAX, "Failed to allocate memory for '%s'", token);
+            status = -1;
+            break;
+        }
+        n++;
+    }
+
+    termdict_iter_deinit(&iter);
+
+    if (status != 0) {
+        return -1;
+    }
+
+    node->data.expansion.terms = terms;
+    node->data.expansion.n_terms = n;
+    return 0;
+}
+
+static int rec_expand_terms(index_t *index, AST *node, arena_t *arena, char *errmsg) {
+    switch (node->type) {
+        case AST_TERM:
+            return 0;
+        case AST_PREFIX:
+        case AST_FUZZY:
+            return expand_node(index, node, arena, errmsg);
+        case AST_SUBSTRING:
+            return expand_substring(index, node, arena, errmsg);
+        case AST_PHRASE:
+            if (!index->positional) {
+                snprintf(errmsg, LINE_MAX, "Phrase queries need an index with positions (--positions)");
+                return -1;
+            }
+            return 0;
+        default:
+            if (rec_expand_terms(index, node->data.children.left, arena, errmsg) != 0) {
+                return -1;
+            }
+            return rec_expand_terms(index, node->data.children.right, arena, errmsg);
+    }
+}
+
+int index_expand_terms(index_t *index, AST *ast, arena_t *arena, char *errmsg) {
+    if (index == NULL || ast == NULL || arena == NULL || errmsg == NULL) {
+        pr_error("Arguments cannot be NULL\n");
+        return -1;
+    }
+
+    /* terms are enumerated in order from the dictionary, which only exists while frozen */
+    if (index->dict == NULL && index_freeze(index) != 0) {
+        snprintf(errmsg, LINE_MAX, "Failed to build the term dictionary for prefix and fuzzy queries");
+        return -1;
+    }
+
+    return rec_expand_terms(index, ast, arena, errmsg);
+}
+
+/**
+ * A distinct term of a query, bound to everything scoring needs to know about it. Binding happens once per
+ * query, so that scoring never has to look a term up again.
+ */
+typedef struct term_binding {
+    term_t *record; // NULL if the term is not indexed
+    double idf;
+    size_t df;      // number of documents containing the term
+    size_t cursor;  // position in the postings, only ever moves forward
+    uint32_t count; // frequency of the term in the document being scored
+    uint8_t impact; // quantised BM25 impact of the term in the document being scored
+} term_binding_t;
+
+/**
+ * Per-query scoring state. Terms that occur several times in the query share a binding. The leaves of the
+ * program refer to their binding by their number, and scoring runs the program on the scores of the leaves.
+ */
+typedef struct score_query {
+    index_t *index;
+    arena_t *arena; // memory of the query, which the arrays below are allocated from
+    const program_t *program;
+    size_t n_leaves;
+    size_t *leaf_binding; // binding of each leaf of the program
+    size_t n_bindings;
+    term_binding_t *bindings;
+    double *stack;         // stack of scores, as deep as the program needs
+    const double *dequant; // score of each impact level when ranking by BM25, NULL for tf-idf
+} score_query_t;
+
+/* binding phase: resolves each distinct term of the query once. returns 0 on success */
+static int score_query_init(
+    score_query_t *q, index_t *index, const program_t *program, ranking_t ranking, arena_t *arena
+) {
+    if (ranking == RANKING_BM25 && prepare_impacts(index) != 0) {
+        pr_error("Failed to compute BM25 impacts\n");
+        return -1;
+    }
+
+    q->index = index;
+    q->arena = arena;
+    q->program = program;
+    q->dequant = (ranking == RANKING_BM25) ? index->dequant : NULL;
+    q->n_leaves = program->n_leaves;
+    q->n_bindings = 0;
+    q->leaf_binding = arena_alloc(arena, q->n_leaves * sizeof(size_t));
+    q->bindings = arena_alloc(arena, q->n_leaves * sizeof(term_binding_t));
+    q->stack = arena_alloc(arena, program->max_depth * sizeof(double));
+    term_t **records = arena_alloc(arena, q->n_leaves * sizeof(term_t *));
+
+    if (q->leaf_binding == NULL || q->bindings == NULL || q->stack == NULL || records == NULL) {
+        pr_error("Failed to allocate memory for query scoring\n");
+        return -1;
+    }
+
+    /* resolve the terms to their interned records */
+    lookup_terms(index, program->terms, q->n_leaves, records);
+
+    /* interned terms are equal by address, so repeated terms are found by comparing records. Queries are
+        short, so a linear scan of the bindings so far is fine */
+    for (size_t i = 0; i < q->n_leaves; i++) {
+        size_t b = 0;
+        while (b < q->n_bindings && q->bindings[b].record != records[i]) {
+            b++;
+        }
+
+        if (b == q->n_bindings) {
+            term_binding_t *binding = &q->bindings[q->n_bindings++];
+            binding->record = records[i];
+            binding->df = records[i] ? records[i]->postings.len : 0;
+
+            /* get the IDF of the term, computed once per generation of the index */
+            binding->idf = records[i] ? term_idf(index, records[i]) : 0.0;
+            binding->cursor = 0;
+            binding->count = 0;
+            binding->impact = 0;
+        }
+        q->leaf_binding[i] = b;
+    }
+
+    return 0;
+}
+
+/* runs the program of the query on the scores of its leaves, summing the score of those that count towards it.
+    For tf-idf, `norm` is the documents precomputed 1 / (number of terms). BM25 impacts are already normalised */
+static double run_score(score_query_t *q, double norm) {
+    const program_t *program = q->program;
+    double *stack = q->stack;
+    size_t sp = 0;
+
+    for (size_t pc = 0; pc < program->n_code; pc++) {
+        const instr_t *instr = &program->code[pc];
+
+        switch (instr->op) {
+            case OP_AND:
+            case OP_OR:
+                sp--;
+                stack[sp - 1] += stack[sp];
+                break;
+
+            case OP_ANDNOT:
+                sp--; // the right side does not count towards the score
+                break;
+
+            default: {
+                /* a prefix, fuzzy term or substring scores as the OR of the terms it expanded to. A phrase is only
+                   matched by documents with all of its terms, so that is their sum as well */
+                double result = 0.0;
+                for (size_t leaf = instr->leaf; leaf < instr->leaf + instr->n_leaves; leaf++) {
+                    term_binding_t *binding = &q->bindings[q->leaf_binding[leaf]];
+                    if (binding->count == 0) {
+                        continue;
+                    }
+
+                    /* -- BM25 -- */
+                    if (q->dequant) {
+                        result += q->dequant[binding->impact];
+                        continue;
+                    }
+
+                    /* -- TF -- */
+                    double tf = (double) binding->count * norm;
+
+                    /* -- TF-IDF -- */
+                    result += tf * binding->idf;
+                }
+                stack[sp++] = result;
+                break;
+            }
+        }
+    }
+
+    return stack[0];
+}
+
+/**
+ * Score the next candidate document. Candidates must be given in increasing ID order: each term walks its
+ * postings alongside them, skipping ahead to the candidate instead of looking it up.
+ */
+static double score_next_document(score_query_t *q, doc_id_t doc_id) {
+    for (size_t b = 0; b < q->n_bindings; b++) {
+        term_binding_t *binding = &q->bindings[b];
+        binding->count = 0;
+        binding->impact = 0;
+
+        if (binding->record == NULL) {
+            continue;
+        }
+
+        const postings_t *postings = &binding->record->postings;
+        binding->cursor = postings_seek(postings, binding->cursor, doc_id);
+        if (binding->cursor < postings->len && postings_docs(postings)[binding->cursor] == doc_id) {
+            binding->count = postings_freqs(postings)[binding->cursor];
+            if (q->dequant) {
+                binding->impact = postings->impacts[binding->cursor];
+            }
+        }
+    }
+
+    return run_score(q, q->index->docs.norm[doc_id]);
+}
+
+/* calculates the TF-IDF of the query for the given document
+with help from https://en.wikipedia.org/wiki/Tf%E2%80%93idf and
+https://www.geeksforgeeks.org/understanding-tf-idf-term-frequency-inverse-document-frequency/ */
+double calculate_tfidf(index_t *index, AST *ast, doc_id_t doc_id) {
+
+    if (ast == NULL) {
+        pr_error("AST node is NULL\n");
+        return 0.0;
+    }
+
+    if (doc_id >= index->n_docs) {
+        return 0.0;
+    }
+
+    /* not part of a query, so this cannot use the memory of one, nor a cached program: those are looked up by
+        the tokens of a query, not by its ast */
+    program_t *program = program_compile(ast, index);
+    arena_t *arena = arena_create();
+    score_query_t q;
+    if (program == NULL || arena == NULL || score_query_init(&q, index, program, RANKING_TFIDF, arena) != 0) {
+        program_destroy(program);
+        arena_destroy(arena);
+        return 0.0;
+    }
+
+    /* a single document is looked up in the forward index, rather than searching every postings list */
+    for (size_t b = 0; b < q.n_bindings; b++) {
+        term_binding_t *binding = &q.bindings[b];
+        binding->count = binding->record ? fwd_lookup(index, doc_id, binding->record->id) : 0;
+    }
+
+    double tfidf_score = run_score(&q, index->docs.norm[doc_id]);
+
+    arena_destroy(arena);
+    program_destroy(program);
+    return tfidf_score;
+}
+
+
+/* Anytime evaluation */
+
+static int compare_doc_id_values(const void *a, const void *b) {
+    return compare_doc_ids(*(const doc_id_t *) a, *(const doc_id_t *) b);
+}
+
+static inline void swap_doc_ids(doc_id_t *a, doc_id_t *b) {
+    doc_id_t tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+/**
+ * Reorder `docs` so that the `k` with the highest accumulated impact come first, in no particular order. `k`
+ * must be less than `n`. This is a quickselect with a three way partition, as quantised scores tie a lot.
+ */
+static void select_top(doc_id_t *docs, size_t n, size_t k, const double *acc) {
+    size_t lo = 0;
+    size_t hi = n;
+
+    while (hi - lo > 1) {
+        double pivot = acc[docs[lo + (hi - lo) / 2]];
+
+        /* [lo, gt) is above the pivot, [gt, i) equal to it and [lt, hi) below it */
+        size_t gt = lo;
+        size_t i = lo;
+        size_t lt = hi;
+        while (i < lt) {
+            double score = acc[docs[i]];
+            if (score > pivot) {
+                swap_doc_ids(&docs[gt++], &docs[i++]);
+            } else if (score < pivot) {
+                swap_doc_ids(&docs[i], &docs[--lt]);
+            } else {
+                i++;
             }
-            uint32_t *raw_term_count = term_count_ptr;
+        }
+
+        if (k < gt) {
+            hi = gt;
+        } else if (k <= lt) {
+            return; // the k-th document is among those equal to the pivot
+        } else {
+            lo = lt;
+        }
+    }
+}
+
+/**
+ * Find the (at most) `index->topk` best documents for a disjunction, accumulating the impacts of its terms
+ * score-at-a-time: every posting of the highest impact level first, across all the terms, then the next level,
+ * and so on. After each level, no document can gain more than the next impact of every term. Once the k-th
+ * best document is at least that far ahead of the best one outside the top k, the top k cannot change, and
+ * the evaluation stops. It also stops once the work budget is spent.
+ *
+ * `out_docs` is set to the found documents in increasing order, allocated from the memory of the query, and
+ * `out_n` to their number. returns 0 on success
+ */
+static int anytime_topk(score_query_t *q, doc_id_t **out_docs, size_t *out_n) {
+    index_t *index = q->index;
+    size_t k = index->topk;
+
+    *out_docs = NULL;
+    *out_n = 0;
+    if (index->n_docs == 0) {
+        return 0;
+    }
+
+    /* the accumulated impact of each document, the documents that have one, and the position in the postings
+        of each term */
+    double *acc = arena_calloc(q->arena, index->n_docs, sizeof(double));
+    doc_id_t *touched = arena_alloc(q->arena, index->n_docs * sizeof(doc_id_t));
+    size_t *heads = arena_calloc(q->arena, q->n_bindings, sizeof(size_t));
 
-            
-            tf = (double)*raw_term_count / (double)*total_doc_term_count;
+    if (acc == NULL || touched == NULL || heads == NULL) {
+        pr_error("Failed to allocate memory for anytime evaluation\n");
+        return -1;
+    }
 
+    const double *dequant = index->dequant;
+    size_t n_touched = 0;
+    size_t work = 0;
 
-            /* -- IDF / DF -- */
+    for (int level = IMPACT_LEVELS - 1; level > 0; level--) {
+        for (size_t b = 0; b < q->n_bindings; b++) {
+            term_t *record = q->bindings[b].record;
+            if (record == NULL) {
+                continue;
+            }
 
-            /* get the x term entry from the main term map */
-            entry_t *term_entry = map_get(index->terms, ast->data.term);
-            if (term_entry == NULL) {
-                return 0;
+            const postings_t *postings = &record->postings;
+            size_t i = heads[b];
+            while (i < postings->len && postings->impact_levels[i] == level) {
+                doc_id_t doc_id = postings->impact_docs[i++];
+                if (acc[doc_id] == 0.0) {
+                    touched[n_touched++] = doc_id;
+                }
+                acc[doc_id] += dequant[level];
             }
-            /* get the total number of documents in the index */
-            size_t N = index->n_docs;
 
-            /* get all the documents containing x term */
-            set_t *doc_term = term_entry->val;
-            if (doc_term == NULL) {
-                return 0;
+            work += i - heads[b];
+            heads[b] = i;
+        }
+
+        if (index->topk_budget && work >= index->topk_budget) {
+            break;
+        }
+
+        /* the most any document can still gain */
+        double remaining = 0.0;
+        bool done = true;
+        for (size_t b = 0; b < q->n_bindings; b++) {
+            term_t *record = q->bindings[b].record;
+            if (record && heads[b] < record->postings.len) {
+                remaining += dequant[record->postings.impact_levels[heads[b]]];
+                done = false;
             }
+        }
 
-            /* get the number of documents in the set */
-            size_t Df = set_length(doc_term);
-            
+        if (done) {
+            break; // every posting is processed
+        }
 
-            double idf = 0;
+        /* with fewer than k documents found, any unseen document may still make it */
+        if (n_touched < k) {
+            continue;
+        }
 
-            /* calculate the IDF for one term */
-            idf = log((double)N / (double)Df);
-            
+        if (n_touched > k) {
+            select_top(touched, n_touched, k, acc);
+        }
 
+        double kth = HUGE_VAL;
+        for (size_t i = 0; i < k; i++) {
+            kth = (acc[touched[i]] < kth) ? acc[touched[i]] : kth;
+        }
 
-            /* -- TF-IDF -- */
+        /* unseen documents are outside the top k as well, so the best one outside starts at 0 */
+        double best_outside = 0.0;
+        for (size_t i = k; i < n_touched; i++) {
+            best_outside = (acc[touched[i]] > best_outside) ? acc[touched[i]] : best_outside;
+        }
 
-            /* calculate the TF-IDF for one term */
-            tfidf_score = tf * idf;
+        if (kth >= best_outside + remaining) {
             break;
         }
+    }
+
+    size_t n_top = (n_touched < k) ? n_touched : k;
+    if (n_touched > k) {
+        select_top(touched, n_touched, k, acc);
+    }
 
-        case AST_AND: {
-            double left_result = calculate_tfidf(index, ast->data.children.left, doc_name);
-            double right_result = calculate_tfidf(index, ast->data.children.right, doc_name);
+    /* scoring walks the documents in ID order */
+    qsort(touched, n_top, sizeof(doc_id_t), compare_doc_id_values);
 
-            tfidf_score = left_result + right_result;
-            break;
+    *out_docs = touched;
+    *out_n = n_top;
+    return 0;
+}
+
+
+/* Statistics */
+
+static void print_map_stats(FILE *f, const char *name, map_stats_t *stats, size_t n_maps) {
+    if (n_maps > 1) {
+        fprintf(f, "%s (sum over a sample of %zu maps)\n", name, n_maps);
+    } else {
+        fprintf(f, "%s\n", name);
+    }
+
+    fprintf(
+        f,
+        "  entries: %zu, buckets: %zu, load factor: %.3f, longest chain: %zu\n",
+        stats->length,
+        stats->capacity,
+        stats->load_factor,
+        stats->max_chain
+    );
+
+    fprintf(f, "  chain lengths:");
+    for (size_t i = 0; i < MAP_STATS_HIST_LEN; i++) {
+        const char *more = (i == MAP_STATS_HIST_LEN - 1) ? "+" : "";
+        fprintf(f, " [%zu%s]: %zu", i, more, stats->chain_hist[i]);
+    }
+    fprintf(f, "\n");
+
+    fprintf(
+        f,
+        "  resizes: %zu (%.6fs), memory: %.1f KiB\n",
+        stats->n_resizes,
+        stats->resize_secs,
+        (double) stats->bytes / 1024.0
+    );
+}
+
+void index_print_stats(index_t *index, FILE *f) {
+    if (index == NULL || f == NULL) {
+        pr_error("Arguments cannot be NULL\n");
+        return;
+    }
+
+    if (index->dict) {
+        fprintf(f, "term dictionary (frozen, front coded in blocks of %d)\n", TERMDICT_BLOCK_SIZE);
+        fprintf(
+            f,
+            "  terms: %zu, memory: %.1f KiB (%.1f KiB of terms)\n",
+            termdict_length(index->dict),
+            (double) termdict_bytes(index->dict) / 1024.0,
+            (double) termdict_raw_bytes(index->dict) / 1024.0
+        );
+        if (index->completions) {
+            fprintf(
+                f,
+                "  completions: top %d of %zu prefixes cached, memory: %.1f KiB\n",
+                COMPLETIONS_K,
+                completions_nodes(index->completions),
+                (double) completions_bytes(index->completions) / 1024.0
+            );
         }
+        if (index->mph) {
+            fprintf(
+                f,
+                "  perfect hash: %.1f KiB (%.2f bits per term), %zu levels, %zu bit fingerprints\n",
+                (double) mph_bytes(index) / 1024.0,
+                index->n_terms ? 8.0 * (double) mphf_bytes(index->mph) / (double) index->n_terms : 0.0,
+                mphf_levels(index->mph),
+                8 * sizeof(uint32_t)
+            );
+        }
+    } else {
+        map_stats_t stats;
 
-        case AST_OR: {
-            double left_result = calculate_tfidf(index, ast->data.children.left, doc_name);
-            double right_result = calculate_tfidf(index, ast->data.children.right, doc_name);
+        strmap_stats(index->terms, &stats);
+        print_map_stats(f, "terms", &stats, 1);
+    }
 
-            tfidf_score = left_result + right_result;
-            break;
+    /* every column holds one value per document */
+    size_t row_size = 2 * sizeof(uint32_t) + 2 * sizeof(double) + 2 * sizeof(size_t);
+
+    fprintf(f, "document table\n");
+    fprintf(
+        f,
+        "  rows: %zu, capacity: %zu, memory: %.1f KiB (+ %.1f KiB of names)\n",
+        index->n_docs,
+        index->docs.capacity,
+        (double) (index->docs.capacity * row_size) / 1024.0,
+        (double) index->docs.names_capacity / 1024.0
+    );
+
+    fprintf(f, "forward index\n");
+    fprintf(
+        f,
+        "  pairs: %zu (%.1f per document), capacity: %zu, memory: %.1f KiB\n",
+        index->fwd_len,
+        index->n_docs ? (double) index->fwd_len / (double) index->n_docs : 0.0,
+        index->fwd_capacity,
+        (double) (index->fwd_capacity * sizeof(fwd_posting_t)) / 1024.0
+    );
+
+    /* sum up the postings of every term */
+    size_t n_postings = 0;
+    size_t n_inline = 0;
+    size_t longest = 0;
+    size_t postings_bytes_total = 0;
+
+    for (size_t term_id = 0; term_id < index->n_terms; term_id++) {
+        term_t *record = index->records[term_id];
+
+        n_postings += record->postings.len;
+        n_inline += postings_is_inline(&record->postings);
+        postings_bytes_total += postings_bytes(&record->postings);
+        if (record->postings.len > longest) {
+            longest = record->postings.len;
         }
+    }
 
-        case AST_ANDNOT: {
-            tfidf_score = calculate_tfidf(index, ast->data.children.left, doc_name);
-            break;
+    fprintf(f, "postings\n");
+    fprintf(
+        f,
+        "  entries: %zu (%.1f per term), longest: %zu, memory: %.1f KiB\n",
+        n_postings,
+        index->n_terms ? (double) n_postings / (double) index->n_terms : 0.0,
+        longest,
+        (double) postings_bytes_total / 1024.0
+    );
+    fprintf(f, "  stored inline (up to %zu documents): %zu lists\n", POSTINGS_INLINE_CAPACITY, n_inline);
+
+    if (index->trigrams) {
+        fprintf(f, "trigrams\n");
+        fprintf(
+            f,
+            "  distinct: %zu, memory: %.1f KiB (+ %.1f KiB mapping terms to the dictionary)\n",
+            trigrams_length(index->trigrams),
+            (double) trigrams_bytes(index->trigrams) / 1024.0,
+            index->term_ranks ? (double) (index->n_terms * sizeof(uint32_t)) / 1024.0 : 0.0
+        );
+    }
+
+    if (index->positional) {
+        size_t positions_bytes_total = 0;
+        for (size_t term_id = 0; term_id < index->n_terms; term_id++) {
+            positions_bytes_total += positions_bytes(&index->positions[term_id]);
+        }
+
+        /* stop words are not terms, and are counted on their own */
+        size_t stop_bytes = 0;
+        size_t n_stop_postings = 0;
+        for (size_t i = 0; i < stop_words_count(); i++) {
+            stop_bytes += positions_bytes(&index->stop_positions[i]);
+            stop_bytes += postings_bytes(&index->stop_records[i].postings);
+            n_stop_postings += index->stop_records[i].postings.len;
+        }
+
+        fprintf(f, "positions (delta encoded varints)\n");
+        fprintf(
+            f,
+            "  memory: %.1f KiB (%.2f bytes per posting)\n",
+            (double) positions_bytes_total / 1024.0,
+            n_postings ? (double) positions_bytes_total / (double) n_postings : 0.0
+        );
+        fprintf(
+            f,
+            "  stop words, for phrases: %.1f KiB, with their postings (%zu entries)\n",
+            (double) stop_bytes / 1024.0,
+            n_stop_postings
+        );
+    }
+
+    if (index->programs) {
+        fprintf(f, "query programs\n");
+        fprintf(
+            f,
+            "  cached: %zu (at most %d), hits: %zu, misses: %zu\n",
+            strmap_length(index->programs),
+            PROGRAM_CACHE_MAX,
+            index->programs_hits,
+            index->programs_misses
+        );
+    }
+
+    /* the arena only allocates when a query needs more memory than any before it */
+    fprintf(f, "query memory\n");
+    fprintf(
+        f,
+        "  arena: %.1f KiB, after %zu queries. phrase positions: %.1f KiB\n",
+        (double) arena_bytes(index->query_arena) / 1024.0,
+        index->n_queries,
+        (double) (index->phrase_capacity * sizeof(uint32_t)) / 1024.0
+    );
+
+    if (index->ranking == RANKING_BM25) {
+        fprintf(f, "ranking: bm25 (k1 = %.2f, b = %.2f), ", index->bm25_k1, index->bm25_b);
+        fprintf(f, "impacts %s\n", (index->impacts_generation == index->generation) ? "computed" : "pending");
+    } else {
+        fprintf(f, "ranking: tf-idf\n");
+    }
+
+    if (index->topk) {
+        fprintf(f, "anytime top-k: k = %zu, budget: ", index->topk);
+        if (index->topk_budget) {
+            fprintf(f, "%zu postings\n", index->topk_budget);
+        } else {
+            fprintf(f, "none\n");
+        }
+    }
+}
+
+
+/* Query programs */
+
+/* joins the tokens of a query with spaces, to cache its program by. The key is allocated from `arena`, and so
+    are the tokens it is joined from, since an iterator over them would be allocated from the heap.
+    returns NULL on failure */
+static char *query_key(list_t *query_tokens, arena_t *arena) {
+    size_t n_tokens = list_length(query_tokens);
+    char **tokens = arena_alloc(arena, (n_tokens + 1) * sizeof(char *));
+    if (tokens == NULL) {
+        return NULL;
+    }
+    n_tokens = list_toarray(query_tokens, (void **) tokens, n_tokens);
+
+    size_t size = 1;
+    for (size_t i = 0; i < n_tokens; i++) {
+        size += strlen(tokens[i]) + 1;
+    }
+
+    char *key = arena_alloc(arena, size);
+    if (key == NULL) {
+        return NULL;
+    }
+
+    size_t len = 0;
+    for (size_t i = 0; i < n_tokens; i++) {
+        if (len > 0) {
+            key[len++] = ' ';
+        }
+        memcpy(&key[len], tokens[i], strlen(tokens[i]));
+        len += strlen(tokens[i]);
+    }
+    key[len] = '\0';
+
+    return key;
+}
+
+/* the cached program of a query, or NULL if there is none. Programs from an earlier generation are dropped */
+static program_t *cached_program(index_t *index, char *key) {
+    if (index->programs && index->programs_generation != index->generation) {
+        strmap_destroy(index->programs, program_entry_destroy);
+        index->programs = NULL;
+    }
+
+    strmap_entry_t *entry = (index->programs && key) ? strmap_get(index->programs, key) : NULL;
+    if (entry == NULL) {
+        index->programs_misses += 1;
+        return NULL;
+    }
+
+    index->programs_hits += 1;
+    return entry->val;
+}
+
+/* caches the program of a query, which then owns it and a copy of the key. A full cache is emptied first,
+    rather than keeping track of which programs were used last. returns 0 on success, otherwise the program
+    is not cached, and still belongs to the caller */
+static int cache_program(index_t *index, const char *key, program_t *program) {
+    if (key == NULL) {
+        return -1;
+    }
+
+    if (index->programs && strmap_length(index->programs) >= PROGRAM_CACHE_MAX) {
+        strmap_destroy(index->programs, program_entry_destroy);
+        index->programs = NULL;
+    }
+
+    if (index->programs == NULL) {
+        index->programs = strmap_create();
+        if (index->programs == NULL) {
+            return -1;
+        }
+        index->programs_generation = index->generation;
+    }
+
+    /* the key outlives the query it is from */
+    char *owned_key = strdup(key);
+    if (owned_key == NULL) {
+        return -1;
+    }
+
+    int inserted;
+    strmap_entry_t *entry = strmap_put(index->programs, owned_key, &inserted); // panics rather than fail
+    entry->val = program;
+    return 0;
+}
+
+/* parses, expands and compiles a query. The ast only lives in the memory of the query, the program does not.
+    returns the program, or NULL on failure with `errmsg` set */
+static program_t *compile_query(index_t *index, list_t *query_tokens, char *errmsg) {
+    /* parse the query tokens into the ast */
+    list_iter_t *tokens_iter = list_createiter(query_tokens);
+    if (tokens_iter == NULL) {
+        snprintf(errmsg, LINE_MAX, "Failed to create iterator for query tokens");
+        return NULL;
+    }
+
+    /* parse the expression */
+    AST *ast = parse_expression(tokens_iter, index->query_arena, errmsg);
+    list_destroyiter(tokens_iter);
+    if (ast == NULL) {
+        if (errmsg[0] == '\0') {
+            snprintf(errmsg, LINE_MAX, "Failed to parse query expression");
+        }
+        return NULL;
+    }
+
+    /* prefixes and fuzzy terms are replaced by the terms they match before anything is looked up */
+    if (index_expand_terms(index, ast, index->query_arena, errmsg) != 0) {
+        return NULL;
+    }
+
+    program_t *program = program_compile(ast, index);
+    if (program == NULL) {
+        snprintf(errmsg, LINE_MAX, "Failed to compile the query");
+    }
+
+    return program;
+}
+
+
+/* a matching document and its score, before it is sorted into the results */
+typedef struct ranked_doc {
+    double score;
+    doc_id_t doc_id;
+} ranked_doc_t;
+
+/* sorts documents by decreasing score with a bottom-up merge sort, which keeps equal scores in the order they
+    came in. `qsort` may allocate its own buffer, so this merges back and forth with `tmp`, of `n` documents.
+    returns the array that ended up sorted, either `docs` or `tmp` */
+static ranked_doc_t *sort_ranked_docs(ranked_doc_t *docs, ranked_doc_t *tmp, size_t n) {
+    ranked_doc_t *from = docs;
+    ranked_doc_t *to = tmp;
+
+    for (size_t width = 1; width < n; width *= 2) {
+        for (size_t lo = 0; lo < n; lo += 2 * width) {
+            size_t mid = (lo + width < n) ? lo + width : n;
+            size_t hi = (lo + 2 * width < n) ? lo + 2 * width : n;
+            size_t i = lo, j = mid, k = lo;
+
+            while (i < mid && j < hi) {
+                to[k++] = (from[j].score > from[i].score) ? from[j++] : from[i++];
+            }
+            while (i < mid) {
+                to[k++] = from[i++];
+            }
+            while (j < hi) {
+                to[k++] = from[j++];
+            }
         }
+
+        ranked_doc_t *swap = from;
+        from = to;
+        to = swap;
+    }
+
+    return from;
+}
+
+/* got some help from ai with this */
+
+query_result_t *index_query_into(index_t *index, list_t *query_tokens, size_t *n_results, char *errmsg) {
     
-        default:
-            pr_error("Unknown AST type\n");
-            tfidf_score = 0;
+    if (index == NULL || query_tokens == NULL || n_results == NULL) {
+        pr_error("Arguments cannot be NULL\n");
+        return NULL;
+    }
+
+    /* the results of the previous query have been consumed by now, so its memory is reused for this one */
+    arena_reset(index->query_arena);
+    index->n_queries += 1;
+
+    /* a query that was asked before (in this generation of the index) is already compiled */
+    char *key = query_key(query_tokens, index->query_arena);
+    program_t *program = cached_program(index, key);
+    bool cached = (program != NULL);
+
+    if (program == NULL) {
+        program = compile_query(index, query_tokens, errmsg);
+        if (program == NULL) {
+            return NULL;
+        }
+        cached = (cache_program(index, key, program) == 0);
+    }
+
+    score_query_t q;
+    if (score_query_init(&q, index, program, index->ranking, index->query_arena) != 0) {
+        snprintf(errmsg, LINE_MAX, "Failed to allocate memory for scoring");
+        if (!cached) {
+            program_destroy(program);
+        }
+        return NULL;
+    }
+
+    /* get a cursor over the matching documents. Disjunctions may only need the best of them, see
+        index_set_topk, which are walked like any other sorted array */
+    cursor_t *root;
+    cursor_t top_cursor;
+    doc_id_t *top_docs = NULL;
+    int status;
+
+    if (index->topk && program_is_disjunction(program)) {
+        size_t n_top = 0;
+        status = (prepare_impacts(index) == 0) ? anytime_topk(&q, &top_docs, &n_top) : -1;
+        cursor_init_docs(&top_cursor, top_docs, n_top);
+        root = &top_cursor;
+    } else {
+        /* walk the program a document at a time, without building the set of matching documents */
+        status = program_open(program, index, &index->query_scratch, &root, errmsg);
+    }
+
+    query_result_t *results = NULL;
+    if (status != 0) {
+        if (errmsg[0] == '\0') {
+            snprintf(errmsg, LINE_MAX, "Failed to get result set");
+        }
+        goto cleanup;
+    }
+
+    /* score each document as the cursor gets to it, in increasing ID order. The array doubles in the memory of
+        the query, which grows to fit the largest result of any query, and is then reused */
+    size_t capacity = RESULTS_INITIAL_CAPACITY;
+    size_t n = 0;
+    ranked_doc_t *ranked = arena_alloc(index->query_arena, capacity * sizeof(ranked_doc_t));
+    if (ranked == NULL) {
+        snprintf(errmsg, LINE_MAX, "Failed to allocate memory for query results");
+        goto cleanup;
+    }
+
+    for (doc_id_t doc_id = cursor_doc(root); doc_id != CURSOR_END; doc_id = cursor_next(root)) {
+        if (n == capacity) {
+            ranked_doc_t *grown = arena_alloc(index->query_arena, 2 * capacity * sizeof(ranked_doc_t));
+            if (grown == NULL) {
+                snprintf(errmsg, LINE_MAX, "Failed to allocate memory for query results");
+                goto cleanup;
+            }
+            memcpy(grown, ranked, n * sizeof(ranked_doc_t));
+            ranked = grown;
+            capacity *= 2;
+        }
+        ranked[n].doc_id = doc_id;
+        ranked[n].score = score_next_document(&q, doc_id);
+        n++;
+    }
+
+    /* sort by score, and equal scores by ID, the order they were found in */
+    ranked_doc_t *tmp = arena_alloc(index->query_arena, (n + 1) * sizeof(ranked_doc_t));
+    if (tmp == NULL) {
+        snprintf(errmsg, LINE_MAX, "Failed to allocate memory for query results");
+        goto cleanup;
+    }
+    ranked = sort_ranked_docs(ranked, tmp, n);
+
+    /* then the results, with their document names, in the memory of the query */
+    query_result_t *sorted = arena_alloc(index->query_arena, (n + 1) * sizeof(query_result_t));
+    if (sorted == NULL) {
+        snprintf(errmsg, LINE_MAX, "Failed to allocate memory for query results");
+        goto cleanup;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        const char *doc_name = &index->docs.names[index->docs.name_offset[ranked[i].doc_id]];
+        sorted[i].doc_name = arena_strdup(index->query_arena, doc_name);
+        sorted[i].score = ranked[i].score;
+        sorted[i].term_frequency = NULL; // see query_result_t
+        if (sorted[i].doc_name == NULL) {
+            snprintf(errmsg, LINE_MAX, "Failed to duplicate document name");
+            goto cleanup;
+        }
+    }
+
+    results = sorted;
+    *n_results = n;
+
+cleanup:
+    if (!cached) {
+        program_destroy(program);
+    }
+    return results;
+}
+
+list_t *index_query(index_t *index, list_t *query_tokens, char *errmsg) {
+    size_t n_results;
+    query_result_t *results = index_query_into(index, query_tokens, &n_results, errmsg);
+    if (results == NULL) {
+        return NULL;
+    }
+
+    /* the results are already sorted, so they are only linked up in order */
+    list_t *result_list = list_create((cmp_fn) compare_results_by_score);
+    if (result_list == NULL) {
+        snprintf(errmsg, LINE_MAX, "Failed to create result list");
+        return NULL;
+    }
+
+    for (size_t i = 0; i < n_results; i++) {
+        if (list_addlast(result_list, &results[i]) < 0) {
+            snprintf(errmsg, LINE_MAX, "Failed to add result to list");
+            list_destroy(result_list, NULL);
+            return NULL;
+        }
+    }
+
+    return result_list;
+}
+
+int index_complete(index_t *index, const char *prefix, completion_t *out, size_t *n_out) {
+    if (index == NULL || prefix == NULL || out == NULL || n_out == NULL) {
+        pr_error("Arguments cannot be NULL\n");
+        return -1;
+    }
+    *n_out = 0;
+
+    /* the completions are computed along with the dictionary */
+    if (index->dict == NULL && index_freeze(index) != 0) {
+        pr_error("Failed to freeze the index\n");
+        return -1;
+    }
+    if (index->completions == NULL) {
+        pr_error("The index has no completions\n");
+        return -1;
+    }
+
+    size_t lo, hi;
+    if (termdict_prefix_range(index->dict, prefix, &lo, &hi) != 0) {
+        return -1;
+    }
+
+    uint32_t top[COMPLETIONS_K];
+    size_t n = completions_top(index->completions, lo, hi, top);
+
+    /* decode the terms in a single pass over the dictionary, in the order they are stored in */
+    size_t order[COMPLETIONS_K];
+    for (size_t i = 0; i < n; i++) {
+        size_t j = i;
+        while (j > 0 && top[order[j - 1]] > top[i]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    termdict_iter_t iter;
+    if (termdict_iter_range(index->dict, &iter, NULL, NULL) != 0) {
+        return -1;
+    }
+
+    int status = 0;
+    size_t n_decoded = 0;
+
+    for (; n_decoded < n; n_decoded++) {
+        completion_t *completion = &out[order[n_decoded]];
+        uint32_t term_id;
+
+        const char *term = (termdict_iter_seek_pos(&iter, top[order[n_decoded]]) == 0)
+            ? termdict_iter_next(&iter, &term_id)
+            : NULL;
+        completion->term = term ? strdup(term) : NULL;
+        if (completion->term == NULL) {
+            pr_error("Failed to decode completion\n");
+            status = -1;
             break;
+        }
+        completion->doc_frequency = index->records[term_id]->postings.len;
     }
+    termdict_iter_deinit(&iter);
 
-    return tfidf_score;
+    if (status != 0) {
+        for (size_t i = 0; i < n_decoded; i++) {
+            free(out[order[i]].term);
+        }
+        return -1;
+    }
+
+    *n_out = n;
+    return 0;
+}
+
+void index_stat(index_t *index, size_t *n_docs, size_t *n_terms) {
+    if (index == NULL || n_docs == NULL || n_terms == NULL) {
+        pr_error("Arguments cannot be NULL\n");
+        return;
+    }
+
+    /* get the number of documents and terms in the index */
+    *n_docs = index->n_docs;
+    *n_terms = index->n_terms;
 
+    /* print the number of documents and terms - from autocomplete */
+    pr_info("Number of documents: %zu\n", *n_docs);
+    pr_info("Number of terms: %zu\n", *n_terms);
 
 }
 
@@ -590,17 +2631,17 @@ const char *stop_words[] = { /* got help from autocomplete with the words - but
 /* inspired from https://www.geeksforgeeks.org/binary-search-a-string/
     could probably be done differently, but for this implementation its fine
     
-    returns true if a stop word was found, false if it wasnt */
-bool stop_word(const char *term) {
+    returns the place of the stop word in `stop_words` if it was found, -1 if it wasnt */
+static int stop_word_id(const char *term) {
     int left = 0;
-    int right = sizeof(stop_words) / sizeof(stop_words[0]) - 2;
+    int right = (int) stop_words_count() - 1;
 
     while (left <= right) {
         int mid = left + (right - left) / 2;
 
         int cmp = strcmp(term, stop_words[mid]);
         if (cmp == 0) {
-            return true; 
+            return mid; 
         } else if (cmp > 0) {
             left = mid + 1; 
         } else {
@@ -608,5 +2649,13 @@ bool stop_word(const char *term) {
         }
     }
 
-    return false;
+    return -1;
+}
+
+bool stop_word(const char *term) {
+    return stop_word_id(term) >= 0;
+}
+
+static size_t stop_words_count(void) {
+    return sizeof(stop_words) / sizeof(stop_words[0]) - 1;
 }
\ No newline at end of file
@@ -0,0 +1,110 @@
+/**
+ * @implements levenshtein.h
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "levenshtein.h"
+#include "printing.h"
+
+struct levenshtein {
+    char *term;
+    size_t len;
+    uint8_t max_edits;
+};
+
+
+levenshtein_t *levenshtein_create(const char *term, unsigned max_edits) {
+    if (max_edits > LEVENSHTEIN_MAX_EDITS) {
+        pr_error("Edit distance %u is above the maximum of %d\n", max_edits, LEVENSHTEIN_MAX_EDITS);
+        return NULL;
+    }
+
+    levenshtein_t *lev = malloc(sizeof(levenshtein_t));
+    if (lev == NULL) {
+        pr_error("Failed to allocate memory for levenshtein automaton\n");
+        return NULL;
+    }
+
+    lev->term = strdup(term);
+    if (lev->term == NULL) {
+        pr_error("Failed to allocate memory for levenshtein automaton\n");
+        free(lev);
+        return NULL;
+    }
+
+    lev->len = strlen(term);
+    lev->max_edits = (uint8_t) max_edits;
+    return lev;
+}
+
+void levenshtein_destroy(levenshtein_t *lev) {
+    if (lev == NULL) {
+        return;
+    }
+
+    free(lev->term);
+    free(lev);
+}
+
+size_t levenshtein_state_size(const levenshtein_t *lev) {
+    return lev->len + 1;
+}
+
+void levenshtein_start(const levenshtein_t *lev, uint8_t *state) {
+    /* the empty string is j deletions away from the first j characters of the term */
+    for (size_t j = 0; j <= lev->len; j++) {
+        state[j] = (j <= lev->max_edits) ? (uint8_t) j : lev->max_edits + 1;
+    }
+}
+
+bool levenshtein_step(const levenshtein_t *lev, const uint8_t *state, char c, uint8_t *next) {
+    /* distances above the maximum are all the same to the automaton, so they are capped at max + 1. This keeps
+        them in a byte, whatever the length of the strings */
+    uint8_t cap = lev->max_edits + 1;
+    bool alive = false;
+
+    next[0] = (state[0] < cap) ? state[0] + 1 : cap;
+    alive |= next[0] < cap;
+
+    for (size_t j = 1; j <= lev->len; j++) {
+        uint8_t substitute = state[j - 1] + (lev->term[j - 1] != c);
+        uint8_t insert = state[j] + 1;
+        uint8_t delete = next[j - 1] + 1;
+
+        uint8_t best = (substitute < insert) ? substitute : insert;
+        best = (delete < best) ? delete : best;
+        next[j] = (best < cap) ? best : cap;
+        alive |= next[j] < cap;
+    }
+
+    return alive;
+}
+
+int levenshtein_next_char(const levenshtein_t *lev, const uint8_t *state, uint8_t c, uint8_t *scratch) {
+    int best = -1;
+
+    /* characters of the term */
+    for (size_t j = 0; j < lev->len; j++) {
+        uint8_t t = (uint8_t) lev->term[j];
+        if (t > c && (best < 0 || t < best) && levenshtein_step(lev, state, (char) t, scratch)) {
+            best = t;
+        }
+    }
+
+    /* the first character after `c` that is not in the term stands in for all of them */
+    int other = c + 1;
+    while (other <= UINT8_MAX && memchr(lev->term, other, lev->len) != NULL) {
+        other++;
+    }
+    if (other <= UINT8_MAX && (best < 0 || other < best) && levenshtein_step(lev, state, (char) other, scratch)) {
+        best = other;
+    }
+
+    return best;
+}
+
+bool levenshtein_accepts(const levenshtein_t *lev, const uint8_t *state) {
+    return state[lev->len] <= lev->max_edits;
+}
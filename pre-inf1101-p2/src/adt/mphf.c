@@ -0,0 +1,201 @@
+/**
+ * @implements mphf.h
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mphf.h"
+#include "printing.h"
+
+/**
+ * Bits per remaining hash in each level. Higher values let more hashes settle in the first levels, making
+ * lookups faster at the cost of memory. 2 settles ~60% of the hashes per level, for ~3.3 bits per hash, plus
+ * ~1.7 for the rank tables.
+ */
+#define MPHF_GAMMA 2
+
+/**
+ * Maximum number of levels. Hashes still colliding after this many levels are stored in a sorted fallback
+ * array instead, which for any realistic input stays empty.
+ */
+#define MPHF_MAX_LEVELS 32
+
+struct mphf {
+    size_t n;
+    size_t n_levels;
+    size_t level_start[MPHF_MAX_LEVELS]; // first bit of each level
+    size_t level_size[MPHF_MAX_LEVELS];  // number of bits of each level, a multiple of 64
+    uint64_t *bits;                      // every level, back to back
+    uint32_t *ranks;                     // number of set bits before each word of `bits`
+    size_t n_words;
+    uint64_t *fallback; // sorted hashes that did not get a bit of their own in any level
+    size_t n_fallback;
+};
+
+
+/* rehash for a level, with the splitmix64 finalizer. Every level then places the hashes independently */
+static inline uint64_t level_hash(uint64_t hash, size_t level) {
+    uint64_t x = hash + (uint64_t) (level + 1) * 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static int compare_hashes(const void *a, const void *b) {
+    uint64_t hash_a = *(const uint64_t *) a;
+    uint64_t hash_b = *(const uint64_t *) b;
+    return (hash_a > hash_b) - (hash_a < hash_b);
+}
+
+/* place the hashes in a new level. Those that collide are moved to the front of `hashes`, and counted in
+    `*n_remaining`. returns 0 on success */
+static int build_level(mphf_t *mphf, uint64_t *hashes, size_t *n_remaining) {
+    size_t level = mphf->n_levels;
+    size_t n_words = (MPHF_GAMMA * *n_remaining + 63) / 64;
+    size_t size = n_words * 64;
+
+    uint64_t *new_bits = realloc(mphf->bits, (mphf->n_words + n_words) * sizeof(uint64_t));
+    if (new_bits == NULL) {
+        return -1;
+    }
+    mphf->bits = new_bits;
+
+    uint64_t *collide = calloc(n_words, sizeof(uint64_t));
+    if (collide == NULL) {
+        return -1;
+    }
+
+    uint64_t *bits = &mphf->bits[mphf->n_words];
+    memset(bits, 0, n_words * sizeof(uint64_t));
+
+    for (size_t i = 0; i < *n_remaining; i++) {
+        size_t pos = level_hash(hashes[i], level) % size;
+        uint64_t mask = 1ULL << (pos & 63);
+
+        if (bits[pos >> 6] & mask) {
+            collide[pos >> 6] |= mask;
+        } else {
+            bits[pos >> 6] |= mask;
+        }
+    }
+
+    /* only positions with exactly one hash are kept */
+    for (size_t w = 0; w < n_words; w++) {
+        bits[w] &= ~collide[w];
+    }
+
+    size_t n_kept = 0;
+    for (size_t i = 0; i < *n_remaining; i++) {
+        size_t pos = level_hash(hashes[i], level) % size;
+        if (collide[pos >> 6] & (1ULL << (pos & 63))) {
+            hashes[n_kept++] = hashes[i];
+        }
+    }
+    free(collide);
+
+    mphf->level_start[level] = mphf->n_words * 64;
+    mphf->level_size[level] = size;
+    mphf->n_words += n_words;
+    mphf->n_levels += 1;
+    *n_remaining = n_kept;
+    return 0;
+}
+
+mphf_t *mphf_build(const uint64_t *hashes, size_t n) {
+    if (n >= UINT32_MAX) {
+        pr_error("Too many hashes for a minimal perfect hash function: %zu\n", n);
+        return NULL;
+    }
+
+    mphf_t *mphf = calloc(1, sizeof(mphf_t));
+    uint64_t *remaining = malloc((n + 1) * sizeof(uint64_t));
+    if (mphf == NULL || remaining == NULL) {
+        pr_error("Failed to allocate memory for minimal perfect hash function\n");
+        free(mphf);
+        free(remaining);
+        return NULL;
+    }
+
+    mphf->n = n;
+    memcpy(remaining, hashes, n * sizeof(uint64_t));
+    size_t n_remaining = n;
+
+    while (n_remaining > 0 && mphf->n_levels < MPHF_MAX_LEVELS) {
+        if (build_level(mphf, remaining, &n_remaining) != 0) {
+            pr_error("Failed to allocate memory for minimal perfect hash function\n");
+            free(remaining);
+            mphf_destroy(mphf);
+            return NULL;
+        }
+    }
+
+    /* whatever is left goes in the fallback. Duplicate hashes always end up here, as they never separate */
+    qsort(remaining, n_remaining, sizeof(uint64_t), compare_hashes);
+    for (size_t i = 1; i < n_remaining; i++) {
+        if (remaining[i] == remaining[i - 1]) {
+            pr_warn("Duplicate hash %016llx, cannot build a perfect hash function\n",
+                    (unsigned long long) remaining[i]);
+            free(remaining);
+            mphf_destroy(mphf);
+            return NULL;
+        }
+    }
+    mphf->fallback = remaining;
+    mphf->n_fallback = n_remaining;
+
+    mphf->ranks = malloc((mphf->n_words + 1) * sizeof(uint32_t));
+    if (mphf->ranks == NULL) {
+        pr_error("Failed to allocate memory for minimal perfect hash function\n");
+        mphf_destroy(mphf);
+        return NULL;
+    }
+
+    uint32_t rank = 0;
+    for (size_t w = 0; w < mphf->n_words; w++) {
+        mphf->ranks[w] = rank;
+        rank += (uint32_t) __builtin_popcountll(mphf->bits[w]);
+    }
+    mphf->ranks[mphf->n_words] = rank;
+
+    return mphf;
+}
+
+void mphf_destroy(mphf_t *mphf) {
+    if (mphf == NULL) {
+        return;
+    }
+
+    free(mphf->bits);
+    free(mphf->ranks);
+    free(mphf->fallback);
+    free(mphf);
+}
+
+size_t mphf_lookup(const mphf_t *mphf, uint64_t hash) {
+    for (size_t level = 0; level < mphf->n_levels; level++) {
+        size_t pos = mphf->level_start[level] + level_hash(hash, level) % mphf->level_size[level];
+        uint64_t word = mphf->bits[pos >> 6];
+        uint64_t mask = 1ULL << (pos & 63);
+
+        if (word & mask) {
+            return mphf->ranks[pos >> 6] + (size_t) __builtin_popcountll(word & (mask - 1));
+        }
+    }
+
+    /* the fallback takes the last slots */
+    const uint64_t *found = bsearch(&hash, mphf->fallback, mphf->n_fallback, sizeof(uint64_t), compare_hashes);
+    if (found) {
+        return mphf->n - mphf->n_fallback + (size_t) (found - mphf->fallback);
+    }
+    return mphf->n;
+}
+
+size_t mphf_bytes(const mphf_t *mphf) {
+    size_t bits_bytes = mphf->n_words * sizeof(uint64_t) + (mphf->n_words + 1) * sizeof(uint32_t);
+    return sizeof(mphf_t) + bits_bytes + mphf->n_fallback * sizeof(uint64_t);
+}
+
+size_t mphf_levels(const mphf_t *mphf) {
+    return mphf->n_levels;
+}
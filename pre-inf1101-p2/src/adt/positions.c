@@ -0,0 +1,105 @@
+/**
+ * @implements positions.h
+ */
+
+#include <stdlib.h>
+
+#include "positions.h"
+#include "printing.h"
+
+/* maximum number of bytes a varint of a 32-bit value takes up */
+#define VARINT_MAX_BYTES 5
+
+
+void positions_init(positions_t *p) {
+    p->data = NULL;
+    p->len = 0;
+    p->capacity = 0;
+    p->offsets = NULL;
+    p->n_docs = 0;
+    p->offsets_capacity = 0;
+    p->last = 0;
+}
+
+void positions_deinit(positions_t *p) {
+    free(p->data);
+    free(p->offsets);
+    positions_init(p);
+}
+
+int positions_reserve(positions_t *p) {
+    if (p->len + VARINT_MAX_BYTES > p->capacity) {
+        size_t new_capacity = p->capacity ? p->capacity * 2 : 16;
+        if (new_capacity > UINT32_MAX) {
+            pr_error("Position lists cannot be larger than 4 GiB\n");
+            return -1;
+        }
+
+        uint8_t *new_data = realloc(p->data, new_capacity);
+        if (new_data == NULL) {
+            pr_error("Failed to allocate memory for positions\n");
+            return -1;
+        }
+        p->data = new_data;
+        p->capacity = new_capacity;
+    }
+
+    if (p->n_docs == p->offsets_capacity) {
+        size_t new_capacity = p->offsets_capacity ? p->offsets_capacity * 2 : 4;
+        uint32_t *new_offsets = realloc(p->offsets, new_capacity * sizeof(uint32_t));
+        if (new_offsets == NULL) {
+            pr_error("Failed to allocate memory for positions\n");
+            return -1;
+        }
+        p->offsets = new_offsets;
+        p->offsets_capacity = new_capacity;
+    }
+
+    return 0;
+}
+
+int positions_add(positions_t *p, bool new_doc, uint32_t pos) {
+    if (positions_reserve(p) != 0) {
+        return -1;
+    }
+
+    /* the first position of a document is stored as is, the rest as gaps */
+    uint32_t value = pos;
+    if (new_doc) {
+        p->offsets[p->n_docs++] = (uint32_t) p->len;
+    } else {
+        value = pos - p->last;
+    }
+
+    while (value >= 0x80) {
+        p->data[p->len++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    p->data[p->len++] = (uint8_t) value;
+
+    p->last = pos;
+    return 0;
+}
+
+void positions_decode(const positions_t *p, size_t i, uint32_t count, uint32_t *out) {
+    const uint8_t *src = &p->data[p->offsets[i]];
+    uint32_t pos = 0;
+
+    for (uint32_t n = 0; n < count; n++) {
+        uint32_t value = 0;
+        int shift = 0;
+
+        while (*src & 0x80) {
+            value |= (uint32_t) (*src++ & 0x7f) << shift;
+            shift += 7;
+        }
+        value |= (uint32_t) *src++ << shift;
+
+        pos += value; // the first one is added to 0
+        out[n] = pos;
+    }
+}
+
+size_t positions_bytes(const positions_t *p) {
+    return p->capacity + p->offsets_capacity * sizeof(uint32_t);
+}
@@ -0,0 +1,200 @@
+/**
+ * @implements postings.h
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "postings.h"
+#include "printing.h"
+
+
+void postings_init(postings_t *p) {
+    p->impacts = NULL;
+    p->len = 0;
+    p->capacity = POSTINGS_INLINE_CAPACITY;
+    p->impact_docs = NULL;
+    p->impact_levels = NULL;
+}
+
+void postings_deinit(postings_t *p) {
+    if (!postings_is_inline(p)) {
+        free(p->store.heap.docs);
+        free(p->store.heap.freqs);
+    }
+    free(p->impacts);
+    free(p->impact_docs);
+    free(p->impact_levels);
+    postings_init(p);
+}
+
+/* double the capacity of the list, moving it out of the struct if it is inline. returns 0 on success */
+static int postings_grow(postings_t *p) {
+    size_t new_capacity = p->capacity * 2;
+
+    if (postings_is_inline(p)) {
+        doc_id_t *docs = malloc(new_capacity * sizeof(doc_id_t));
+        uint32_t *freqs = malloc(new_capacity * sizeof(uint32_t));
+        if (docs == NULL || freqs == NULL) {
+            free(docs);
+            free(freqs);
+            return -1;
+        }
+
+        /* copy out before the pointers overwrite the inline arrays */
+        memcpy(docs, p->store.inl.docs, p->len * sizeof(doc_id_t));
+        memcpy(freqs, p->store.inl.freqs, p->len * sizeof(uint32_t));
+        p->store.heap.docs = docs;
+        p->store.heap.freqs = freqs;
+        p->capacity = new_capacity;
+        return 0;
+    }
+
+    doc_id_t *new_docs = realloc(p->store.heap.docs, new_capacity * sizeof(doc_id_t));
+    if (new_docs == NULL) {
+        return -1;
+    }
+    p->store.heap.docs = new_docs;
+
+    /* if this fails, the docs array is just larger than needed */
+    uint32_t *new_freqs = realloc(p->store.heap.freqs, new_capacity * sizeof(uint32_t));
+    if (new_freqs == NULL) {
+        return -1;
+    }
+    p->store.heap.freqs = new_freqs;
+
+    p->capacity = new_capacity;
+    return 0;
+}
+
+int postings_add(postings_t *p, doc_id_t doc) {
+    bool is_inline = postings_is_inline(p);
+    doc_id_t *docs = is_inline ? p->store.inl.docs : p->store.heap.docs;
+    uint32_t *freqs = is_inline ? p->store.inl.freqs : p->store.heap.freqs;
+
+    if (p->len > 0 && docs[p->len - 1] == doc) {
+        freqs[p->len - 1] += 1;
+        return 0;
+    }
+
+    if (p->len == p->capacity) {
+        if (postings_grow(p) != 0) {
+            pr_error("Failed to allocate memory for postings\n");
+            return -1;
+        }
+        docs = p->store.heap.docs;
+        freqs = p->store.heap.freqs;
+    }
+
+    docs[p->len] = doc;
+    freqs[p->len] = 1;
+    p->len += 1;
+    return 0;
+}
+
+size_t postings_seek(const postings_t *p, size_t from, doc_id_t doc) {
+    return docs_seek(postings_docs(p), p->len, from, doc);
+}
+
+size_t docs_seek(const doc_id_t *docs, size_t len, size_t from, doc_id_t doc) {
+    if (from >= len || docs[from] >= doc) {
+        return from;
+    }
+
+    /* gallop: find a window (lo, hi] where docs[lo] < doc <= docs[hi], doubling the step every time */
+    size_t lo = from;
+    size_t step = 1;
+    size_t hi = from + step;
+
+    while (hi < len && docs[hi] < doc) {
+        lo = hi;
+        step *= 2;
+        hi = lo + step;
+    }
+    if (hi > len) {
+        hi = len;
+    }
+
+    /* then binary search the window for the first position where docs[pos] >= doc */
+    lo += 1;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (docs[mid] < doc) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+int postings_reserve_impacts(postings_t *p) {
+    if (p->len == 0) {
+        return 0;
+    }
+
+    /* impacts are recomputed from scratch, so they only need room for the documents there are now */
+    uint8_t *new_impacts = realloc(p->impacts, p->len * sizeof(uint8_t));
+    if (new_impacts == NULL) {
+        pr_error("Failed to allocate memory for impacts\n");
+        return -1;
+    }
+
+    p->impacts = new_impacts;
+    return 0;
+}
+
+int postings_order_by_impact(postings_t *p) {
+    if (p->len == 0) {
+        return 0;
+    }
+
+    doc_id_t *new_docs = realloc(p->impact_docs, p->len * sizeof(doc_id_t));
+    if (new_docs == NULL) {
+        pr_error("Failed to allocate memory for impact ordered postings\n");
+        return -1;
+    }
+    p->impact_docs = new_docs;
+
+    uint8_t *new_levels = realloc(p->impact_levels, p->len * sizeof(uint8_t));
+    if (new_levels == NULL) {
+        pr_error("Failed to allocate memory for impact ordered postings\n");
+        return -1;
+    }
+    p->impact_levels = new_levels;
+
+    const doc_id_t *docs = postings_docs(p);
+
+    /* counting sort. Impacts only have 256 levels, and it is stable, so IDs stay increasing within a level */
+    size_t start[UINT8_MAX + 2] = { 0 };
+    for (size_t i = 0; i < p->len; i++) {
+        /* level 255 goes first, level 0 last */
+        start[UINT8_MAX - p->impacts[i] + 1] += 1;
+    }
+    for (size_t i = 1; i <= UINT8_MAX + 1; i++) {
+        start[i] += start[i - 1];
+    }
+
+    for (size_t i = 0; i < p->len; i++) {
+        size_t pos = start[UINT8_MAX - p->impacts[i]]++;
+        p->impact_docs[pos] = docs[i];
+        p->impact_levels[pos] = p->impacts[i];
+    }
+
+    return 0;
+}
+
+size_t postings_bytes(const postings_t *p) {
+    size_t bytes = 0;
+    if (!postings_is_inline(p)) {
+        bytes += p->capacity * (sizeof(doc_id_t) + sizeof(uint32_t));
+    }
+    if (p->impacts) {
+        bytes += p->len * sizeof(uint8_t);
+    }
+    if (p->impact_docs) {
+        bytes += p->len * (sizeof(doc_id_t) + sizeof(uint8_t));
+    }
+    return bytes;
+}
@@ -0,0 +1,807 @@
+/**
+ * @implements program.h
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#include "printing.h"
+#include "common.h"
+#include "index.h"
+#include "program.h"
+
+/* number of documents the scratch buffer initially has room for. It doubles whenever it is too small */
+#define SCRATCH_INITIAL_DOCS 1024
+
+
+/* Compilation */
+
+/* counts the instructions of the ast, and the bytes of its terms */
+static void count_code(AST *node, size_t *n_code, size_t *n_bytes) {
+    *n_code += 1;
+
+    switch (node->type) {
+        case AST_TERM:
+            *n_bytes += strlen(node->data.term) + 1;
+            return;
+
+        case AST_PREFIX:
+        case AST_FUZZY:
+        case AST_SUBSTRING:
+            for (size_t i = 0; i < node->data.expansion.n_terms; i++) {
+                *n_bytes += strlen(node->data.expansion.terms[i]) + 1;
+            }
+            return;
+
+        case AST_PHRASE:
+            for (size_t i = 0; i < node->data.phrase.n_terms; i++) {
+                *n_bytes += strlen(node->data.phrase.terms[i]) + 1;
+            }
+            return;
+
+        default:
+            count_code(node->data.children.left, n_code, n_bytes);
+            count_code(node->data.children.right, n_code, n_bytes);
+            return;
+    }
+}
+
+/* state of the compilation, as the ast is walked */
+typedef struct emitter {
+    program_t *program;
+    char *next_string; // where the next term is copied to
+    instr_t *code;     // where instructions are emitted to
+    size_t n_code;
+    size_t depth;      // depth of the stack after the instructions so far
+    size_t max_depth;
+} emitter_t;
+
+/* adds a leaf with the given term and offset */
+static void emit_leaf(emitter_t *e, const char *term, uint32_t offset) {
+    program_t *program = e->program;
+    size_t size = strlen(term) + 1;
+
+    memcpy(e->next_string, term, size);
+    program->terms[program->n_leaves] = e->next_string;
+    program->offsets[program->n_leaves] = offset;
+    program->n_leaves += 1;
+    e->next_string += size;
+}
+
+/* adds an instruction, keeping track of how deep the stack gets */
+static void emit(emitter_t *e, opcode_t op, size_t leaf, size_t n_leaves) {
+    e->code[e->n_code++] = (instr_t) { .op = op, .leaf = (uint32_t) leaf, .n_leaves = (uint32_t) n_leaves };
+
+    /* an operator replaces two results with one, saving or filtering one leaves one, everything else pushes one */
+    if (op == OP_AND || op == OP_OR || op == OP_ANDNOT) {
+        e->depth -= 1;
+    } else if (op != OP_SAVE && op != OP_EXCLUDE) {
+        e->depth += 1;
+    }
+    if (e->depth > e->max_depth) {
+        e->max_depth = e->depth;
+    }
+}
+
+/* emits the ast in postfix order: the operands of an operator, then the operator itself */
+static void emit_code(emitter_t *e, AST *node) {
+    size_t first_leaf = e->program->n_leaves;
+
+    switch (node->type) {
+        case AST_TERM:
+            emit_leaf(e, node->data.term, 0);
+            emit(e, OP_TERM, first_leaf, 1);
+            return;
+
+        case AST_PREFIX:
+        case AST_FUZZY:
+        case AST_SUBSTRING:
+            for (size_t i = 0; i < node->data.expansion.n_terms; i++) {
+                emit_leaf(e, node->data.expansion.terms[i], 0);
+            }
+            emit(e, OP_UNION, first_leaf, node->data.expansion.n_terms);
+            return;
+
+        case AST_PHRASE:
+            for (size_t i = 0; i < node->data.phrase.n_terms; i++) {
+                emit_leaf(e, node->data.phrase.terms[i], node->data.phrase.offsets[i]);
+            }
+            emit(e, OP_PHRASE, first_leaf, node->data.phrase.n_terms);
+            return;
+
+        default:
+            emit_code(e, node->data.children.left);
+            emit_code(e, node->data.children.right);
+            emit(e, (node->type == AST_AND) ? OP_AND : (node->type == AST_OR) ? OP_OR : OP_ANDNOT, 0, 0);
+            return;
+    }
+}
+
+/* resolves the postings of every leaf of the program at once. Stop words are not terms, but the words of
+    a phrase include them, and they are looked up as stop words there */
+static void lookup_leaves(const program_t *program, index_t *index, const postings_t **postings) {
+    index_lookup_terms(index, program->terms, program->n_leaves, postings);
+
+    for (size_t pc = 0; pc < program->n_code; pc++) {
+        const instr_t *instr = &program->code[pc];
+        if (instr->op != OP_PHRASE) {
+            continue;
+        }
+
+        for (size_t i = instr->leaf; i < instr->leaf + instr->n_leaves; i++) {
+            if (postings[i] == NULL) {
+                postings[i] = index_lookup_stop_word(index, program->terms[i]);
+            }
+        }
+    }
+}
+
+
+/* Rewriting */
+
+/* the node of the query that matches nothing */
+#define DAG_EMPTY 0
+
+/* a subquery of the rewritten query. Equal subqueries are the same node, so the query is a dag */
+typedef struct dag_node {
+    opcode_t op;
+    uint32_t leaf; // leaves of a term, union or phrase
+    uint32_t n_leaves;
+    uint32_t left; // operands of an operator, by node
+    uint32_t right;
+    uint32_t uses; // number of times the result is used by the rewritten query
+    int32_t slot;  // slot its result is saved in once it has been emitted, -1 until then
+} dag_node_t;
+
+/* the nodes, and a hash table of them to find equal nodes by. Slots hold node + 1, or 0 if empty */
+typedef struct dag {
+    const program_t *program;
+    const postings_t **postings; // postings of each leaf, NULL if its term is not indexed
+    dag_node_t *nodes;
+    size_t n_nodes;
+    uint32_t *table;
+    size_t n_table;
+} dag_t;
+
+static inline bool is_operator(opcode_t op) {
+    return op == OP_AND || op == OP_OR || op == OP_ANDNOT;
+}
+
+static uint64_t node_hash(const dag_t *dag, const dag_node_t *node) {
+    uint64_t hash = (uint64_t) node->op * 0x9E3779B97F4A7C15ULL;
+
+    if (is_operator(node->op)) {
+        return hash ^ (((uint64_t) node->left << 32) | node->right);
+    }
+    for (size_t i = node->leaf; i < node->leaf + node->n_leaves; i++) {
+        hash = (hash ^ fnv1a64_str(dag->program->terms[i])) * 0x100000001B3ULL;
+        hash ^= dag->program->offsets[i];
+    }
+    return hash;
+}
+
+/* operands are unique nodes, so operators are equal if their operands are the same nodes. Leaves are equal if
+    they have the same terms, at the same offsets */
+static bool node_equal(const dag_t *dag, const dag_node_t *a, const dag_node_t *b) {
+    if (a->op != b->op) {
+        return false;
+    }
+    if (is_operator(a->op)) {
+        return a->left == b->left && a->right == b->right;
+    }
+    if (a->n_leaves != b->n_leaves) {
+        return false;
+    }
+
+    const program_t *program = dag->program;
+    for (size_t i = 0; i < a->n_leaves; i++) {
+        if (strcmp(program->terms[a->leaf + i], program->terms[b->leaf + i]) != 0
+            || program->offsets[a->leaf + i] != program->offsets[b->leaf + i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* the node equal to `node`, which is added if there is none. There is room for every node of the query */
+static uint32_t intern_node(dag_t *dag, dag_node_t node) {
+    size_t i = (size_t) node_hash(dag, &node) & (dag->n_table - 1);
+
+    while (dag->table[i] != 0) {
+        uint32_t id = dag->table[i] - 1;
+        if (node_equal(dag, &dag->nodes[id], &node)) {
+            return id;
+        }
+        i = (i + 1) & (dag->n_table - 1);
+    }
+
+    uint32_t id = (uint32_t) dag->n_nodes++;
+    node.uses = 0;
+    node.slot = -1;
+    dag->nodes[id] = node;
+    dag->table[i] = id + 1;
+    return id;
+}
+
+/* a term, union or phrase. Terms that are not indexed match nothing */
+static uint32_t make_leaf(dag_t *dag, opcode_t op, size_t leaf, size_t n_leaves) {
+    const postings_t **postings = &dag->postings[leaf];
+    size_t n_found = 0;
+    for (size_t i = 0; i < n_leaves; i++) {
+        n_found += (postings[i] != NULL);
+    }
+
+    /* a union needs any of its terms, a phrase every one of them */
+    if (n_found == 0 || (op == OP_PHRASE && n_found < n_leaves)) {
+        return DAG_EMPTY;
+    }
+
+    /* like a stop word on its own, a phrase of only stop words matches nothing */
+    if (op == OP_PHRASE) {
+        size_t n_stop_words = 0;
+        for (size_t i = leaf; i < leaf + n_leaves; i++) {
+            n_stop_words += stop_word(dag->program->terms[i]);
+        }
+        if (n_stop_words == n_leaves) {
+            return DAG_EMPTY;
+        }
+    }
+
+    /* a union of one term is that term, as is a phrase of one word */
+    if (n_leaves == 1 && (op == OP_UNION || op == OP_PHRASE)) {
+        op = OP_TERM;
+    }
+
+    return intern_node(dag, (dag_node_t) { .op = op, .leaf = (uint32_t) leaf, .n_leaves = (uint32_t) n_leaves });
+}
+
+/* true if `id` is an `op` node with `operand` as one of its operands */
+static inline bool has_operand(const dag_t *dag, uint32_t id, opcode_t op, uint32_t operand) {
+    const dag_node_t *node = &dag->nodes[id];
+    return node->op == op && (node->left == operand || node->right == operand);
+}
+
+/* an operator, simplified by the laws of boolean algebra where possible */
+static uint32_t make_operator(dag_t *dag, opcode_t op, uint32_t left, uint32_t right) {
+    switch (op) {
+        case OP_AND:
+            if (left == DAG_EMPTY || right == DAG_EMPTY) {
+                return DAG_EMPTY;
+            }
+            if (left == right) {
+                return left; // a && a = a
+            }
+            if (has_operand(dag, right, OP_OR, left)) {
+                return left; // a && (a || b) = a
+            }
+            if (has_operand(dag, left, OP_OR, right)) {
+                return right;
+            }
+            if (dag->nodes[right].op == OP_ANDNOT && dag->nodes[right].left == left) {
+                return right; // a && (a &! b) = a &! b
+            }
+            if (dag->nodes[left].op == OP_ANDNOT && dag->nodes[left].left == right) {
+                return left;
+            }
+            if ((dag->nodes[right].op == OP_ANDNOT && dag->nodes[right].right == left)
+                || (dag->nodes[left].op == OP_ANDNOT && dag->nodes[left].right == right)) {
+                return DAG_EMPTY; // a && (b &! a) = nothing
+            }
+            break;
+
+        case OP_OR:
+            if (left == DAG_EMPTY || right == DAG_EMPTY) {
+                return (left == DAG_EMPTY) ? right : left;
+            }
+            if (left == right) {
+                return left; // a || a = a
+            }
+            if (has_operand(dag, right, OP_AND, left)
+                || (dag->nodes[right].op == OP_ANDNOT && dag->nodes[right].left == left)) {
+                return left; // a || (a && b) = a, a || (a &! b) = a
+            }
+            if (has_operand(dag, left, OP_AND, right)
+                || (dag->nodes[left].op == OP_ANDNOT && dag->nodes[left].left == right)) {
+                return right;
+            }
+            break;
+
+        default:
+            if (left == DAG_EMPTY || right == DAG_EMPTY) {
+                return left; // nothing &! a = nothing, a &! nothing = a
+            }
+            if (left == right || has_operand(dag, left, OP_AND, right) || has_operand(dag, right, OP_OR, left)) {
+                return DAG_EMPTY; // a &! a, (a && b) &! a and a &! (a || b) = nothing
+            }
+            if (dag->nodes[left].op == OP_ANDNOT && dag->nodes[left].left == right) {
+                return DAG_EMPTY; // (a &! b) &! a = nothing
+            }
+            break;
+    }
+
+    /* the operands of AND and OR can go in any order. Ordering them finds more equal subqueries */
+    if (op != OP_ANDNOT && left > right) {
+        uint32_t tmp = left;
+        left = right;
+        right = tmp;
+    }
+
+    return intern_node(dag, (dag_node_t) { .op = op, .left = left, .right = right });
+}
+
+/* builds the rewritten query bottom up, numbering the leaves like `emit_code` */
+static uint32_t build_dag(dag_t *dag, AST *node, size_t *leaf_i) {
+    size_t first_leaf = *leaf_i;
+
+    switch (node->type) {
+        case AST_TERM:
+            *leaf_i += 1;
+            return make_leaf(dag, OP_TERM, first_leaf, 1);
+
+        case AST_PREFIX:
+        case AST_FUZZY:
+        case AST_SUBSTRING:
+            *leaf_i += node->data.expansion.n_terms;
+            return make_leaf(dag, OP_UNION, first_leaf, node->data.expansion.n_terms);
+
+        case AST_PHRASE:
+            *leaf_i += node->data.phrase.n_terms;
+            return make_leaf(dag, OP_PHRASE, first_leaf, node->data.phrase.n_terms);
+
+        default: {
+            uint32_t left = build_dag(dag, node->data.children.left, leaf_i);
+            uint32_t right = build_dag(dag, node->data.children.right, leaf_i);
+            opcode_t op = (node->type == AST_AND) ? OP_AND : (node->type == AST_OR) ? OP_OR : OP_ANDNOT;
+            return make_operator(dag, op, left, right);
+        }
+    }
+}
+
+/* counts how many times the result of each node reachable from `id` is used */
+static void count_uses(dag_t *dag, uint32_t id) {
+    dag_node_t *node = &dag->nodes[id];
+
+    node->uses += 1;
+    if (node->uses == 1 && is_operator(node->op)) {
+        count_uses(dag, node->left);
+        count_uses(dag, node->right);
+    }
+}
+
+/* emits the rewritten query in postfix order. A result that is used again is saved the first time, and
+    loaded after that. The postings of a term are already at hand, so terms are not saved */
+static void emit_match(emitter_t *e, dag_t *dag, uint32_t id) {
+    dag_node_t *node = &dag->nodes[id];
+
+    if (node->slot >= 0) {
+        emit(e, OP_LOAD, (size_t) node->slot, 0);
+        return;
+    }
+
+    /* documents without a term, or a union of terms that is not needed elsewhere, are found by seeking in
+        their postings instead of reading them. Like any other result, it is saved if it is used again */
+    dag_node_t *right = is_operator(node->op) ? &dag->nodes[node->right] : NULL;
+    if (node->op == OP_ANDNOT && (right->op == OP_TERM || (right->op == OP_UNION && right->uses == 1))) {
+        emit_match(e, dag, node->left);
+        emit(e, OP_EXCLUDE, right->leaf, right->n_leaves);
+    } else {
+        if (is_operator(node->op)) {
+            emit_match(e, dag, node->left);
+            emit_match(e, dag, node->right);
+        }
+        emit(e, node->op, node->leaf, node->n_leaves);
+    }
+
+    if (node->uses > 1 && node->op != OP_TERM) {
+        node->slot = (int32_t) e->program->n_slots++;
+        emit(e, OP_SAVE, (size_t) node->slot, 0);
+    }
+}
+
+/* rewrites the query of `program`, from its ast. returns 0 on success */
+static int compile_match(program_t *program, AST *ast, index_t *index) {
+    size_t max_nodes = program->n_code + 1;
+    size_t n_table = 16;
+    while (n_table < 2 * max_nodes) {
+        n_table *= 2;
+    }
+
+    dag_t dag = {
+        .program = program,
+        .postings = malloc((program->n_leaves + 1) * sizeof(postings_t *)),
+        .nodes = malloc(max_nodes * sizeof(dag_node_t)),
+        .n_nodes = 1,
+        .table = calloc(n_table, sizeof(uint32_t)),
+        .n_table = n_table,
+    };
+    /* every node is emitted at most once, plus once more to save it and once to load it per use */
+    program->match = malloc(4 * max_nodes * sizeof(instr_t));
+
+    int status = -1;
+    if (dag.postings == NULL || dag.nodes == NULL || dag.table == NULL || program->match == NULL) {
+        goto cleanup;
+    }
+
+    dag.nodes[DAG_EMPTY] = (dag_node_t) { .op = OP_EMPTY, .slot = -1 };
+    lookup_leaves(program, index, dag.postings);
+
+    size_t leaf_i = 0;
+    uint32_t root = build_dag(&dag, ast, &leaf_i);
+    count_uses(&dag, root);
+
+    emitter_t e = { .program = program, .code = program->match };
+    emit_match(&e, &dag, root);
+    program->n_match = e.n_code;
+    program->match_depth = e.max_depth;
+    status = 0;
+
+cleanup:
+    free(dag.postings);
+    free(dag.nodes);
+    free(dag.table);
+    return status;
+}
+
+program_t *program_compile(AST *ast, index_t *index) {
+    if (ast == NULL || index == NULL) {
+        pr_error("Arguments cannot be NULL\n");
+        return NULL;
+    }
+
+    program_t *program = calloc(1, sizeof(program_t));
+    if (program == NULL) {
+        pr_error("Failed to allocate memory for query program\n");
+        return NULL;
+    }
+
+    size_t n_code = 0;
+    size_t n_bytes = 0;
+    count_code(ast, &n_code, &n_bytes);
+    size_t n_leaves = ast_count_terms(ast);
+
+    program->code = malloc(n_code * sizeof(instr_t));
+    program->terms = malloc((n_leaves + 1) * sizeof(char *));
+    program->strings = malloc(n_bytes + 1);
+    program->offsets = malloc((n_leaves + 1) * sizeof(uint32_t));
+    if (program->code == NULL || program->terms == NULL || program->strings == NULL || program->offsets == NULL) {
+        pr_error("Failed to allocate memory for query program\n");
+        program_destroy(program);
+        return NULL;
+    }
+
+    /* the query as written */
+    emitter_t e = { .program = program, .next_string = program->strings, .code = program->code };
+    emit_code(&e, ast);
+    program->n_code = e.n_code;
+    program->max_depth = e.max_depth;
+
+    /* and rewritten */
+    if (compile_match(program, ast, index) != 0) {
+        pr_error("Failed to allocate memory for query program\n");
+        program_destroy(program);
+        return NULL;
+    }
+
+    return program;
+}
+
+void program_destroy(program_t *program) {
+    if (program == NULL) {
+        return;
+    }
+
+    free(program->code);
+    free(program->match);
+    free(program->terms);
+    free(program->strings);
+    free(program->offsets);
+    free(program);
+}
+
+bool program_is_disjunction(const program_t *program) {
+    for (size_t i = 0; i < program->n_code; i++) {
+        opcode_t op = program->code[i].op;
+        if (op != OP_TERM && op != OP_UNION && op != OP_OR) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/* Evaluation */
+
+void program_scratch_deinit(program_scratch_t *scratch) {
+    free(scratch->sizes);
+    free(scratch->postings);
+    free(scratch->saved);
+    free(scratch->slots);
+    free(scratch->nodes);
+    free(scratch->operands);
+}
+
+/* make room for `n` documents in a buffer of the scratch space. returns 0 on success */
+static int reserve_docs(doc_id_t **docs, size_t *capacity, size_t n) {
+    if (n <= *capacity && *docs != NULL) {
+        return 0;
+    }
+
+    size_t new_capacity = *capacity ? *capacity : SCRATCH_INITIAL_DOCS;
+    while (new_capacity < n) {
+        new_capacity *= 2;
+    }
+
+    doc_id_t *new_docs = realloc(*docs, new_capacity * sizeof(doc_id_t));
+    if (new_docs == NULL) {
+        return -1;
+    }
+    *docs = new_docs;
+    *capacity = new_capacity;
+    return 0;
+}
+
+/* make room for the sizes of the stack, saved results and the postings of the leaves of `program`.
+    returns 0 on success */
+static int reserve_program(program_scratch_t *scratch, const program_t *program) {
+    if (program->match_depth > scratch->sizes_capacity) {
+        size_t *new_sizes = realloc(scratch->sizes, program->match_depth * sizeof(size_t));
+        if (new_sizes == NULL) {
+            return -1;
+        }
+        scratch->sizes = new_sizes;
+        scratch->sizes_capacity = program->match_depth;
+    }
+
+    if (2 * program->n_slots > scratch->slots_capacity) {
+        size_t *new_slots = realloc(scratch->slots, 2 * program->n_slots * sizeof(size_t));
+        if (new_slots == NULL) {
+            return -1;
+        }
+        scratch->slots = new_slots;
+        scratch->slots_capacity = 2 * program->n_slots;
+    }
+
+    if (program->n_leaves > scratch->postings_capacity) {
+        const postings_t **new_postings = realloc(scratch->postings, program->n_leaves * sizeof(postings_t *));
+        if (new_postings == NULL) {
+            return -1;
+        }
+        scratch->postings = new_postings;
+        scratch->postings_capacity = program->n_leaves;
+    }
+
+    return 0;
+}
+
+/* make room for the cursors of `program`, and the stack of cursors it is built with. returns 0 on success */
+static int reserve_cursors(program_scratch_t *scratch, const program_t *program) {
+    /* a union of n leaves takes n leaf cursors and n - 1 ORs, and an exclude one ANDNOT more */
+    size_t n_nodes = 0;
+    for (size_t pc = 0; pc < program->n_match; pc++) {
+        n_nodes += 2 * program->match[pc].n_leaves + 2;
+    }
+
+    if (n_nodes > scratch->nodes_capacity) {
+        cursor_t *new_nodes = realloc(scratch->nodes, n_nodes * sizeof(cursor_t));
+        if (new_nodes == NULL) {
+            return -1;
+        }
+        scratch->nodes = new_nodes;
+        scratch->nodes_capacity = n_nodes;
+    }
+
+    if (program->match_depth > scratch->operands_capacity) {
+        cursor_t **new_operands = realloc(scratch->operands, program->match_depth * sizeof(cursor_t *));
+        if (new_operands == NULL) {
+            return -1;
+        }
+        scratch->operands = new_operands;
+        scratch->operands_capacity = program->match_depth;
+    }
+
+    return 0;
+}
+
+/* the most documents the phrases and saved results of `program` can have in total. Cursors are left over
+    them, so they are all made room for before the first is written */
+static size_t materialized_most(program_scratch_t *scratch, const program_t *program) {
+    const postings_t **postings = scratch->postings;
+    size_t *most = scratch->slots; // the most documents of each slot
+    size_t *sizes = scratch->sizes; // the most documents of each result on the stack
+    size_t sp = 0;
+    size_t total = 0;
+
+    for (size_t pc = 0; pc < program->n_match; pc++) {
+        const instr_t *instr = &program->match[pc];
+        const postings_t **leaves = &postings[instr->leaf];
+        size_t n = 0;
+
+        switch (instr->op) {
+            case OP_TERM:
+            case OP_UNION:
+                for (size_t i = 0; i < instr->n_leaves; i++) {
+                    n += leaves[i] ? leaves[i]->len : 0;
+                }
+                break;
+
+            case OP_PHRASE:
+                for (size_t i = 0; i < instr->n_leaves; i++) {
+                    size_t len = leaves[i] ? leaves[i]->len : 0;
+                    n = (i == 0 || len < n) ? len : n;
+                }
+                total += n;
+                break;
+
+            case OP_AND:
+                sp -= 2;
+                n = (sizes[sp] < sizes[sp + 1]) ? sizes[sp] : sizes[sp + 1];
+                break;
+
+            case OP_OR:
+                sp -= 2;
+                n = sizes[sp] + sizes[sp + 1];
+                break;
+
+            case OP_ANDNOT:
+                sp -= 2;
+                n = sizes[sp];
+                break;
+
+            case OP_EXCLUDE:
+                n = sizes[--sp];
+                break;
+
+            case OP_SAVE:
+                most[instr->leaf] = sizes[sp - 1];
+                total += sizes[sp - 1];
+                continue;
+
+            case OP_LOAD:
+                n = most[instr->leaf];
+                break;
+
+            default:
+                break;
+        }
+        sizes[sp++] = n;
+    }
+
+    return total;
+}
+
+/* initialize `root` as a balanced OR of cursors over `n` postings lists (some may be NULL). The cursors below
+    it are taken from `nodes`, and `n_nodes` is advanced past them */
+static void open_union(cursor_t *root, cursor_t *nodes, size_t *n_nodes, const postings_t **lists, size_t n) {
+    if (n <= 1) {
+        cursor_init_postings(root, (n == 1) ? lists[0] : NULL);
+        return;
+    }
+
+    cursor_t *left = &nodes[(*n_nodes)++];
+    cursor_t *right = &nodes[(*n_nodes)++];
+    open_union(left, nodes, n_nodes, lists, n / 2);
+    open_union(right, nodes, n_nodes, &lists[n / 2], n - n / 2);
+    cursor_init_or(root, left, right);
+}
+
+int program_open(
+    const program_t *program, index_t *index, program_scratch_t *scratch, cursor_t **out_root, char *errmsg
+) {
+    if (program == NULL || index == NULL || scratch == NULL || out_root == NULL) {
+        snprintf(errmsg, LINE_MAX, "Arguments cannot be NULL");
+        return -1;
+    }
+
+    if (reserve_program(scratch, program) != 0 || reserve_cursors(scratch, program) != 0) {
+        snprintf(errmsg, LINE_MAX, "Failed to allocate memory for query evaluation");
+        return -1;
+    }
+
+    /* resolve every term of the query at once, and make room for what has to be materialized */
+    const postings_t **postings = scratch->postings;
+    lookup_leaves(program, index, postings);
+
+    size_t most = materialized_most(scratch, program);
+    if (reserve_docs(&scratch->saved, &scratch->saved_capacity, most) != 0) {
+        snprintf(errmsg, LINE_MAX, "Failed to allocate memory for query evaluation");
+        return -1;
+    }
+
+    /* the operands of an operator are the two cursors on top of the stack, and it replaces them */
+    cursor_t *nodes = scratch->nodes;
+    cursor_t **stack = scratch->operands;
+    doc_id_t *saved = scratch->saved;
+    size_t n_nodes = 0;
+    size_t sp = 0;
+    size_t saved_top = 0;
+
+    for (size_t pc = 0; pc < program->n_match; pc++) {
+        const instr_t *instr = &program->match[pc];
+        const postings_t **leaves = &postings[instr->leaf];
+        cursor_t *cursor = &nodes[n_nodes++];
+
+        switch (instr->op) {
+            case OP_EMPTY:
+                cursor_init_docs(cursor, NULL, 0);
+                break;
+
+            case OP_TERM:
+                cursor_init_postings(cursor, leaves[0]);
+                break;
+
+            case OP_UNION:
+                open_union(cursor, nodes, &n_nodes, leaves, instr->n_leaves);
+                break;
+
+            case OP_PHRASE: {
+                /* positions are not walked by cursors, so the documents of a phrase are found up front */
+                size_t n = 0;
+                doc_id_t *out = &saved[saved_top];
+                if (index_match_phrase(
+                        index, leaves, &program->offsets[instr->leaf], instr->n_leaves, out, &n, errmsg
+                    ) != 0) {
+                    return -1;
+                }
+                cursor_init_docs(cursor, out, n);
+                saved_top += n;
+                break;
+            }
+
+            case OP_AND:
+            case OP_OR:
+            case OP_ANDNOT: {
+                cursor_t *right = stack[--sp];
+                cursor_t *left = stack[--sp];
+                if (instr->op == OP_AND) {
+                    cursor_init_and(cursor, left, right);
+                } else if (instr->op == OP_OR) {
+                    cursor_init_or(cursor, left, right);
+                } else {
+                    cursor_init_andnot(cursor, left, right);
+                }
+                break;
+            }
+
+            case OP_EXCLUDE: {
+                cursor_t *left = stack[--sp];
+                cursor_t *right = &nodes[n_nodes++];
+                open_union(right, nodes, &n_nodes, leaves, instr->n_leaves);
+                cursor_init_andnot(cursor, left, right);
+                break;
+            }
+
+            case OP_SAVE: {
+                /* a cursor can only be walked once, so a result that is used again is walked to the end here.
+                    Both uses walk the saved documents instead */
+                size_t start = saved_top;
+                cursor_t *saving = stack[--sp];
+                for (doc_id_t doc = cursor_doc(saving); doc != CURSOR_END; doc = cursor_next(saving)) {
+                    saved[saved_top++] = doc;
+                }
+                scratch->slots[2 * instr->leaf] = start;
+                scratch->slots[2 * instr->leaf + 1] = saved_top - start;
+                cursor_init_docs(cursor, &saved[start], saved_top - start);
+                break;
+            }
+
+            case OP_LOAD:
+                cursor_init_docs(
+                    cursor, &saved[scratch->slots[2 * instr->leaf]], scratch->slots[2 * instr->leaf + 1]
+                );
+                break;
+        }
+
+        stack[sp++] = cursor;
+    }
+
+    if (sp != 1) {
+        snprintf(errmsg, LINE_MAX, "Malformed query program");
+        return -1;
+    }
+
+    *out_root = stack[0];
+    return 0;
+}
@@ -40,6 +40,7 @@ struct set {
     tnode_t *root;
     cmp_fn cmpfn;
     size_t length;
+    size_t n_rotations;
 };
 
 static tnode_t sentinel = {.color = BLACK};
@@ -110,6 +111,7 @@ set_t *set_create(cmp_fn cmpfn) {
     set->root = NIL;
     set->cmpfn = cmpfn;
     set->length = 0;
+    set->n_rotations = 0;
 
     return set;
 }
@@ -154,6 +156,7 @@ void set_destroy(set_t *set, free_fn elem_freefn) {
 /* rotate node counter-clockwise */
 static inline void rotate_left(set_t *set, tnode_t *u) {
     tnode_t *v = u->right;
+    set->n_rotations += 1;
 
     u->right = v->left;
     if (v->left != NIL) {
@@ -176,6 +179,7 @@ static inline void rotate_left(set_t *set, tnode_t *u) {
 /* rotate node clockwise */
 static inline void rotate_right(set_t *set, tnode_t *u) {
     tnode_t *v = u->left;
+    set->n_rotations += 1;
 
     u->left = v->right;
     if (v->right != NIL) {
@@ -499,6 +503,29 @@ set_t *set_difference(set_t *a, set_t *b) {
 }
 
 
+/* -----------------------Statistics---------------------- */
+
+static size_t rec_height(tnode_t *node) {
+    if (node == NIL) {
+        return 0;
+    }
+
+    size_t h_left = rec_height(node->left);
+    size_t h_right = rec_height(node->right);
+
+    return 1 + ((h_left > h_right) ? h_left : h_right);
+}
+
+void set_stats(set_t *set, set_stats_t *stats) {
+    memset(stats, 0, sizeof(set_stats_t));
+
+    stats->length = set->length;
+    stats->height = rec_height(set->root);
+    stats->n_rotations = set->n_rotations;
+    stats->bytes = sizeof(set_t) + set->length * sizeof(tnode_t);
+}
+
+
 /* -----------------------Iteration----------------------- */
 
 typedef struct set_iter {
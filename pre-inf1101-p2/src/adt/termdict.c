@@ -0,0 +1,568 @@
+/**
+ * @implements termdict.h
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "termdict.h"
+#include "levenshtein.h"
+#include "printing.h"
+
+/**
+ * Every term is encoded as:
+ * - varint: length of the prefix it shares with the term before it (always 0 for the first term of a block)
+ * - varint: length of the rest (suffix) of the term
+ * - the suffix itself, without a null terminator
+ * - varint: the value of the term
+ *
+ * Varints are 7 bits per byte, least significant first, with the high bit set on all but the last byte.
+ */
+struct termdict {
+    uint8_t *data; // the encoded terms, block by block
+    size_t data_len;
+    size_t *block_offsets; // byte offset of the first term of each block
+    size_t n_blocks;
+    size_t n_terms;
+    size_t max_len;   // length of the longest term
+    size_t raw_bytes; // sum of the lengths of every term
+};
+
+/* maximum number of bytes a varint of a 64-bit value takes up */
+#define VARINT_MAX_BYTES 10
+
+
+static size_t put_varint(uint8_t *dst, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        dst[n++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    dst[n++] = (uint8_t) value;
+    return n;
+}
+
+static size_t get_varint(const uint8_t *src, uint64_t *value) {
+    size_t n = 0;
+    int shift = 0;
+    *value = 0;
+
+    while (src[n] & 0x80) {
+        *value |= (uint64_t) (src[n++] & 0x7f) << shift;
+        shift += 7;
+    }
+    *value |= (uint64_t) src[n++] << shift;
+    return n;
+}
+
+/* make room for `n` more bytes of data. returns 0 on success */
+static int reserve_data(termdict_t *dict, size_t *capacity, size_t n) {
+    if (dict->data_len + n <= *capacity) {
+        return 0;
+    }
+
+    size_t new_capacity = *capacity ? *capacity * 2 : 4096;
+    while (new_capacity < dict->data_len + n) {
+        new_capacity *= 2;
+    }
+
+    uint8_t *new_data = realloc(dict->data, new_capacity);
+    if (new_data == NULL) {
+        return -1;
+    }
+
+    dict->data = new_data;
+    *capacity = new_capacity;
+    return 0;
+}
+
+termdict_t *termdict_build(const char **terms, const uint32_t *values, size_t n) {
+    termdict_t *dict = calloc(1, sizeof(termdict_t));
+    if (dict == NULL) {
+        pr_error("Failed to allocate memory for dictionary\n");
+        return NULL;
+    }
+
+    dict->n_terms = n;
+    dict->n_blocks = (n + TERMDICT_BLOCK_SIZE - 1) / TERMDICT_BLOCK_SIZE;
+    dict->block_offsets = malloc((dict->n_blocks ? dict->n_blocks : 1) * sizeof(size_t));
+    if (dict->block_offsets == NULL) {
+        pr_error("Failed to allocate memory for dictionary\n");
+        free(dict);
+        return NULL;
+    }
+
+    size_t capacity = 0;
+    const char *prev = NULL;
+    size_t prev_len = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        const char *term = terms[i];
+        size_t len = strlen(term);
+        size_t shared = 0;
+
+        if (prev && strcmp(prev, term) >= 0) {
+            pr_error("Dictionary terms must be strictly increasing, found \"%s\" after \"%s\"\n", term, prev);
+            termdict_destroy(dict);
+            return NULL;
+        }
+
+        if (i % TERMDICT_BLOCK_SIZE == 0) {
+            /* the first term of a block is stored in full, so lookups can start decoding there */
+            dict->block_offsets[i / TERMDICT_BLOCK_SIZE] = dict->data_len;
+        } else {
+            while (shared < len && shared < prev_len && prev[shared] == term[shared]) {
+                shared++;
+            }
+        }
+
+        if (reserve_data(dict, &capacity, 3 * VARINT_MAX_BYTES + len - shared) != 0) {
+            pr_error("Failed to allocate memory for dictionary\n");
+            termdict_destroy(dict);
+            return NULL;
+        }
+
+        uint8_t *dst = dict->data;
+        dict->data_len += put_varint(&dst[dict->data_len], shared);
+        dict->data_len += put_varint(&dst[dict->data_len], len - shared);
+        memcpy(&dst[dict->data_len], &term[shared], len - shared);
+        dict->data_len += len - shared;
+        dict->data_len += put_varint(&dst[dict->data_len], values[i]);
+
+        dict->raw_bytes += len;
+        if (len > dict->max_len) {
+            dict->max_len = len;
+        }
+
+        prev = term;
+        prev_len = len;
+    }
+
+    /* the dictionary is immutable, so give back what is left over from growing */
+    if (dict->data_len && dict->data_len < capacity) {
+        uint8_t *shrunk = realloc(dict->data, dict->data_len);
+        if (shrunk) {
+            dict->data = shrunk;
+        }
+    }
+
+    return dict;
+}
+
+void termdict_destroy(termdict_t *dict) {
+    if (dict == NULL) {
+        return;
+    }
+
+    free(dict->data);
+    free(dict->block_offsets);
+    free(dict);
+}
+
+size_t termdict_length(const termdict_t *dict) {
+    return dict->n_terms;
+}
+
+size_t termdict_bytes(const termdict_t *dict) {
+    return sizeof(termdict_t) + dict->data_len + dict->n_blocks * sizeof(size_t);
+}
+
+size_t termdict_raw_bytes(const termdict_t *dict) {
+    return dict->raw_bytes;
+}
+
+/* compares a string of `len` bytes (not null terminated) to `key`, ordered as by `strcmp` */
+static int compare_bytes(const uint8_t *bytes, size_t len, const char *key, size_t key_len) {
+    int cmp = memcmp(bytes, key, (len < key_len) ? len : key_len);
+    if (cmp != 0) {
+        return cmp;
+    }
+    return (len > key_len) - (len < key_len);
+}
+
+/* find the last block whose first term is <= key, or the first block if there is none */
+static size_t find_block(const termdict_t *dict, const char *key, size_t key_len) {
+    size_t lo = 0;
+    size_t hi = dict->n_blocks;
+
+    /* find the first block whose first term is > key */
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        uint64_t shared, len;
+        size_t offset = dict->block_offsets[mid];
+
+        offset += get_varint(&dict->data[offset], &shared);
+        offset += get_varint(&dict->data[offset], &len);
+
+        if (compare_bytes(&dict->data[offset], len, key, key_len) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo ? lo - 1 : 0;
+}
+
+/* find the position of the first term >= `term`, i.e. the number of terms less than it. returns 1 if that term
+    is equal to `term`, with `value` set to its value, otherwise 0 */
+static int seek_key(const termdict_t *dict, const char *term, size_t *out_pos, uint32_t *value) {
+    *out_pos = 0;
+    if (dict->n_terms == 0) {
+        return 0;
+    }
+
+    size_t key_len = strlen(term);
+    size_t block = find_block(dict, term, key_len);
+    size_t offset = dict->block_offsets[block];
+    size_t end = (block + 1) * TERMDICT_BLOCK_SIZE;
+    if (end > dict->n_terms) {
+        end = dict->n_terms;
+    }
+
+    /**
+     * Scan the block without decoding it, tracking how long a prefix the previous term shares with the key.
+     * Every term scanned so far is less than the key, so the next one can often be placed from its shared
+     * prefix length alone.
+     */
+    size_t matched = 0;
+
+    for (size_t pos = block * TERMDICT_BLOCK_SIZE; pos < end; pos++) {
+        uint64_t shared, suffix_len, term_value;
+        offset += get_varint(&dict->data[offset], &shared);
+        offset += get_varint(&dict->data[offset], &suffix_len);
+        const uint8_t *suffix = &dict->data[offset];
+        offset += suffix_len;
+        offset += get_varint(&dict->data[offset], &term_value);
+
+        *out_pos = pos;
+        if (shared < matched) {
+            /* differs from the previous term where that one still matched the key, and is greater */
+            return 0;
+        }
+        if (shared > matched) {
+            /* agrees with the previous term past where that one fell below the key */
+            continue;
+        }
+
+        size_t i = 0;
+        while (i < suffix_len && matched + i < key_len && suffix[i] == (uint8_t) term[matched + i]) {
+            i++;
+        }
+        matched += i;
+
+        if (i == suffix_len) {
+            if (matched == key_len) {
+                *value = (uint32_t) term_value;
+                return 1;
+            }
+            continue; // a proper prefix of the key, so less than it
+        }
+        if (matched == key_len || suffix[i] > (uint8_t) term[matched]) {
+            return 0; // passed the key
+        }
+    }
+
+    /* every term of the block is less than the key, and the first of the next block is greater */
+    *out_pos = end;
+    return 0;
+}
+
+int termdict_get(const termdict_t *dict, const char *term, uint32_t *value) {
+    size_t pos;
+    return seek_key(dict, term, &pos, value);
+}
+
+int termdict_prefix_range(const termdict_t *dict, const char *prefix, size_t *lo, size_t *hi) {
+    uint32_t value;
+    seek_key(dict, prefix, lo, &value);
+
+    /**
+     * The terms with the prefix end before the first term >= the smallest string greater than every one of
+     * them: the prefix with its last byte incremented, once trailing 0xff bytes (which cannot be) are dropped
+     */
+    size_t len = strlen(prefix);
+    while (len > 0 && (uint8_t) prefix[len - 1] == 0xff) {
+        len--;
+    }
+    if (len == 0) {
+        *hi = dict->n_terms;
+        return 0;
+    }
+
+    char *bound = strndup(prefix, len);
+    if (bound == NULL) {
+        pr_error("Failed to allocate memory for prefix\n");
+        return -1;
+    }
+    bound[len - 1] = (char) ((uint8_t) bound[len - 1] + 1);
+    seek_key(dict, bound, hi, &value);
+
+    free(bound);
+    return 0;
+}
+
+/* decode the term at `offset` on top of the term before it. returns the offset of the next term */
+static size_t decode_term(const termdict_t *dict, size_t offset, char *buf, uint32_t *value) {
+    uint64_t shared, suffix_len, term_value;
+
+    offset += get_varint(&dict->data[offset], &shared);
+    offset += get_varint(&dict->data[offset], &suffix_len);
+    memcpy(&buf[shared], &dict->data[offset], suffix_len);
+    buf[shared + suffix_len] = '\0';
+    offset += suffix_len;
+    offset += get_varint(&dict->data[offset], &term_value);
+
+    *value = (uint32_t) term_value;
+    return offset;
+}
+
+/* decode the next term of an iterator. Automaton states are only kept for the prefix it shares with the term
+    before it */
+static void iter_decode_next(termdict_iter_t *iter) {
+    uint64_t shared;
+    get_varint(&iter->dict->data[iter->offset], &shared);
+    if (shared < iter->states_depth) {
+        iter->states_depth = shared;
+    }
+
+    iter->offset = decode_term(iter->dict, iter->offset, iter->term, &iter->value);
+    iter->pos++;
+    iter->visited++;
+}
+
+/* move an iterator forward to the first term >= lo, which is left pending. Jumps straight to the block of
+    `lo` if it is past the current one. returns 0 if there is no such term */
+static int iter_seek(termdict_iter_t *iter, const char *lo) {
+    const termdict_t *dict = iter->dict;
+    size_t block = find_block(dict, lo, strlen(lo));
+
+    if (block * TERMDICT_BLOCK_SIZE > iter->pos) {
+        /* the first term of a block shares nothing with the one before, so no states survive the jump */
+        iter->pos = block * TERMDICT_BLOCK_SIZE;
+        iter->offset = dict->block_offsets[block];
+        iter->states_depth = 0;
+    }
+
+    while (iter->pos < dict->n_terms) {
+        iter_decode_next(iter);
+
+        if (strcmp(iter->term, lo) >= 0) {
+            iter->pending = 1;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int termdict_iter_range(const termdict_t *dict, termdict_iter_t *iter, const char *lo, const char *hi) {
+    iter->dict = dict;
+    iter->pos = 0;
+    iter->offset = 0;
+    iter->value = 0;
+    iter->pending = 0;
+    iter->prefix = NULL;
+    iter->prefix_len = 0;
+    iter->hi = hi;
+    iter->fuzzy = NULL;
+    iter->states = NULL;
+    iter->states_depth = 0;
+    iter->bound = NULL;
+    iter->visited = 0;
+    iter->term = malloc(dict->max_len + 1);
+    if (iter->term == NULL) {
+        pr_error("Failed to allocate memory for dictionary iterator\n");
+        return -1;
+    }
+    iter->term[0] = '\0';
+
+    if (lo == NULL || dict->n_terms == 0) {
+        return 0;
+    }
+
+    /* start from the block lo would be in, and decode until reaching it */
+    size_t block = find_block(dict, lo, strlen(lo));
+    iter->pos = block * TERMDICT_BLOCK_SIZE;
+    iter->offset = dict->block_offsets[block];
+
+    while (iter->pos < dict->n_terms) {
+        iter_decode_next(iter);
+
+        if (strcmp(iter->term, lo) >= 0) {
+            iter->pending = 1;
+            break;
+        }
+    }
+
+    return 0;
+}
+
+int termdict_iter_prefix(const termdict_t *dict, termdict_iter_t *iter, const char *prefix) {
+    if (termdict_iter_range(dict, iter, prefix, NULL) != 0) {
+        return -1;
+    }
+
+    iter->prefix = prefix;
+    iter->prefix_len = strlen(prefix);
+    return 0;
+}
+
+int termdict_iter_fuzzy(const termdict_t *dict, termdict_iter_t *iter, const char *term, unsigned max_edits) {
+    if (termdict_iter_range(dict, iter, NULL, NULL) != 0) {
+        return -1;
+    }
+
+    iter->fuzzy = levenshtein_create(term, max_edits);
+    if (iter->fuzzy == NULL) {
+        termdict_iter_deinit(iter);
+        return -1;
+    }
+
+    /* one state for every prefix of the longest term, including the empty one */
+    iter->states = malloc((dict->max_len + 1) * levenshtein_state_size(iter->fuzzy));
+    iter->bound = malloc(dict->max_len + 1);
+    if (iter->states == NULL || iter->bound == NULL) {
+        pr_error("Failed to allocate memory for dictionary iterator\n");
+        termdict_iter_deinit(iter);
+        return -1;
+    }
+
+    levenshtein_start(iter->fuzzy, iter->states);
+    return 0;
+}
+
+/* `termdict_iter_next` for iterators with an automaton */
+static const char *iter_next_fuzzy(termdict_iter_t *iter, uint32_t *value) {
+    size_t size = levenshtein_state_size(iter->fuzzy);
+
+    while (1) {
+        if (iter->pending) {
+            iter->pending = 0;
+        } else if (iter->pos < iter->dict->n_terms) {
+            iter_decode_next(iter);
+        } else {
+            return NULL;
+        }
+
+        /* step through the part of the term that differs from the one before */
+        const char *term = iter->term;
+        size_t depth = iter->states_depth;
+        bool alive = true;
+
+        while (alive && term[depth] != '\0') {
+            const uint8_t *state = &iter->states[depth * size];
+            alive = levenshtein_step(iter->fuzzy, state, term[depth], &iter->states[(depth + 1) * size]);
+            depth++;
+        }
+        iter->states_depth = depth;
+
+        if (alive) {
+            if (levenshtein_accepts(iter->fuzzy, &iter->states[depth * size])) {
+                if (value) {
+                    *value = iter->value;
+                }
+                return iter->term;
+            }
+            continue;
+        }
+
+        /**
+         * No term starting with the first `depth` characters matches. Skip to the first term that could: change
+         * the last of those characters to the next one the automaton does not die on. If there is none, the
+         * character before it is changed instead, and so on.
+         */
+        memcpy(iter->bound, term, depth);
+        int next = -1;
+
+        while (depth > 0) {
+            /* the state after `depth` characters is overwritten, and no longer valid */
+            if (iter->states_depth >= depth) {
+                iter->states_depth = depth - 1;
+            }
+
+            const uint8_t *state = &iter->states[(depth - 1) * size];
+            uint8_t *scratch = &iter->states[depth * size];
+            next = levenshtein_next_char(iter->fuzzy, state, (uint8_t) iter->bound[depth - 1], scratch);
+            if (next >= 0) {
+                break;
+            }
+            depth--;
+        }
+
+        if (next < 0) {
+            iter->pos = iter->dict->n_terms;
+            return NULL;
+        }
+        iter->bound[depth - 1] = (char) next;
+        iter->bound[depth] = '\0';
+
+        if (!iter_seek(iter, iter->bound)) {
+            return NULL;
+        }
+    }
+}
+
+int termdict_iter_seek_pos(termdict_iter_t *iter, size_t pos) {
+    const termdict_t *dict = iter->dict;
+
+    /* a pending term is at the position before `iter->pos` */
+    size_t next = iter->pending ? iter->pos - 1 : iter->pos;
+    if (pos >= dict->n_terms || pos < next) {
+        pr_error("Cannot seek to term %zu of %zu, the iterator is at %zu\n", pos, dict->n_terms, next);
+        return -1;
+    }
+    if (pos == next) {
+        return 0;
+    }
+
+    size_t block = pos / TERMDICT_BLOCK_SIZE;
+    if (block * TERMDICT_BLOCK_SIZE > iter->pos) {
+        iter->pos = block * TERMDICT_BLOCK_SIZE;
+        iter->offset = dict->block_offsets[block];
+        iter->states_depth = 0;
+    }
+
+    while (iter->pos <= pos) {
+        iter_decode_next(iter);
+    }
+    iter->pending = 1;
+    return 0;
+}
+
+const char *termdict_iter_next(termdict_iter_t *iter, uint32_t *value) {
+    if (iter->fuzzy) {
+        return iter_next_fuzzy(iter, value);
+    }
+
+    if (iter->pending) {
+        iter->pending = 0;
+    } else if (iter->pos < iter->dict->n_terms) {
+        iter_decode_next(iter);
+    } else {
+        return NULL;
+    }
+
+    /* past the end of the range. The terms are sorted, so none of the rest are in it either */
+    if ((iter->prefix && strncmp(iter->term, iter->prefix, iter->prefix_len) != 0)
+        || (iter->hi && strcmp(iter->term, iter->hi) >= 0)) {
+        iter->pos = iter->dict->n_terms;
+        return NULL;
+    }
+
+    if (value) {
+        *value = iter->value;
+    }
+    return iter->term;
+}
+
+void termdict_iter_deinit(termdict_iter_t *iter) {
+    free(iter->term);
+    iter->term = NULL;
+    levenshtein_destroy(iter->fuzzy);
+    iter->fuzzy = NULL;
+    free(iter->states);
+    iter->states = NULL;
+    free(iter->bound);
+    iter->bound = NULL;
+}
@@ -0,0 +1,232 @@
+/**
+ * @implements trigrams.h
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "trigrams.h"
+#include "printing.h"
+
+/* initial number of slots of the table, a power of two */
+#define TRIGRAMS_INITIAL_SLOTS 1024
+
+/* the term ids of one trigram. The trigram is packed into `key`, one byte per character, so 0 is never a key */
+typedef struct trigram_list {
+    uint32_t key;
+    uint32_t len;
+    uint32_t capacity;
+    uint32_t *ids;
+} trigram_list_t;
+
+/* open addressing table of trigram lists, with linear probing. At most half the slots are used */
+struct trigrams {
+    trigram_list_t *slots;
+    size_t n_slots;
+    size_t length;
+    size_t ids_capacity; // total capacity of the lists, for `trigrams_bytes`
+};
+
+
+static inline uint32_t trigram_key(const char *s) {
+    return ((uint32_t) (unsigned char) s[0] << 16) | ((uint32_t) (unsigned char) s[1] << 8)
+        | (uint32_t) (unsigned char) s[2];
+}
+
+static inline size_t trigram_slot(uint32_t key, size_t n_slots) {
+    /* fibonacci hashing, the keys themselves are far from uniform */
+    return (size_t) (((uint64_t) key * 0x9E3779B97F4A7C15ULL) >> 32) & (n_slots - 1);
+}
+
+/* finds the slot of `key`, or the empty slot it would go in */
+static trigram_list_t *find_slot(trigram_list_t *slots, size_t n_slots, uint32_t key) {
+    size_t i = trigram_slot(key, n_slots);
+    while (slots[i].key != 0 && slots[i].key != key) {
+        i = (i + 1) & (n_slots - 1);
+    }
+    return &slots[i];
+}
+
+static int grow_table(trigrams_t *trigrams) {
+    size_t new_n_slots = trigrams->n_slots * 2;
+    trigram_list_t *new_slots = calloc(new_n_slots, sizeof(trigram_list_t));
+    if (new_slots == NULL) {
+        pr_error("Failed to allocate memory for trigrams\n");
+        return -1;
+    }
+
+    for (size_t i = 0; i < trigrams->n_slots; i++) {
+        if (trigrams->slots[i].key != 0) {
+            *find_slot(new_slots, new_n_slots, trigrams->slots[i].key) = trigrams->slots[i];
+        }
+    }
+
+    free(trigrams->slots);
+    trigrams->slots = new_slots;
+    trigrams->n_slots = new_n_slots;
+    return 0;
+}
+
+trigrams_t *trigrams_create(void) {
+    trigrams_t *trigrams = malloc(sizeof(trigrams_t));
+    if (trigrams == NULL) {
+        pr_error("Failed to allocate memory for trigrams\n");
+        return NULL;
+    }
+
+    trigrams->slots = calloc(TRIGRAMS_INITIAL_SLOTS, sizeof(trigram_list_t));
+    if (trigrams->slots == NULL) {
+        pr_error("Failed to allocate memory for trigrams\n");
+        free(trigrams);
+        return NULL;
+    }
+    trigrams->n_slots = TRIGRAMS_INITIAL_SLOTS;
+    trigrams->length = 0;
+    trigrams->ids_capacity = 0;
+
+    return trigrams;
+}
+
+void trigrams_destroy(trigrams_t *trigrams) {
+    if (trigrams == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < trigrams->n_slots; i++) {
+        free(trigrams->slots[i].ids);
+    }
+    free(trigrams->slots);
+    free(trigrams);
+}
+
+int trigrams_add(trigrams_t *trigrams, const char *term, uint32_t id) {
+    size_t len = strlen(term);
+
+    for (size_t i = 0; i + TRIGRAM_LEN <= len; i++) {
+        uint32_t key = trigram_key(&term[i]);
+        trigram_list_t *list = find_slot(trigrams->slots, trigrams->n_slots, key);
+
+        if (list->key == 0) {
+            if (2 * (trigrams->length + 1) > trigrams->n_slots) {
+                if (grow_table(trigrams) != 0) {
+                    return -1;
+                }
+                list = find_slot(trigrams->slots, trigrams->n_slots, key);
+            }
+            list->key = key;
+            trigrams->length += 1;
+        }
+
+        /* a term containing the same trigram twice is only listed once. Ids increase, so it is the last one */
+        if (list->len > 0 && list->ids[list->len - 1] == id) {
+            continue;
+        }
+
+        if (list->len == list->capacity) {
+            uint32_t new_capacity = list->capacity ? list->capacity * 2 : 4;
+            uint32_t *new_ids = realloc(list->ids, new_capacity * sizeof(uint32_t));
+            if (new_ids == NULL) {
+                pr_error("Failed to allocate memory for trigrams\n");
+                return -1;
+            }
+            trigrams->ids_capacity += new_capacity - list->capacity;
+            list->ids = new_ids;
+            list->capacity = new_capacity;
+        }
+        list->ids[list->len++] = id;
+    }
+
+    return 0;
+}
+
+/* returns the position of the first id >= `id` in `ids[from..len)`, galloping ahead before a binary search */
+static size_t seek_id(const uint32_t *ids, size_t len, size_t from, uint32_t id) {
+    size_t step = 1;
+    size_t lo = from;
+    size_t hi = from;
+
+    while (hi < len && ids[hi] < id) {
+        lo = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    if (hi > len) {
+        hi = len;
+    }
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ids[mid] < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+int trigrams_candidates(
+    const trigrams_t *trigrams, const char *str, arena_t *arena, uint32_t **out_ids, size_t *out_n
+) {
+    size_t n_lists = strlen(str) - TRIGRAM_LEN + 1;
+    const trigram_list_t **lists = arena_alloc(arena, n_lists * sizeof(trigram_list_t *));
+    if (lists == NULL) {
+        pr_error("Failed to allocate memory for trigrams\n");
+        return -1;
+    }
+
+    /* a trigram that no term has rules out every term */
+    size_t shortest = 0;
+    for (size_t i = 0; i < n_lists; i++) {
+        lists[i] = find_slot(trigrams->slots, trigrams->n_slots, trigram_key(&str[i]));
+        if (lists[i]->key == 0) {
+            *out_ids = NULL;
+            *out_n = 0;
+            return 0;
+        }
+        if (lists[i]->len < lists[shortest]->len) {
+            shortest = i;
+        }
+    }
+
+    uint32_t *ids = arena_alloc(arena, (lists[shortest]->len + 1) * sizeof(uint32_t));
+    if (ids == NULL) {
+        pr_error("Failed to allocate memory for trigrams\n");
+        return -1;
+    }
+    memcpy(ids, lists[shortest]->ids, lists[shortest]->len * sizeof(uint32_t));
+    size_t n = lists[shortest]->len;
+
+    /* narrow the candidates of the shortest list down by every other list, in place */
+    for (size_t i = 0; i < n_lists && n > 0; i++) {
+        if (lists[i] == lists[shortest]) {
+            continue;
+        }
+
+        size_t kept = 0;
+        size_t pos = 0;
+        for (size_t j = 0; j < n; j++) {
+            pos = seek_id(lists[i]->ids, lists[i]->len, pos, ids[j]);
+            if (pos == lists[i]->len) {
+                break;
+            }
+            if (lists[i]->ids[pos] == ids[j]) {
+                ids[kept++] = ids[j];
+            }
+        }
+        n = kept;
+    }
+
+    *out_ids = ids;
+    *out_n = n;
+    return 0;
+}
+
+size_t trigrams_length(const trigrams_t *trigrams) {
+    return trigrams->length;
+}
+
+size_t trigrams_bytes(const trigrams_t *trigrams) {
+    return sizeof(trigrams_t) + trigrams->n_slots * sizeof(trigram_list_t)
+        + trigrams->ids_capacity * sizeof(uint32_t);
+}
@@ -41,17 +41,37 @@
 #define CLI_COMMAND_AUTOCLEAR ".autoclear"
 #define CLI_COMMAND_INFO      ".info"
 #define CLI_COMMAND_STAT      ".stat"
+#define CLI_COMMAND_COMPLETE  ".complete"
 
 /* these are pointers instead of definitions as we want to refer other pointers to them */
 static const char *type_arg = "--type";
 static const char *limit_arg = "--limit";
 static const char *stderr_arg = "--stderr";
 static const char *outfile_arg = "--outfile";
+static const char *ranking_arg = "--ranking";
+static const char *topk_arg = "--topk";
+static const char *positions_arg = "--positions";
+static const char *trigrams_arg = "--trigrams";
 static const char *help_arg = "--help";
 
 /* will be set to a logger if the optional --outfile argument is present */
 static logger_t *result_logger = NULL;
 
+/* ranking function and parameters, set by the optional --ranking argument */
+static ranking_t ranking = RANKING_TFIDF;
+static double bm25_k1 = BM25_DEFAULT_K1;
+static double bm25_b = BM25_DEFAULT_B;
+
+/* anytime top-k evaluation, enabled by the optional --topk argument */
+static size_t topk = 0;
+static size_t topk_budget = 0;
+
+/* positional index, enabled by the optional --positions argument */
+static bool positional = false;
+
+/* trigram index for substring queries, enabled by the optional --trigrams argument */
+static bool trigrams = false;
+
 /* write to the result logger, if it exists */
 static void log_result(const char *buf) {
     if (result_logger) {
@@ -88,7 +108,8 @@ static void print_command_list() {
     printf("%-*s - %s\n", col_w, CLI_COMMAND_EXIT, "Exit the application");
     printf("%-*s - %s\n", col_w, CLI_COMMAND_CLEAR, "Clear the terminal once");
     printf("%-*s - %s\n", col_w, CLI_COMMAND_AUTOCLEAR, "Toggle clearing the terminal on each new query");
-    printf("%-*s - %s\n", col_w, CLI_COMMAND_STAT, "Print the number indexed documents and unique terms");
+    printf("%-*s - %s\n", col_w, CLI_COMMAND_STAT, "Print the number indexed documents and unique terms, and data structure statistics");
+    printf("%-*s - %s\n", col_w, CLI_COMMAND_COMPLETE, "<prefix>: Print the most frequent terms with a prefix");
     printf("%-*s - %s\n", col_w, CLI_COMMAND_INFO, "Print this message");
     printf("Note: Clearing the terminal only works in ANSI/POSIX terminal emulators\n");
 }
@@ -99,7 +120,7 @@ static void print_arg_usage(int col_w, const char *arg, const char *val, const c
 }
 
 static void print_usage(char **argv) {
-    static const int col_w = 22;
+    static const int col_w = 34;
     fprintf(stderr, "\nUsage: \"%s <data-dir> [...optional args>]\"\n", basename(argv[0]));
     fprintf(stderr, "Required Arguments:\n");
     fprintf(stderr, "%-*s - %s\n", col_w + 2, "<data-dir>", "Path to directory of files to index");
@@ -108,6 +129,10 @@ static void print_usage(char **argv) {
     print_arg_usage(col_w, limit_arg, "<n>", "Limit number of included data files");
     print_arg_usage(col_w, outfile_arg, "<fpath>", "Log succesful queries / results to a file");
     print_arg_usage(col_w, stderr_arg, "<fpath | tty>", "Redirect stderr to file or terminal");
+    print_arg_usage(col_w, ranking_arg, "<tfidf | bm25> [k1] [b]", "Ranking function, and BM25 parameters");
+    print_arg_usage(col_w, topk_arg, "<k> [budget]", "Only find the k best results of OR queries");
+    print_arg_usage(col_w, positions_arg, "", "Store term positions, for phrase queries");
+    print_arg_usage(col_w, trigrams_arg, "", "Index the trigrams of terms, for substring queries");
 }
 
 /**
@@ -139,8 +164,8 @@ int is_operator_part(int c) {
  * @returns 1 if character should be included in a query, otherise 0
  */
 int is_valid_query_char(int c) {
-    if (is_operator_part(c)) {
-        return 1;
+    if (is_operator_part(c) || c == '*' || c == '~' || c == '"') {
+        return 1; // prefix, fuzzy and substring terms and phrases, see `parse_term`
     }
     /* not a special char, filter normally as ascii alphanumeric */
     return is_ascii_alnum(c);
@@ -188,8 +213,7 @@ static void process_query_results(list_t *results, const char *input, long doubl
         snprintf(result_buf, LINE_MAX, "%-10.3f %s\n", res->score, res->doc_name);
         output_result(result_buf);
 
-        n_printed += 1;
-        free(res); // free the result we just popped
+        n_printed += 1; // the result belongs to the index, see `index_query`
 
         if (MAX_RESULT_TABLE_ROWS) {
             if (n_printed >= MAX_RESULT_TABLE_ROWS && list_length(results)) {
@@ -244,8 +268,8 @@ static void execute_query(index_t *idx, list_t *tokens, const char *input) {
     if (results) {
         process_query_results(results, input, t_secs);
 
-        /* destroy the list of results and any result_t objects in it */
-        list_destroy(results, free);
+        /* destroy the list of results. The result_t objects in it belong to the index */
+        list_destroy(results, NULL);
     } else if (*errmsg_buf) {
         cli_pr_error("Invalid query", "%s\n", errmsg_buf);
     } else {
@@ -254,6 +278,49 @@ static void execute_query(index_t *idx, list_t *tokens, const char *input) {
 }
 
 
+/* complete a prefix with the terms starting with it that occur in the most documents, and print them */
+static void execute_complete(index_t *idx, char *prefix) {
+    /* the prefix is filtered like the terms of a query */
+    size_t len = 0;
+    for (char *c = prefix; *c != '\0'; c++) {
+        if (is_ascii_alnum(*c)) {
+            prefix[len++] = (char) tolower(*c);
+        }
+    }
+    prefix[len] = '\0';
+
+    if (len == 0) {
+        cli_pr_error("Invalid command", "Expected a prefix, \"%s <prefix>\"\n", CLI_COMMAND_COMPLETE);
+        return;
+    }
+
+    struct timeval t_start, t_end;
+    completion_t completions[COMPLETIONS_K];
+    size_t n_completions;
+
+    gettimeofday(&t_start, NULL);
+    int status = index_complete(idx, prefix, completions, &n_completions);
+    gettimeofday(&t_end, NULL);
+
+    if (status != 0) {
+        cli_pr_error("Index error", "Failed to complete \"%s\"\n", prefix);
+        return;
+    }
+
+    long double t_secs = (long double) (t_end.tv_sec - t_start.tv_sec);
+    t_secs += (long double) (t_end.tv_usec - t_start.tv_usec) / 1000000.0;
+
+    printf("=== %zu completion%s in %.6Lfs ===\n", n_completions, (n_completions == 1) ? "" : "s", t_secs);
+    if (n_completions) {
+        printf("%-10s %s\n", "Documents", "Term");
+    }
+    for (size_t i = 0; i < n_completions; i++) {
+        printf("%-10zu %s\n", completions[i].doc_frequency, completions[i].term);
+        free(completions[i].term);
+    }
+}
+
+
 /**
  * @brief Run the interpreter
  * @param idx: pointer to index
@@ -309,6 +376,11 @@ static int run_interpreter(index_t *idx, list_t *piped_input) {
                 size_t n_docs, n_terms;
                 index_stat(idx, &n_docs, &n_terms);
                 printf("Index consists of %zu documents and %zu unique terms\n", n_docs, n_terms);
+                index_print_stats(idx, stdout);
+            } else if (strncmp(input, CLI_COMMAND_COMPLETE, strlen(CLI_COMMAND_COMPLETE)) == 0
+                       && (input[strlen(CLI_COMMAND_COMPLETE)] == '\0'
+                           || isspace(input[strlen(CLI_COMMAND_COMPLETE)]))) {
+                execute_complete(idx, input + strlen(CLI_COMMAND_COMPLETE));
             } else if (strcmp(input, CLI_COMMAND_INFO) == 0) {
                 print_command_list();
             } else {
@@ -390,9 +462,24 @@ static index_t *build_index(list_t *fpaths) {
         return NULL;
     }
 
+    /* the parameters are validated by process_args */
+    if (index_set_ranking(idx, ranking, bm25_k1, bm25_b) != 0) {
+        PANIC("Failed to set ranking function\n");
+    }
+    index_set_topk(idx, topk, topk_budget);
+    if (index_set_positional(idx, positional) != 0) {
+        PANIC("Failed to set positional mode\n");
+    }
+    if (index_set_trigrams(idx, trigrams) != 0) {
+        PANIC("Failed to create the trigram index\n");
+    }
+
     const size_t files_total = list_length(fpaths);
     size_t i = 0;
 
+    /* let the index presize its structures for the number of files */
+    index_expect_documents(idx, files_total);
+
     while (list_length(fpaths)) {
         i++;
         if (PRINT_PROGRESS_INTERVAL && (i % PRINT_PROGRESS_INTERVAL == 0 || i == 1 || i == files_total)) {
@@ -426,6 +513,11 @@ static index_t *build_index(list_t *fpaths) {
         printf("\n");
     }
 
+    /* every document is indexed, get the index ready for queries */
+    if (index_freeze(idx) != 0) {
+        pr_warn("Failed to freeze the index, continuing without\n");
+    }
+
     return idx;
 }
 
@@ -456,6 +548,73 @@ static int insert_valid_ext(char *arg, set_t *valid_exts) {
     return 0;
 }
 
+/* helper for process_args. Parses the values following --ranking, one at a time */
+static int parse_ranking_value(char *arg, int value_i) {
+    if (value_i == 0) {
+        if (strcmp(arg, "tfidf") == 0) {
+            ranking = RANKING_TFIDF;
+        } else if (strcmp(arg, "bm25") == 0) {
+            ranking = RANKING_BM25;
+        } else {
+            pr_error("Unknown ranking function \"%s\", expected tfidf or bm25\n", arg);
+            return -1;
+        }
+        return 0;
+    }
+
+    if (ranking != RANKING_BM25 || value_i > 2) {
+        pr_error("Unexpected value following %s: \"%s\"\n", ranking_arg, arg);
+        return -1;
+    }
+
+    char *end;
+    errno = 0;
+    double value = strtod(arg, &end);
+    if (errno != 0 || end == arg || *end != '\0') {
+        pr_error("Expected a number following %s bm25, found \"%s\"\n", ranking_arg, arg);
+        return -1;
+    }
+
+    if (value_i == 1) {
+        if (!(value >= 0.0)) {
+            pr_error("BM25 parameter k1 must be >= 0, found %s\n", arg);
+            return -1;
+        }
+        bm25_k1 = value;
+    } else {
+        if (!(value >= 0.0 && value <= 1.0)) {
+            pr_error("BM25 parameter b must be in the range [0, 1], found %s\n", arg);
+            return -1;
+        }
+        bm25_b = value;
+    }
+    return 0;
+}
+
+/* helper for process_args. Parses the values following --topk, one at a time */
+static int parse_topk_value(char *arg, int value_i) {
+    if (value_i > 1) {
+        pr_error("Unexpected value following %s: \"%s\"\n", topk_arg, arg);
+        return -1;
+    }
+
+    if (!is_digit_string(arg)) {
+        pr_error("Expected integer value following %s, found \"%s\"\n", topk_arg, arg);
+        return -1;
+    }
+
+    if (value_i == 0) {
+        topk = strtoul(arg, NULL, 10);
+        if (topk == 0) {
+            pr_error("%s must be at least 1\n", topk_arg);
+            return -1;
+        }
+    } else {
+        topk_budget = strtoul(arg, NULL, 10);
+    }
+    return 0;
+}
+
 /**
  * @brief Parse arguments and populate the `fpaths` list.
  * @param fpaths: list to populate with data file paths
@@ -530,6 +689,14 @@ static int process_args(int argc, char **argv, list_t *fpaths) {
                 parsing = type_arg;
             } else if (!strcmp(arg, limit_arg)) {
                 parsing = limit_arg;
+            } else if (!strcmp(arg, ranking_arg)) {
+                parsing = ranking_arg;
+            } else if (!strcmp(arg, topk_arg)) {
+                parsing = topk_arg;
+            } else if (!strcmp(arg, positions_arg)) {
+                parsing = positions_arg;
+            } else if (!strcmp(arg, trigrams_arg)) {
+                parsing = trigrams_arg;
             } else {
                 pr_error("Unrecognized argument: \"%s\"\n", arg);
                 goto end;
@@ -543,6 +710,14 @@ static int process_args(int argc, char **argv, list_t *fpaths) {
 
             parsed_values = 0; // parsed_values 0 of the current argument
 
+            /* flags, which take no values */
+            if (parsing == positions_arg || parsing == trigrams_arg) {
+                positional |= parsing == positions_arg;
+                trigrams |= parsing == trigrams_arg;
+                parsing = NULL;
+                parsed_values = 1;
+            }
+
             /* continue to the following value */
             continue;
         }
@@ -556,6 +731,24 @@ static int process_args(int argc, char **argv, list_t *fpaths) {
             continue;
         }
 
+        if (parsing == ranking_arg) {
+            if (parse_ranking_value(arg, parsed_values) < 0) {
+                goto end;
+            }
+            /* may be followed by the BM25 parameters */
+            parsed_values += 1;
+            continue;
+        }
+
+        if (parsing == topk_arg) {
+            if (parse_topk_value(arg, parsed_values) < 0) {
+                goto end;
+            }
+            /* may be followed by the budget */
+            parsed_values += 1;
+            continue;
+        }
+
         /* these arguments only have 1 value */
         if (parsing == outfile_arg) {
             result_logger = logger_create(arg);
@@ -0,0 +1,155 @@
+/**
+ * @brief Tests that a query the index has seen before makes no heap allocations: its program is cached, and
+ * everything else it needs comes from memory that the index keeps between queries.
+ *
+ * `malloc`, `calloc` and `realloc` are replaced by versions that count the calls, and pass them on to glibc.
+ * Every query is run until that memory has grown to fit it, and then once more, counting.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "index.h"
+#include "list.h"
+#include "tokenize.h"
+
+#define N_DOCS 300
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static size_t n_allocations = 0;
+
+void *malloc(size_t size) {
+    n_allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    n_allocations++;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    n_allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+/* queries of every kind, most with many results */
+static const char *queries[] = {
+    "apple",
+    "comp*",
+    "*omp*",
+    "aple~1",
+    "\"apple the banana\"",
+    "apple && (banana || cherry) &! comp*",
+    "(comp* && apple) || (comp* && cherry)",
+    "\"the apple\" || comp* || unknown",
+};
+
+/* splits `str` at spaces, like the tokens of a document or query */
+static list_t *split(const char *str) {
+    list_t *tokens = list_create((cmp_fn) strcmp);
+    if (tokens == NULL || tokenize_string(str, tokens, 1, isspace, isgraph, NULL) != 0) {
+        fprintf(stderr, "Failed to split '%s'\n", str);
+        exit(EXIT_FAILURE);
+    }
+    return tokens;
+}
+
+/* runs a query, and returns the number of heap allocations it made */
+static size_t count_allocations(index_t *index, list_t *tokens, const char *query) {
+    char errmsg[LINE_MAX] = { 0 };
+    size_t n_results;
+
+    size_t before = n_allocations;
+    query_result_t *results = index_query_into(index, tokens, &n_results, errmsg);
+    size_t n = n_allocations - before;
+
+    if (results == NULL) {
+        fprintf(stderr, "Failed to run '%s': %s\n", query, errmsg);
+        exit(EXIT_FAILURE);
+    }
+    return n;
+}
+
+/* runs every query `n_rounds` times, and returns the number of them that made heap allocations in the last */
+static int run_queries(index_t *index, size_t n_rounds) {
+    size_t n_queries = sizeof(queries) / sizeof(*queries);
+    list_t *tokens[sizeof(queries) / sizeof(*queries)];
+    for (size_t i = 0; i < n_queries; i++) {
+        tokens[i] = split(queries[i]);
+    }
+
+    /* until the memory of the index fits the largest query, which is the round after it has grown */
+    for (size_t round = 0; round < n_rounds; round++) {
+        for (size_t i = 0; i < n_queries; i++) {
+            count_allocations(index, tokens[i], queries[i]);
+        }
+    }
+
+    int n_failed = 0;
+    for (size_t i = 0; i < n_queries; i++) {
+        size_t n = count_allocations(index, tokens[i], queries[i]);
+        if (n != 0) {
+            fprintf(stderr, "FAIL %s: %zu heap allocations\n", queries[i], n);
+            n_failed++;
+        } else {
+            printf("ok   %s\n", queries[i]);
+        }
+    }
+
+    for (size_t i = 0; i < n_queries; i++) {
+        list_destroy(tokens[i], free);
+    }
+    return n_failed;
+}
+
+int main(void) {
+    index_t *index = index_create((cmp_fn) strcmp, hash_string_fnv1a64);
+    if (index == NULL || index_set_positional(index, true) != 0 || index_set_trigrams(index, true) != 0) {
+        fprintf(stderr, "Failed to create the index\n");
+        return EXIT_FAILURE;
+    }
+
+    /* documents of a few common words, one of some 50 terms starting with "comp", and a phrase in every third */
+    static const char *suffixes[] = { "ile", "uter", "are", "lete", "ose", "act", "ass", "ute", "ress", "lex" };
+    static const char *words[] = { "apple", "banana", "cherry", "the", "of", "apply" };
+    for (size_t i = 0; i < N_DOCS; i++) {
+        char text[LINE_MAX] = { 0 };
+        char doc_name[32];
+
+        snprintf(text, sizeof(text), "comp%s%zu", suffixes[i % 10], i % 5);
+        for (size_t j = 0; j < 20; j++) {
+            strcat(text, " ");
+            strcat(text, words[(i * 7 + j * 3) % 6]);
+        }
+        if (i % 3 == 0) {
+            strcat(text, " apple the banana");
+        }
+
+        snprintf(doc_name, sizeof(doc_name), "doc%zu", i);
+        if (index_document(index, strdup(doc_name), split(text)) != 0) {
+            fprintf(stderr, "Failed to index '%s'\n", doc_name);
+            return EXIT_FAILURE;
+        }
+    }
+
+    int n_failed = run_queries(index, 2);
+
+    /* the best few documents of a disjunction are found another way */
+    index_set_topk(index, 5, 0);
+    n_failed += run_queries(index, 2);
+
+    index_destroy(index);
+
+    if (n_failed) {
+        fprintf(stderr, "%d failed\n", n_failed);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,113 @@
+/**
+ * @brief Tests of phrase queries. Every word of a phrase has to be at its place, stop words included: a phrase
+ * with a stop word does not match a document with another word in its place.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "index.h"
+#include "list.h"
+#include "tokenize.h"
+
+/* the documents, by name */
+static const char *documents[][2] = {
+    { "a", "apple the banana" },
+    { "b", "apple tree banana" }, // a word that is not a stop word where the phrase has one
+    { "c", "apple of banana" },   // another stop word where the phrase has one
+    { "d", "the apple pie" },
+    { "e", "green apple pie" },
+    { "f", "apple banana" },
+    { "g", "the end of the line" },
+    { "h", "the end in the line" },
+    { "i", "the end of line" },
+};
+
+static int n_failed = 0;
+
+/* splits `str` at spaces, like the tokens of a document or query */
+static list_t *split(const char *str) {
+    list_t *tokens = list_create((cmp_fn) strcmp);
+    if (tokens == NULL || tokenize_string(str, tokens, 1, isspace, isgraph, NULL) != 0) {
+        fprintf(stderr, "Failed to split '%s'\n", str);
+        exit(EXIT_FAILURE);
+    }
+    return tokens;
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+/* checks that `query` matches exactly the documents in `expected`, by name in order, separated by spaces */
+static void expect(index_t *index, const char *query, const char *expected) {
+    char errmsg[LINE_MAX] = { 0 };
+    list_t *tokens = split(query);
+    list_t *results = index_query(index, tokens, errmsg);
+
+    if (results == NULL) {
+        fprintf(stderr, "FAIL %s: %s\n", query, errmsg);
+        n_failed++;
+        list_destroy(tokens, free);
+        return;
+    }
+
+    char *names[sizeof(documents) / sizeof(*documents)];
+    size_t n_results = 0;
+    while (list_length(results)) {
+        query_result_t *result = list_popfirst(results);
+        names[n_results++] = result->doc_name;
+    }
+    list_destroy(results, NULL);
+    qsort(names, n_results, sizeof(char *), compare_names);
+
+    char found[LINE_MAX] = { 0 };
+    for (size_t i = 0; i < n_results; i++) {
+        strcat(found, i ? " " : "");
+        strcat(found, names[i]);
+    }
+
+    if (strcmp(found, expected) != 0) {
+        fprintf(stderr, "FAIL %s: expected [%s], found [%s]\n", query, expected, found);
+        n_failed++;
+    } else {
+        printf("ok   %s\n", query);
+    }
+
+    list_destroy(tokens, free);
+}
+
+int main(void) {
+    index_t *index = index_create((cmp_fn) strcmp, hash_string_fnv1a64);
+    if (index == NULL || index_set_positional(index, true) != 0) {
+        fprintf(stderr, "Failed to create a positional index\n");
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < sizeof(documents) / sizeof(*documents); i++) {
+        if (index_document(index, strdup(documents[i][0]), split(documents[i][1])) != 0) {
+            fprintf(stderr, "Failed to index '%s'\n", documents[i][0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    expect(index, "\"apple the banana\"", "a");
+    expect(index, "\"the apple\"", "d");
+    expect(index, "\"apple pie\"", "d e");
+    expect(index, "\"apple banana\"", "f");
+    expect(index, "\"end of the line\"", "g");
+    expect(index, "\"end of line\"", "i");
+    expect(index, "\"of the\"", "");
+    expect(index, "apple && \"the apple\"", "d");
+
+    index_destroy(index);
+
+    if (n_failed) {
+        fprintf(stderr, "%d failed\n", n_failed);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,154 @@
+/**
+ * @brief Tests of compiled queries: a subquery that occurs more than once is evaluated once, and its result
+ * saved and loaded, whatever instruction it ends with. Also checks that its documents are still found.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "index.h"
+#include "list.h"
+#include "tokenize.h"
+#include "common.h"
+#include "arena.h"
+#include "ast.h"
+#include "program.h"
+
+/* the documents, by name */
+static const char *documents[][2] = {
+    { "a", "apple banana" },
+    { "b", "apple cherry banana" }, // has the excluded term
+    { "c", "apple pie" },
+    { "d", "banana pie" },
+    { "e", "apple banana pie" },
+};
+
+static int n_failed = 0;
+
+/* splits `str` at spaces and parentheses, like the tokens of a query */
+static list_t *split(const char *str) {
+    list_t *tokens = list_create((cmp_fn) strcmp);
+    if (tokens == NULL || tokenize_string(str, tokens, 1, is_space_or_par, isgraph, NULL) != 0) {
+        fprintf(stderr, "Failed to split '%s'\n", str);
+        exit(EXIT_FAILURE);
+    }
+    return tokens;
+}
+
+/* checks that the rewritten `query` has `n_saves` saves, `n_loads` loads and `n_excludes` excludes */
+static void expect_match(index_t *index, const char *query, size_t n_saves, size_t n_loads, size_t n_excludes) {
+    char errmsg[LINE_MAX] = { 0 };
+    list_t *tokens = split(query);
+    list_iter_t *iter = list_createiter(tokens);
+    arena_t *arena = arena_create();
+
+    AST *ast = (iter && arena) ? parse_expression(iter, arena, errmsg) : NULL;
+    program_t *program = ast ? program_compile(ast, index) : NULL;
+    if (program == NULL) {
+        fprintf(stderr, "FAIL %s: failed to compile: %s\n", query, errmsg);
+        n_failed++;
+    } else {
+        size_t counts[OP_LOAD + 1] = { 0 };
+        for (size_t pc = 0; pc < program->n_match; pc++) {
+            counts[program->match[pc].op] += 1;
+        }
+
+        if (counts[OP_SAVE] != n_saves || counts[OP_LOAD] != n_loads || counts[OP_EXCLUDE] != n_excludes) {
+            fprintf(
+                stderr,
+                "FAIL %s: expected %zu saves, %zu loads and %zu excludes, found %zu, %zu and %zu\n",
+                query,
+                n_saves,
+                n_loads,
+                n_excludes,
+                counts[OP_SAVE],
+                counts[OP_LOAD],
+                counts[OP_EXCLUDE]
+            );
+            n_failed++;
+        } else {
+            printf("ok   %s\n", query);
+        }
+    }
+
+    program_destroy(program);
+    arena_destroy(arena);
+    list_destroyiter(iter);
+    list_destroy(tokens, free);
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+/* checks that `query` matches exactly the documents in `expected`, by name in order, separated by spaces */
+static void expect_results(index_t *index, const char *query, const char *expected) {
+    char errmsg[LINE_MAX] = { 0 };
+    list_t *tokens = split(query);
+    list_t *results = index_query(index, tokens, errmsg);
+
+    if (results == NULL) {
+        fprintf(stderr, "FAIL %s: %s\n", query, errmsg);
+        n_failed++;
+        list_destroy(tokens, free);
+        return;
+    }
+
+    char *names[sizeof(documents) / sizeof(*documents)];
+    size_t n_results = 0;
+    while (list_length(results)) {
+        query_result_t *result = list_popfirst(results);
+        names[n_results++] = result->doc_name;
+    }
+    list_destroy(results, NULL);
+    qsort(names, n_results, sizeof(char *), compare_names);
+
+    char found[LINE_MAX] = { 0 };
+    for (size_t i = 0; i < n_results; i++) {
+        strcat(found, i ? " " : "");
+        strcat(found, names[i]);
+    }
+
+    if (strcmp(found, expected) != 0) {
+        fprintf(stderr, "FAIL %s: expected [%s], found [%s]\n", query, expected, found);
+        n_failed++;
+    } else {
+        printf("ok   %s\n", query);
+    }
+
+    list_destroy(tokens, free);
+}
+
+int main(void) {
+    index_t *index = index_create((cmp_fn) strcmp, hash_string_fnv1a64);
+    if (index == NULL) {
+        fprintf(stderr, "Failed to create the index\n");
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < sizeof(documents) / sizeof(*documents); i++) {
+        if (index_document(index, strdup(documents[i][0]), split(documents[i][1])) != 0) {
+            fprintf(stderr, "Failed to index '%s'\n", documents[i][0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* a shared ANDNOT of a term ends with an exclude, and is saved the first time and loaded the second */
+    const char *shared_exclude = "((apple &! cherry) && banana) || ((apple &! cherry) && pie)";
+    expect_match(index, shared_exclude, 1, 1, 1);
+    expect_match(index, "((apple || pie) && banana) || ((apple || pie) && cherry)", 1, 1, 0);
+    expect_match(index, "(apple &! cherry) && banana", 0, 0, 1);
+
+    expect_results(index, shared_exclude, "a c e");
+
+    index_destroy(index);
+
+    if (n_failed) {
+        fprintf(stderr, "%d failed\n", n_failed);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,87 @@
+/**
+ * @brief Tests of `set_stats`: a red-black tree stays balanced, however its elements are inserted, and counts the
+ * rotations it takes to keep it so.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "set.h"
+
+#define N_ELEMS 1000
+
+static int n_failed = 0;
+
+static int compare_ints(const int *a, const int *b) {
+    return (*a > *b) - (*a < *b);
+}
+
+/* the height of a red-black tree of `n` nodes is at most 2 log2(n + 1) */
+static size_t max_height(size_t n) {
+    size_t log2 = 0;
+    while (((size_t) 1 << log2) < n + 1) {
+        log2++;
+    }
+    return 2 * log2;
+}
+
+/* checks the stats of a set of `n` of the elements in `elems`, inserted in the order given by `order` */
+static void expect_balanced(const char *name, int *elems, size_t n, size_t (*order)(size_t i, size_t n)) {
+    set_t *set = set_create((cmp_fn) compare_ints);
+    if (set == NULL) {
+        fprintf(stderr, "Failed to create the set\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < n; i++) {
+        set_insert(set, &elems[order(i, n)]);
+    }
+
+    set_stats_t stats;
+    set_stats(set, &stats);
+
+    /* a tree of more than two nodes inserted in order has to be rotated to stay balanced */
+    size_t min_rotations = (n > 2) ? 1 : 0;
+    if (stats.length != n || stats.height > max_height(n) || (n > 0 && stats.height == 0)
+        || stats.n_rotations < min_rotations || stats.bytes == 0) {
+        fprintf(
+            stderr,
+            "FAIL %s: length %zu, height %zu, %zu rotations, %zu bytes\n",
+            name,
+            stats.length,
+            stats.height,
+            stats.n_rotations,
+            stats.bytes
+        );
+        n_failed++;
+    } else {
+        printf("ok   %s: height %zu, %zu rotations\n", name, stats.height, stats.n_rotations);
+    }
+
+    set_destroy(set, NULL);
+}
+
+static size_t ascending(size_t i, size_t n) {
+    (void) n;
+    return i;
+}
+
+static size_t descending(size_t i, size_t n) {
+    return n - 1 - i;
+}
+
+int main(void) {
+    static int elems[N_ELEMS];
+    for (size_t i = 0; i < N_ELEMS; i++) {
+        elems[i] = (int) i;
+    }
+
+    expect_balanced("empty", elems, 0, ascending);
+    expect_balanced("ascending", elems, N_ELEMS, ascending);
+    expect_balanced("descending", elems, N_ELEMS, descending);
+
+    if (n_failed) {
+        fprintf(stderr, "%d failed\n", n_failed);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
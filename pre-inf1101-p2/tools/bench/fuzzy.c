@@ -0,0 +1,291 @@
+/**
+ * @brief Benchmark of fuzzy term lookups: `termdict_iter_fuzzy` against computing the edit distance to every
+ * term of the vocabulary.
+ *
+ * usage: fuzzy <queries> [vocabulary size ...]
+ *
+ * For each size, a vocabulary of that many random word-like terms is generated (duplicates are dropped, so
+ * the vocabulary may come out slightly smaller) and built into a dictionary. Every term of the `queries` file
+ * (one per line, see fuzzy_queries.txt) is then looked up within 1 and 2 edits through the dictionary, and
+ * within 2 edits by brute force. The vocabularies come from a fixed seed, so every run sees the same terms.
+ *
+ * Reported per vocabulary: the average time of a query in microseconds, and the share of the vocabulary the
+ * dictionary had to decode to answer it (the `visited` field of its iterator).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "termdict.h"
+#include "levenshtein.h"
+
+#define MAX_QUERIES 64
+#define MAX_TERM_LEN 32
+
+/* default vocabulary sizes, before duplicates are dropped */
+static const size_t default_sizes[] = { 1000, 10000, 100000, 1000000 };
+
+/* each query is repeated until it has taken at least this long, to smooth out the timer */
+#define MIN_QUERY_NSECS 2000000
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15;
+
+/* xorshift64 */
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* write a random word of 2 to 4 syllables into `buf` */
+static void random_word(char *buf) {
+    static const char *onsets[] = { "b", "d", "f", "g", "h", "k", "l", "m", "n", "p", "r", "s", "t", "v", "z",
+                                    "br", "ch", "dr", "gr", "pl", "sh", "st", "th", "tr" };
+    static const char *nuclei[] = { "a", "e", "i", "o", "u", "ai", "ea", "ou", "y" };
+    static const char *codas[] = { "", "", "", "n", "r", "s", "t", "ng", "ck", "x" };
+
+    size_t n_syllables = 2 + rng_next() % 3;
+    buf[0] = '\0';
+
+    for (size_t i = 0; i < n_syllables; i++) {
+        strcat(buf, onsets[rng_next() % (sizeof(onsets) / sizeof(*onsets))]);
+        strcat(buf, nuclei[rng_next() % (sizeof(nuclei) / sizeof(*nuclei))]);
+        strcat(buf, codas[rng_next() % (sizeof(codas) / sizeof(*codas))]);
+    }
+}
+
+static int compare_terms(const void *a, const void *b) {
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+static double now_nsecs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+/* edit distance between `a` and `b`, or `max + 1` if it is above `max` */
+static size_t bounded_distance(const char *a, const char *b, size_t max) {
+    size_t len_a = strlen(a);
+    size_t len_b = strlen(b);
+    size_t rows[2][MAX_TERM_LEN + 1];
+
+    if ((len_a > len_b ? len_a - len_b : len_b - len_a) > max) {
+        return max + 1;
+    }
+
+    for (size_t j = 0; j <= len_b; j++) {
+        rows[0][j] = j;
+    }
+
+    for (size_t i = 1; i <= len_a; i++) {
+        size_t *prev = rows[(i - 1) & 1];
+        size_t *row = rows[i & 1];
+        size_t row_min = row[0] = i;
+
+        for (size_t j = 1; j <= len_b; j++) {
+            size_t cost = prev[j - 1] + (a[i - 1] != b[j - 1]);
+            if (prev[j] + 1 < cost) {
+                cost = prev[j] + 1;
+            }
+            if (row[j - 1] + 1 < cost) {
+                cost = row[j - 1] + 1;
+            }
+            row[j] = cost;
+            row_min = (cost < row_min) ? cost : row_min;
+        }
+
+        if (row_min > max) {
+            return max + 1;
+        }
+    }
+
+    return rows[len_a & 1][len_b];
+}
+
+/* look up `query` within `max_edits` through the dictionary. returns the number of matches */
+static size_t fuzzy_lookup(termdict_t *dict, const char *query, unsigned max_edits, size_t *visited) {
+    termdict_iter_t iter;
+    size_t n = 0;
+
+    if (termdict_iter_fuzzy(dict, &iter, query, max_edits) != 0) {
+        fprintf(stderr, "Failed to look up '%s'\n", query);
+        exit(EXIT_FAILURE);
+    }
+
+    while (termdict_iter_next(&iter, NULL)) {
+        n++;
+    }
+
+    *visited = iter.visited;
+    termdict_iter_deinit(&iter);
+    return n;
+}
+
+/* look up `query` within `max_edits` by computing the distance to every term. returns the number of matches */
+static size_t brute_force_lookup(char **terms, size_t n_terms, const char *query, size_t max_edits) {
+    size_t n = 0;
+
+    for (size_t i = 0; i < n_terms; i++) {
+        n += bounded_distance(query, terms[i], max_edits) <= max_edits;
+    }
+
+    return n;
+}
+
+/* run every query within `max_edits` through the dictionary, or by brute force if `dict` is NULL */
+static void run_queries(
+    termdict_t *dict,
+    char **terms,
+    size_t n_terms,
+    char queries[][MAX_TERM_LEN],
+    size_t n_queries,
+    unsigned max_edits,
+    double *out_usecs,
+    double *out_decoded,
+    size_t *out_matches
+) {
+    double total_nsecs = 0.0;
+    size_t total_visited = 0;
+    size_t total_matches = 0;
+
+    for (size_t q = 0; q < n_queries; q++) {
+        size_t reps = 0;
+        size_t visited = 0;
+        size_t matches = 0;
+        double start = now_nsecs();
+        double elapsed;
+
+        do {
+            matches = dict ? fuzzy_lookup(dict, queries[q], max_edits, &visited)
+                           : brute_force_lookup(terms, n_terms, queries[q], max_edits);
+            reps++;
+            elapsed = now_nsecs() - start;
+        } while (elapsed < MIN_QUERY_NSECS);
+
+        total_nsecs += elapsed / (double) reps;
+        total_visited += visited;
+        total_matches += matches;
+    }
+
+    *out_usecs = total_nsecs / (double) n_queries / 1000.0;
+    *out_decoded = 100.0 * (double) total_visited / (double) (n_queries * n_terms);
+    *out_matches = total_matches;
+}
+
+static int run_vocabulary(size_t size, char queries[][MAX_TERM_LEN], size_t n_queries) {
+    char **terms = malloc(size * sizeof(char *));
+    uint32_t *values = malloc(size * sizeof(uint32_t));
+    if (terms == NULL || values == NULL) {
+        fprintf(stderr, "Failed to allocate a vocabulary of %zu terms\n", size);
+        free(terms);
+        free(values);
+        return -1;
+    }
+
+    char word[MAX_TERM_LEN];
+    for (size_t i = 0; i < size; i++) {
+        random_word(word);
+        terms[i] = strdup(word);
+    }
+
+    /* sort, and drop the duplicates */
+    qsort(terms, size, sizeof(char *), compare_terms);
+    size_t n_terms = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (n_terms > 0 && strcmp(terms[n_terms - 1], terms[i]) == 0) {
+            free(terms[i]);
+            continue;
+        }
+        values[n_terms] = (uint32_t) n_terms;
+        terms[n_terms++] = terms[i];
+    }
+
+    termdict_t *dict = termdict_build((const char **) terms, values, n_terms);
+    if (dict == NULL) {
+        fprintf(stderr, "Failed to build a dictionary of %zu terms\n", n_terms);
+        return -1;
+    }
+
+    double k1_usecs, k1_decoded, k2_usecs, k2_decoded, brute_usecs, brute_decoded;
+    size_t k1_matches, k2_matches, brute_matches;
+
+    run_queries(dict, terms, n_terms, queries, n_queries, 1, &k1_usecs, &k1_decoded, &k1_matches);
+    run_queries(dict, terms, n_terms, queries, n_queries, 2, &k2_usecs, &k2_decoded, &k2_matches);
+    run_queries(NULL, terms, n_terms, queries, n_queries, 2, &brute_usecs, &brute_decoded, &brute_matches);
+
+    printf(
+        "%8zu %12.0f %7.2f%% %12.0f %7.2f%% %16.0f %9zu\n",
+        n_terms,
+        k1_usecs,
+        k1_decoded,
+        k2_usecs,
+        k2_decoded,
+        brute_usecs,
+        k2_matches
+    );
+
+    int status = 0;
+    if (k2_matches != brute_matches) {
+        fprintf(stderr, "Mismatch: the dictionary found %zu terms within 2 edits, brute force found %zu\n",
+                k2_matches, brute_matches);
+        status = -1;
+    }
+
+    termdict_destroy(dict);
+    for (size_t i = 0; i < n_terms; i++) {
+        free(terms[i]);
+    }
+    free(terms);
+    free(values);
+    return status;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <queries> [vocabulary size ...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *f = fopen(argv[1], "r");
+    if (f == NULL) {
+        fprintf(stderr, "Failed to open '%s'\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    char queries[MAX_QUERIES][MAX_TERM_LEN];
+    size_t n_queries = 0;
+    while (n_queries < MAX_QUERIES && fgets(queries[n_queries], MAX_TERM_LEN, f)) {
+        queries[n_queries][strcspn(queries[n_queries], "\n")] = '\0';
+        if (queries[n_queries][0] != '\0') {
+            n_queries++;
+        }
+    }
+    fclose(f);
+
+    if (n_queries == 0) {
+        fprintf(stderr, "No queries in '%s'\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%zu queries, average per query\n", n_queries);
+    printf("%8s %12s %8s %12s %8s %16s %9s\n", "vocab", "k=1: us", "decoded", "k=2: us", "decoded",
+           "brute force us", "k=2 hits");
+
+    int status = 0;
+    if (argc > 2) {
+        for (int i = 2; i < argc; i++) {
+            status |= run_vocabulary(strtoull(argv[i], NULL, 10), queries, n_queries);
+        }
+    } else {
+        for (size_t i = 0; i < sizeof(default_sizes) / sizeof(*default_sizes); i++) {
+            status |= run_vocabulary(default_sizes[i], queries, n_queries);
+        }
+    }
+
+    return status ? EXIT_FAILURE : EXIT_SUCCESS;
+}